@@ -51,11 +51,41 @@ bool isReadNone(mlir::Operation *);
 bool mayReadFrom(mlir::Operation *, mlir::Value);
 bool mayWriteTo(mlir::Operation *, mlir::Value, bool ignoreBarrier = false);
 
+/// Whether the effects `a` and `b` may access the same memory. The effects
+/// gathered by collectEffects carry the type tag of their operation as their
+/// parameters, and effects with differing tags never alias.
 bool mayAlias(mlir::MemoryEffects::EffectInstance a,
               mlir::MemoryEffects::EffectInstance b);
 
 bool mayAlias(mlir::MemoryEffects::EffectInstance a, mlir::Value b);
 
+/// Attribute naming the strict-aliasing type class of the object accessed by
+/// a load or store, as derived by the frontend from the source language type.
+constexpr llvm::StringLiteral TypeTagAttrName = "polygeist.tbaa";
+
+/// Whether the memory accesses of `a` and `b` may overlap according to their
+/// type tags. Untagged operations may alias anything.
+bool mayAliasByType(mlir::Operation *a, mlir::Operation *b);
+
+/// Unit attribute on integer arithmetic whose signed result cannot overflow,
+/// like the nsw flag of LLVM.
+constexpr llvm::StringLiteral NoSignedWrapAttrName = "polygeist.nsw";
+
+/// Unit attribute on a division known to have no remainder, like the exact
+/// flag of LLVM.
+constexpr llvm::StringLiteral ExactAttrName = "polygeist.exact";
+
+/// Dictionary attribute carrying the source-level loop pragmas of a loop,
+/// keyed by hint: "unroll" ("enable", "full" or "disable"), "unroll_count",
+/// "vectorize" (bool), "vectorize_width", "interleave_count", "distribute"
+/// (bool) and "parallel" (unit, no iteration depends on another through
+/// memory). It sits on the loop operation, or on the branch
+/// closing the back edge of a loop in unstructured control flow.
+constexpr llvm::StringLiteral LoopHintsAttrName = "polygeist.loop_hints";
+
+/// Copies the loop hints of `from`, if any, to `to`.
+void copyLoopHints(mlir::Operation *from, mlir::Operation *to);
+
 extern llvm::cl::opt<bool> BarrierOpt;
 
 template <bool NotTopLevel = false>
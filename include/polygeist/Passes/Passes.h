@@ -22,12 +22,18 @@ std::unique_ptr<Pass> createCPUifyPass(StringRef method = "");
 std::unique_ptr<Pass> createBarrierRemovalContinuation();
 std::unique_ptr<Pass> detectReductionPass();
 std::unique_ptr<Pass> createRemoveTrivialUsePass();
+std::unique_ptr<Pass> createLoopHintUnrollPass(bool unrollFull = false);
+std::unique_ptr<Pass> createLowerAffinePass();
 std::unique_ptr<Pass> createParallelLowerPass();
+std::unique_ptr<Pass> createConvertParallelToOpenMPPass();
 std::unique_ptr<Pass>
 createConvertPolygeistToLLVMPass(const LowerToLLVMOptions &options,
                                  bool useCStyleMemRef);
 std::unique_ptr<Pass> createConvertPolygeistToLLVMPass();
 std::unique_ptr<Pass> createForBreakToWhilePass();
+std::unique_ptr<Pass> createFixedPointPass();
+std::unique_ptr<Pass> createFixedPointPass(OpPassManager pipeline,
+                                           unsigned maxIterations);
 
 void populateForBreakToWhilePatterns(RewritePatternSet &patterns);
 } // namespace polygeist
@@ -59,6 +65,10 @@ namespace func {
 class FuncDialect;
 }
 
+namespace omp {
+class OpenMPDialect;
+} // end namespace omp
+
 class AffineDialect;
 namespace LLVM {
 class LLVMDialect;
@@ -73,6 +73,12 @@ bool collectEffects(Operation *op,
   if (auto iface = dyn_cast<MemoryEffectOpInterface>(op)) {
     SmallVector<MemoryEffects::EffectInstance> localEffects;
     iface.getEffects(localEffects);
+    // The type tag of an access goes along with its effects, so that
+    // mayAlias can tell apart accesses to objects of different types.
+    if (auto tag = op->getAttr(TypeTagAttrName))
+      for (auto &effect : localEffects)
+        effect = MemoryEffects::EffectInstance(
+            effect.getEffect(), effect.getValue(), tag, effect.getResource());
     llvm::append_range(effects, localEffects);
     return true;
   }
@@ -433,6 +439,24 @@ bool isStackAlloca(Value v) {
          v.getDefiningOp<memref::AllocOp>() ||
          v.getDefiningOp<LLVM::AllocaOp>();
 }
+/// Whether `v` is an argument of the enclosing function itself.
+static bool isFunctionArgument(Value v) {
+  auto arg = v.dyn_cast<BlockArgument>();
+  return arg && arg.getOwner()->isEntryBlock() &&
+         isa<FunctionOpInterface>(arg.getOwner()->getParentOp());
+}
+
+/// Whether `v` is a function argument marked noalias, e.g. a C restrict
+/// pointer. No other pointer the function receives or creates is based on it.
+static bool isNoAliasArgument(Value v) {
+  if (!isFunctionArgument(v))
+    return false;
+  auto arg = v.cast<BlockArgument>();
+  auto fn = cast<FunctionOpInterface>(arg.getOwner()->getParentOp());
+  return (bool)fn.getArgAttr(arg.getArgNumber(),
+                             LLVM::LLVMDialect::getNoAliasAttrName());
+}
+
 static bool mayAlias(Value v, Value v2) {
   v = getBase(v);
   v2 = getBase(v2);
@@ -470,18 +494,23 @@ static bool mayAlias(Value v, Value v2) {
     return false;
 
   bool isArg[2];
-  isArg[0] = v.isa<BlockArgument>() &&
-             isa<FunctionOpInterface>(
-                 v.cast<BlockArgument>().getOwner()->getParentOp());
-
-  isArg[1] = v.isa<BlockArgument>() &&
-             isa<FunctionOpInterface>(
-                 v.cast<BlockArgument>().getOwner()->getParentOp());
+  isArg[0] = isFunctionArgument(v);
+  isArg[1] = isFunctionArgument(v2);
 
   // Stack allocations cannot have been passed as an argument.
   if ((isAlloca[0] && isArg[1]) || (isAlloca[1] && isArg[0]))
     return false;
 
+  // A noalias argument is distinct from the other arguments, from globals
+  // and from allocations. Other pointers can only be based on it if it was
+  // captured.
+  bool isNoAlias[2] = {isNoAliasArgument(v), isNoAliasArgument(v2)};
+  if ((isNoAlias[0] && (isArg[1] || isGlobal[1] || isAlloca[1])) ||
+      (isNoAlias[1] && (isArg[0] || isGlobal[0] || isAlloca[0])))
+    return false;
+  if ((isNoAlias[0] && !isCaptured(v)) || (isNoAlias[1] && !isCaptured(v2)))
+    return false;
+
   // Non captured base allocas cannot conflict with another base value.
   if (isAlloca[0] && !isCaptured(v))
     return false;
@@ -492,8 +521,18 @@ static bool mayAlias(Value v, Value v2) {
   return true;
 }
 
+/// Whether accesses tagged with the type classes `tagA` and `tagB` may
+/// overlap under strict aliasing. Untagged accesses may alias anything.
+static bool mayAliasByType(Attribute tagA, Attribute tagB) {
+  auto nameA = tagA.dyn_cast_or_null<StringAttr>();
+  auto nameB = tagB.dyn_cast_or_null<StringAttr>();
+  return !nameA || !nameB || nameA == nameB;
+}
+
 bool mayAlias(MemoryEffects::EffectInstance a,
               MemoryEffects::EffectInstance b) {
+  if (!mayAliasByType(a.getParameters(), b.getParameters()))
+    return false;
   if (Value v2 = b.getValue()) {
     return mayAlias(a, v2);
   }
@@ -507,6 +546,16 @@ bool mayAlias(MemoryEffects::EffectInstance a, Value v2) {
   return true;
 }
 
+bool mayAliasByType(Operation *a, Operation *b) {
+  return mayAliasByType(a->getAttr(TypeTagAttrName),
+                        b->getAttr(TypeTagAttrName));
+}
+
+void copyLoopHints(Operation *from, Operation *to) {
+  if (auto hints = from->getAttr(LoopHintsAttrName))
+    to->setAttr(LoopHintsAttrName, hints);
+}
+
 void BarrierOp::getCanonicalizationPatterns(RewritePatternSet &results,
                                             MLIRContext *context) {
   results.insert<BarrierHoist, BarrierElim</*TopLevelOnly*/ false>>(context);
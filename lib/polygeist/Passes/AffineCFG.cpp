@@ -876,6 +876,36 @@ struct SimplfyIntegerCastMath : public OpRewritePattern<IndexCastOp> {
 };
 */
 
+/// Distribute an index_cast over signed integer arithmetic that cannot
+/// overflow, turning e.g. index_cast(i * N + j) into an affine expression of
+/// index_cast(i), index_cast(N) and index_cast(j). Without the no-wrap
+/// guarantee the sign extension does not commute with the arithmetic.
+struct DistributeNoWrapIndexCast : public OpRewritePattern<IndexCastOp> {
+  using OpRewritePattern<IndexCastOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(IndexCastOp op,
+                                PatternRewriter &rewriter) const override {
+    if (!op.getType().isIndex())
+      return failure();
+    Operation *arith = op.getIn().getDefiningOp();
+    if (!isa_and_nonnull<AddIOp, SubIOp, MulIOp>(arith) ||
+        !arith->hasAttr(NoSignedWrapAttrName))
+      return failure();
+
+    SmallVector<Value, 2> operands;
+    for (Value v : arith->getOperands()) {
+      OpBuilder::InsertionGuard guard(rewriter);
+      setLocationAfter(rewriter, v);
+      operands.push_back(
+          rewriter.create<IndexCastOp>(op.getLoc(), op.getType(), v));
+    }
+    OperationState state(arith->getLoc(), arith->getName(), operands,
+                         op.getType(), arith->getAttrs());
+    rewriter.replaceOp(op, rewriter.create(state)->getResults());
+    return success();
+  }
+};
+
 struct CanonicalizeAffineApply : public OpRewritePattern<AffineApplyOp> {
   using OpRewritePattern<AffineApplyOp>::OpRewritePattern;
 
@@ -1250,6 +1280,8 @@ struct MoveLoadToAffine : public OpRewritePattern<memref::LoadOp> {
 
     AffineLoadOp affineLoad = rewriter.create<AffineLoadOp>(
         load.getLoc(), load.getMemRef(), map, operands);
+    if (auto tag = load->getAttr(TypeTagAttrName))
+      affineLoad->setAttr(TypeTagAttrName, tag);
     load.getResult().replaceAllUsesWith(affineLoad.getResult());
     rewriter.eraseOp(load);
     return success();
@@ -1283,8 +1315,11 @@ struct MoveStoreToAffine : public OpRewritePattern<memref::StoreOp> {
     fully2ComposeAffineMapAndOperands(rewriter, &map, &operands, DI);
     canonicalizeMapAndOperands(&map, &operands);
 
-    rewriter.create<AffineStoreOp>(store.getLoc(), store.getValueToStore(),
-                                   store.getMemRef(), map, operands);
+    auto affineStore = rewriter.create<AffineStoreOp>(
+        store.getLoc(), store.getValueToStore(), store.getMemRef(), map,
+        operands);
+    if (auto tag = store->getAttr(TypeTagAttrName))
+      affineStore->setAttr(TypeTagAttrName, tag);
     rewriter.eraseOp(store);
     return success();
   }
@@ -1538,8 +1573,8 @@ struct MoveIfToAffine : public OpRewritePattern<scf::IfOp> {
 
 void AffineCFGPass::runOnOperation() {
   mlir::RewritePatternSet rpl(getOperation()->getContext());
-  rpl.add</*SimplfyIntegerCastMath, */ CanonicalizeAffineApply,
-          CanonicalizeIndexCast,
+  rpl.add</*SimplfyIntegerCastMath, */ DistributeNoWrapIndexCast,
+          CanonicalizeAffineApply, CanonicalizeIndexCast,
           /* IndexCastMovement,*/ AffineFixup<AffineLoadOp>,
           AffineFixup<AffineStoreOp>, CanonicalizIfBounds, MoveStoreToAffine,
           MoveIfToAffine, MoveLoadToAffine, CanonicalieForBounds>(
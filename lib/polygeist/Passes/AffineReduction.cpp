@@ -171,6 +171,7 @@ struct AffineForReductionIter : public OpRewritePattern<AffineForOp> {
         forOp.getLoc(), forOp.getLowerBoundOperands(), forOp.getLowerBoundMap(),
         forOp.getUpperBoundOperands(), forOp.getUpperBoundMap(),
         forOp.getStep(), newIterArgs);
+    copyLoopHints(forOp, newForOp);
 
     // remove load operation inside the for.
     size_t i = 0;
@@ -433,6 +433,7 @@ struct RemoveUnusedArgs : public OpRewritePattern<ForOp> {
     auto newForOp =
         rewriter.create<ForOp>(op.getLoc(), op.getLowerBound(),
                                op.getUpperBound(), op.getStep(), usedOperands);
+    copyLoopHints(op, newForOp);
 
     if (!newForOp.getBody()->empty())
       rewriter.eraseOp(newForOp.getBody()->getTerminator());
@@ -929,6 +930,7 @@ struct MoveWhileToFor : public OpRewritePattern<WhileOp> {
 
     auto forloop = rewriter.create<scf::ForOp>(loop.getLoc(), helper.lb,
                                                helper.ub, helper.step, forArgs);
+    copyLoopHints(loop, forloop);
 
     if (!forloop.getBody()->empty())
       rewriter.eraseOp(forloop.getBody()->getTerminator());
@@ -1048,6 +1050,7 @@ struct MoveWhileAndDown : public OpRewritePattern<WhileOp> {
         resTys.push_back(a.getType());
 
       auto nop = rewriter.create<WhileOp>(loop.getLoc(), resTys, nextInits);
+      copyLoopHints(loop, nop);
       rewriter.createBlock(&nop.getBefore());
       SmallVector<Value> newBeforeYieldArgs;
       for (auto a : origAfterArgs) {
@@ -1221,6 +1224,7 @@ struct MoveWhileDown : public OpRewritePattern<WhileOp> {
         tys.push_back(a.getType());
 
       auto op2 = rewriter.create<WhileOp>(op.getLoc(), tys, op.getInits());
+      copyLoopHints(op, op2);
       op2.getBefore().takeBody(op.getBefore());
       op2.getAfter().takeBody(op.getAfter());
       SmallVector<Value, 4> replacements;
@@ -1422,6 +1426,7 @@ struct MoveWhileDown2 : public OpRewritePattern<WhileOp> {
       rewriter.setInsertionPoint(op);
       auto nop =
           rewriter.create<WhileOp>(op.getLoc(), resultTypes, op.getInits());
+      copyLoopHints(op, nop);
       nop.getBefore().takeBody(op.getBefore());
       nop.getAfter().takeBody(op.getAfter());
 
@@ -1658,6 +1663,7 @@ struct RemoveWhileSelect : public OpRewritePattern<WhileOp> {
     }
     auto nop =
         rewriter.create<WhileOp>(loop.getLoc(), resultTypes, loop.getInits());
+    copyLoopHints(loop, nop);
 
     nop.getBefore().takeBody(loop.getBefore());
 
@@ -1755,6 +1761,7 @@ struct MoveWhileDown3 : public OpRewritePattern<WhileOp> {
     }
     auto nop =
         rewriter.create<WhileOp>(op.getLoc(), resultTypes, op.getInits());
+    copyLoopHints(op, nop);
 
     nop.getBefore().takeBody(op.getBefore());
     nop.getAfter().takeBody(op.getAfter());
@@ -1947,6 +1954,7 @@ struct RemoveUnusedCondVar : public OpRewritePattern<WhileOp> {
 
       rewriter.setInsertionPoint(op);
       auto op2 = rewriter.create<WhileOp>(op.getLoc(), tys, op.getInits());
+      copyLoopHints(op, op2);
 
       op2.getBefore().takeBody(op.getBefore());
       op2.getAfter().takeBody(op.getAfter());
@@ -1992,6 +2000,7 @@ struct MoveSideEffectFreeWhile : public OpRewritePattern<WhileOp> {
         tys.push_back(arg.getType());
       }
       auto op2 = rewriter.create<WhileOp>(op.getLoc(), tys, op.getInits());
+      copyLoopHints(op, op2);
       op2.getBefore().takeBody(op.getBefore());
       op2.getAfter().takeBody(op.getAfter());
       unsigned j = 0;
@@ -2170,6 +2179,7 @@ struct WhileShiftToInduction : public OpRewritePattern<WhileOp> {
     postTys.push_back(rewriter.getIndexType());
 
     auto newWhile = rewriter.create<WhileOp>(loop.getLoc(), postTys, newInits);
+    copyLoopHints(loop, newWhile);
     rewriter.createBlock(&newWhile.getBefore());
 
     BlockAndValueMapping map;
@@ -0,0 +1,282 @@
+//===- ConvertParallelToOpenMP.cpp - Lower parallel loops to OpenMP -------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a pass lowering scf.parallel loops to OpenMP worksharing
+// loops, guided by an estimate of the work each loop performs. Loops too small
+// to pay for a parallel region run serially, perfectly nested parallel loops
+// are collapsed when the outer one has too few iterations to keep the threads
+// busy, and loops whose inner loops have bounds depending on the parallel
+// induction variables are scheduled dynamically.
+//===----------------------------------------------------------------------===//
+#include "PassDetails.h"
+
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/OpenMP/OpenMPDialect.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Dialect/Utils/StaticValueUtils.h"
+#include "mlir/IR/PatternMatch.h"
+#include "mlir/Interfaces/CallInterfaces.h"
+#include "polygeist/Ops.h"
+#include "polygeist/Passes/Passes.h"
+#include "llvm/Support/MathExtras.h"
+
+#define DEBUG_TYPE "convert-parallel-to-openmp"
+
+using namespace mlir;
+using namespace polygeist;
+
+namespace {
+struct ConvertParallelToOpenMP
+    : public ConvertParallelToOpenMPBase<ConvertParallelToOpenMP> {
+  void runOnOperation() override;
+};
+} // end anonymous namespace
+
+namespace mlir {
+namespace polygeist {
+std::unique_ptr<Pass> createConvertParallelToOpenMPPass() {
+  return std::make_unique<ConvertParallelToOpenMP>();
+}
+} // namespace polygeist
+} // namespace mlir
+
+/// The number of iterations of a loop nest with the given bounds, or None if
+/// it is not a constant.
+static Optional<uint64_t> getTripCount(ValueRange lbs, ValueRange ubs,
+                                       ValueRange steps) {
+  uint64_t trips = 1;
+  for (auto [lb, ub, step] : llvm::zip(lbs, ubs, steps)) {
+    auto lbCst = getConstantIntValue(lb);
+    auto ubCst = getConstantIntValue(ub);
+    auto stepCst = getConstantIntValue(step);
+    if (!lbCst || !ubCst || !stepCst || *stepCst <= 0)
+      return llvm::None;
+    if (*ubCst <= *lbCst)
+      return 0;
+    trips = llvm::SaturatingMultiply(
+        trips, (uint64_t)((*ubCst - *lbCst + *stepCst - 1) / *stepCst));
+  }
+  return trips;
+}
+
+/// Estimated number of operations executed by running `block` once, or None
+/// if it calls functions or runs loops whose trip count is not a constant.
+static Optional<uint64_t> getWork(Block &block) {
+  uint64_t work = 0;
+  for (Operation &op : block) {
+    if (isa<CallOpInterface, scf::WhileOp>(op))
+      return llvm::None;
+
+    Optional<uint64_t> trips = 1;
+    if (auto forOp = dyn_cast<scf::ForOp>(op))
+      trips = getTripCount(forOp.getLowerBound(), forOp.getUpperBound(),
+                           forOp.getStep());
+    else if (auto parOp = dyn_cast<scf::ParallelOp>(op))
+      trips = getTripCount(parOp.getLowerBound(), parOp.getUpperBound(),
+                           parOp.getStep());
+    if (!trips)
+      return llvm::None;
+
+    // Both branches of a conditional are counted, which overestimates.
+    uint64_t opWork = 1;
+    for (Region &region : op.getRegions())
+      for (Block &nested : region) {
+        auto nestedWork = getWork(nested);
+        if (!nestedWork)
+          return llvm::None;
+        opWork = llvm::SaturatingAdd(
+            opWork, llvm::SaturatingMultiply(*trips, *nestedWork));
+      }
+    work = llvm::SaturatingAdd(work, opWork);
+  }
+  return work;
+}
+
+/// Whether `val` is computed from the induction variables of `parOp`.
+static bool dependsOnInductionVars(Value val, scf::ParallelOp parOp) {
+  SmallVector<Value> worklist = {val};
+  DenseSet<Value> seen;
+  while (!worklist.empty()) {
+    Value cur = worklist.pop_back_val();
+    if (!seen.insert(cur).second)
+      continue;
+    if (auto arg = cur.dyn_cast<BlockArgument>()) {
+      if (arg.getOwner() == parOp.getBody())
+        return true;
+      continue;
+    }
+    Operation *def = cur.getDefiningOp();
+    if (parOp->isProperAncestor(def))
+      worklist.append(def->operand_begin(), def->operand_end());
+  }
+  return false;
+}
+
+/// Whether the iterations of `parOp` run inner loops of different lengths,
+/// like the rows of a triangular loop nest.
+static bool isTriangular(scf::ParallelOp parOp) {
+  auto res = parOp.getBody()->walk([&](scf::ForOp forOp) {
+    if (dependsOnInductionVars(forOp.getLowerBound(), parOp) ||
+        dependsOnInductionVars(forOp.getUpperBound(), parOp) ||
+        dependsOnInductionVars(forOp.getStep(), parOp))
+      return WalkResult::interrupt();
+    return WalkResult::advance();
+  });
+  return res.wasInterrupted();
+}
+
+/// Replaces `parOp` by a nest of sequential loops.
+static void serialize(RewriterBase &rewriter, scf::ParallelOp parOp) {
+  rewriter.setInsertionPoint(parOp);
+  SmallVector<Value> inds;
+  scf::ForOp last = nullptr;
+  for (auto [lb, ub, step] : llvm::zip(
+           parOp.getLowerBound(), parOp.getUpperBound(), parOp.getStep())) {
+    last = rewriter.create<scf::ForOp>(parOp.getLoc(), lb, ub, step);
+    inds.push_back(last.getInductionVar());
+    rewriter.setInsertionPointToStart(last.getBody());
+  }
+  copyLoopHints(parOp, last);
+  rewriter.eraseOp(last.getBody()->getTerminator());
+  rewriter.mergeBlocks(parOp.getBody(), last.getBody(), inds);
+  rewriter.eraseOp(parOp);
+}
+
+/// Collects the parallel loops nested in `block` that can be serialized, in
+/// pre-order. Loops with results are reductions, which are left to the
+/// upstream conversion along with the loops nested in them.
+static void collectSerializable(Block &block,
+                                SmallVectorImpl<scf::ParallelOp> &loops) {
+  block.walk<WalkOrder::PreOrder>([&](scf::ParallelOp op) {
+    if (op.getNumResults())
+      return WalkResult::skip();
+    loops.push_back(op);
+    return WalkResult::advance();
+  });
+}
+
+/// Merges the parallel loop making up the whole body of `parOp` into it,
+/// returning the combined loop, or null if the inner bounds are computed
+/// within `parOp`.
+static scf::ParallelOp collapse(RewriterBase &rewriter,
+                                scf::ParallelOp parOp) {
+  auto innerOp = dyn_cast<scf::ParallelOp>(&parOp.getBody()->front());
+  if (!innerOp || innerOp->getNextNode() != parOp.getBody()->getTerminator() ||
+      innerOp.getNumResults())
+    return nullptr;
+  for (Value bound : innerOp->getOperands())
+    if (parOp->isAncestor(bound.getParentRegion()->getParentOp()))
+      return nullptr;
+
+  auto lbs = llvm::to_vector(parOp.getLowerBound());
+  auto ubs = llvm::to_vector(parOp.getUpperBound());
+  auto steps = llvm::to_vector(parOp.getStep());
+  llvm::append_range(lbs, innerOp.getLowerBound());
+  llvm::append_range(ubs, innerOp.getUpperBound());
+  llvm::append_range(steps, innerOp.getStep());
+
+  rewriter.setInsertionPoint(parOp);
+  auto newOp = rewriter.create<scf::ParallelOp>(parOp.getLoc(), lbs, ubs,
+                                                steps);
+  copyLoopHints(parOp, newOp);
+  auto newInds = newOp.getInductionVars();
+  unsigned numOuter = parOp.getNumLoops();
+  for (auto [oldInd, newInd] :
+       llvm::zip(parOp.getInductionVars(), newInds.take_front(numOuter)))
+    oldInd.replaceAllUsesWith(newInd);
+  rewriter.eraseOp(newOp.getBody()->getTerminator());
+  rewriter.mergeBlocks(innerOp.getBody(), newOp.getBody(),
+                       newInds.drop_front(numOuter));
+  rewriter.eraseOp(parOp);
+  return newOp;
+}
+
+/// Replaces `parOp` by an OpenMP parallel region running it as a worksharing
+/// loop, whose iterations are scheduled dynamically if `dynamic` is set.
+static void convertToOpenMP(RewriterBase &rewriter, scf::ParallelOp parOp,
+                            bool dynamic) {
+  Location loc = parOp.getLoc();
+  rewriter.setInsertionPoint(parOp);
+  auto ompParallel = rewriter.create<omp::ParallelOp>(loc);
+  rewriter.createBlock(&ompParallel.getRegion());
+  auto loop = rewriter.create<omp::WsLoopOp>(
+      loc, parOp.getLowerBound(), parOp.getUpperBound(), parOp.getStep());
+  loop.setScheduleValAttr(omp::ClauseScheduleKindAttr::get(
+      rewriter.getContext(), dynamic ? omp::ClauseScheduleKind::Dynamic
+                                     : omp::ClauseScheduleKind::Static));
+  rewriter.create<omp::TerminatorOp>(loc);
+
+  // The body runs in an alloca scope, so that its stack allocations are
+  // released at the end of every iteration.
+  rewriter.inlineRegionBefore(parOp.getRegion(), loop.getRegion(),
+                              loop.getRegion().end());
+  Block *body = &loop.getRegion().front();
+  Block *ops = rewriter.splitBlock(body, body->begin());
+  rewriter.setInsertionPointToStart(body);
+  auto scope = rewriter.create<memref::AllocaScopeOp>(loc, TypeRange());
+  rewriter.create<omp::YieldOp>(loc, ValueRange());
+  Block *scopeBlock = rewriter.createBlock(&scope.getBodyRegion());
+  rewriter.mergeBlocks(ops, scopeBlock);
+  auto yield = cast<scf::YieldOp>(scopeBlock->getTerminator());
+  rewriter.setInsertionPoint(yield);
+  rewriter.replaceOpWithNewOp<memref::AllocaScopeReturnOp>(yield,
+                                                           ValueRange());
+  rewriter.eraseOp(parOp);
+}
+
+void ConvertParallelToOpenMP::runOnOperation() {
+  // Parallel loops with results are reductions, which are left to the
+  // upstream conversion, along with the loops nested in them.
+  SmallVector<scf::ParallelOp> outermost;
+  getOperation()->walk([&](scf::ParallelOp parOp) {
+    if (!parOp->getParentOfType<scf::ParallelOp>() && !parOp.getNumResults())
+      outermost.push_back(parOp);
+  });
+
+  IRRewriter rewriter(&getContext());
+  for (auto parOp : outermost) {
+    // Nested parallel regions only run on one thread by default, so a loop
+    // already in one runs serially.
+    if (parOp->getParentOfType<omp::ParallelOp>()) {
+      SmallVector<scf::ParallelOp> nested = {parOp};
+      collectSerializable(*parOp.getBody(), nested);
+      for (auto op : nested)
+        serialize(rewriter, op);
+      continue;
+    }
+
+    // Collapsing adds index computations to every iteration, which only pays
+    // when the outer loop has too few iterations to share among the threads.
+    while (true) {
+      auto trips = getTripCount(parOp.getLowerBound(), parOp.getUpperBound(),
+                                parOp.getStep());
+      if (!trips || *trips >= collapseBelow)
+        break;
+      auto collapsed = collapse(rewriter, parOp);
+      if (!collapsed)
+        break;
+      parOp = collapsed;
+    }
+
+    SmallVector<scf::ParallelOp> nested;
+    collectSerializable(*parOp.getBody(), nested);
+    for (auto op : nested)
+      serialize(rewriter, op);
+
+    auto trips = getTripCount(parOp.getLowerBound(), parOp.getUpperBound(),
+                              parOp.getStep());
+    auto bodyWork = getWork(*parOp.getBody());
+    if (trips && bodyWork &&
+        llvm::SaturatingMultiply(*trips, *bodyWork) < minWork) {
+      serialize(rewriter, parOp);
+      continue;
+    }
+
+    convertToOpenMP(rewriter, parOp, isTriangular(parOp));
+  }
+}
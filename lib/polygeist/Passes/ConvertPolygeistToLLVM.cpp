@@ -22,7 +22,9 @@
 #include "mlir/Conversion/MemRefToLLVM/MemRefToLLVM.h"
 #include "mlir/Conversion/OpenMPToLLVM/ConvertOpenMPToLLVM.h"
 #include "mlir/Conversion/SCFToControlFlow/SCFToControlFlow.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
 #include "mlir/Dialect/Async/IR/Async.h"
+#include "mlir/Dialect/ControlFlow/IR/ControlFlowOps.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/Func/Transforms/Passes.h"
 #include "mlir/Dialect/LLVMIR/FunctionCallUtils.h"
@@ -934,6 +936,13 @@ protected:
     return rewriter.create<LLVM::GEPOp>(
         loc, this->getElementPtrType(originalType), adaptor.getMemref(), args);
   }
+
+  /// Keeps the type tag of `op` on the LLVM access `newOp` replacing it, so
+  /// that it becomes TBAA metadata.
+  static void copyTypeTag(OpTy op, Operation *newOp) {
+    if (auto tag = op->getAttr(TypeTagAttrName))
+      newOp->setAttr(TypeTagAttrName, tag);
+  }
 };
 
 /// Pattern for lowering a memory load.
@@ -948,7 +957,8 @@ public:
     if (!address)
       return failure();
 
-    rewriter.replaceOpWithNewOp<LLVM::LoadOp>(loadOp, address);
+    auto newLoad = rewriter.replaceOpWithNewOp<LLVM::LoadOp>(loadOp, address);
+    copyTypeTag(loadOp, newLoad);
     return success();
   }
 };
@@ -965,8 +975,9 @@ public:
     if (!address)
       return failure();
 
-    rewriter.replaceOpWithNewOp<LLVM::StoreOp>(storeOp, adaptor.getValue(),
-                                               address);
+    auto newStore = rewriter.replaceOpWithNewOp<LLVM::StoreOp>(
+        storeOp, adaptor.getValue(), address);
+    copyTypeTag(storeOp, newStore);
     return success();
   }
 };
@@ -1059,9 +1070,15 @@ static SmallVector<NamedAttribute> convertFuncAttributes(
       }
       auto mapping = signatureConversion.getInputMapping(i);
       assert(mapping && "unexpected deletion of function argument");
-      for (size_t j = 0; j < mapping->size; ++j)
+      ArrayRef<Type> convertedTypes = signatureConversion.getConvertedTypes();
+      for (size_t j = 0; j < mapping->size; ++j) {
+        // Of an expanded memref descriptor only the pointers can be noalias.
+        NamedAttrList argAttrs(convertedAttrs);
+        if (!convertedTypes[mapping->inputNo + j].isa<LLVM::LLVMPointerType>())
+          argAttrs.erase(LLVM::LLVMDialect::getNoAliasAttrName());
         newArgAttrs[mapping->inputNo + j] =
-            DictionaryAttr::get(rewriter.getContext(), convertedAttrs);
+            argAttrs.getDictionary(rewriter.getContext());
+      }
     }
     attributes.push_back(
         rewriter.getNamedAttr(FunctionOpInterface::getArgDictAttrName(),
@@ -1253,6 +1270,104 @@ populateCStyleFuncLoweringPatterns(RewritePatternSet &patterns,
 }
 } // namespace
 
+namespace {
+/// Lowers an scf.for carrying loop hints to a CFG like the upstream lowering,
+/// moving the hints to the branch closing its back edge.
+struct HintedForLowering : public OpRewritePattern<scf::ForOp> {
+  using OpRewritePattern<scf::ForOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(scf::ForOp forOp,
+                                PatternRewriter &rewriter) const override {
+    if (!forOp->hasAttr(LoopHintsAttrName))
+      return failure();
+    Location loc = forOp.getLoc();
+
+    Block *initBlock = rewriter.getInsertionBlock();
+    Block *endBlock =
+        rewriter.splitBlock(initBlock, rewriter.getInsertionPoint());
+
+    // The first body block, holding the induction variable and loop-carried
+    // values as arguments, becomes the condition block.
+    Block *conditionBlock = &forOp.getRegion().front();
+    Block *firstBodyBlock =
+        rewriter.splitBlock(conditionBlock, conditionBlock->begin());
+    Block *lastBodyBlock = &forOp.getRegion().back();
+    rewriter.inlineRegionBefore(forOp.getRegion(), endBlock);
+    Value iv = conditionBlock->getArgument(0);
+
+    Operation *terminator = lastBodyBlock->getTerminator();
+    rewriter.setInsertionPointToEnd(lastBodyBlock);
+    SmallVector<Value, 8> loopCarried;
+    loopCarried.push_back(
+        rewriter.create<arith::AddIOp>(loc, iv, forOp.getStep()));
+    loopCarried.append(terminator->operand_begin(), terminator->operand_end());
+    auto backEdge =
+        rewriter.create<cf::BranchOp>(loc, conditionBlock, loopCarried);
+    copyLoopHints(forOp, backEdge);
+    rewriter.eraseOp(terminator);
+
+    rewriter.setInsertionPointToEnd(initBlock);
+    SmallVector<Value, 8> destOperands;
+    destOperands.push_back(forOp.getLowerBound());
+    llvm::append_range(destOperands, forOp.getIterOperands());
+    rewriter.create<cf::BranchOp>(loc, conditionBlock, destOperands);
+
+    rewriter.setInsertionPointToEnd(conditionBlock);
+    auto comparison = rewriter.create<arith::CmpIOp>(
+        loc, arith::CmpIPredicate::slt, iv, forOp.getUpperBound());
+    rewriter.create<cf::CondBranchOp>(loc, comparison, firstBodyBlock,
+                                      ArrayRef<Value>(), endBlock,
+                                      ArrayRef<Value>());
+
+    rewriter.replaceOp(forOp, conditionBlock->getArguments().drop_front());
+    return success();
+  }
+};
+
+/// Lowers an scf.while carrying loop hints to a CFG like the upstream
+/// lowering, moving the hints to the branch closing its back edge.
+struct HintedWhileLowering : public OpRewritePattern<scf::WhileOp> {
+  using OpRewritePattern<scf::WhileOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(scf::WhileOp whileOp,
+                                PatternRewriter &rewriter) const override {
+    if (!whileOp->hasAttr(LoopHintsAttrName))
+      return failure();
+    OpBuilder::InsertionGuard guard(rewriter);
+    Location loc = whileOp.getLoc();
+
+    Block *currentBlock = rewriter.getInsertionBlock();
+    Block *continuation =
+        rewriter.splitBlock(currentBlock, rewriter.getInsertionPoint());
+
+    Block *after = &whileOp.getAfter().front();
+    Block *afterLast = &whileOp.getAfter().back();
+    Block *before = &whileOp.getBefore().front();
+    Block *beforeLast = &whileOp.getBefore().back();
+    rewriter.inlineRegionBefore(whileOp.getAfter(), continuation);
+    rewriter.inlineRegionBefore(whileOp.getBefore(), after);
+
+    rewriter.setInsertionPointToEnd(currentBlock);
+    rewriter.create<cf::BranchOp>(loc, before, whileOp.getInits());
+
+    rewriter.setInsertionPointToEnd(beforeLast);
+    auto condOp = cast<scf::ConditionOp>(beforeLast->getTerminator());
+    rewriter.replaceOpWithNewOp<cf::CondBranchOp>(
+        condOp, condOp.getCondition(), after, condOp.getArgs(), continuation,
+        ValueRange());
+
+    rewriter.setInsertionPointToEnd(afterLast);
+    auto yieldOp = cast<scf::YieldOp>(afterLast->getTerminator());
+    auto backEdge = rewriter.replaceOpWithNewOp<cf::BranchOp>(
+        yieldOp, before, yieldOp.getResults());
+    copyLoopHints(whileOp, backEdge);
+
+    rewriter.replaceOp(whileOp, condOp.getArgs());
+    return success();
+  }
+};
+} // namespace
+
 //===-----------------------------------------------------------------------===/
 
 namespace {
@@ -1326,6 +1441,8 @@ struct ConvertPolygeistToLLVMPass
       RewritePatternSet patterns(&getContext());
       populatePolygeistToLLVMConversionPatterns(converter, patterns);
       populateSCFToControlFlowConversionPatterns(patterns);
+      patterns.add<HintedForLowering, HintedWhileLowering>(&getContext(),
+                                                           /*benefit=*/2);
       populateForBreakToWhilePatterns(patterns);
       cf::populateControlFlowToLLVMConversionPatterns(converter, patterns);
       if (useCStyleMemRef) {
@@ -1361,7 +1478,8 @@ struct ConvertPolygeistToLLVMPass
       };
 
       LLVMConversionTarget target(getContext());
-      target.addDynamicallyLegalOp<omp::ParallelOp, omp::WsLoopOp>(
+      target.addDynamicallyLegalOp<omp::ParallelOp, omp::WsLoopOp,
+                                   omp::AtomicUpdateOp, omp::TaskOp>(
           [&](Operation *op) { return converter.isLegal(&op->getRegion(0)); });
       target.addIllegalOp<scf::ForOp, scf::IfOp, scf::ParallelOp, scf::WhileOp,
                           scf::ExecuteRegionOp, func::FuncOp>();
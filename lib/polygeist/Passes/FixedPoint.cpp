@@ -0,0 +1,135 @@
+//===- FixedPoint.cpp - Run a pipeline until it converges -----------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a pass that repeats a nested pipeline until the IR it
+// runs on stops changing, in place of hand-unrolled chains of cleanup passes.
+//===----------------------------------------------------------------------===//
+#include "PassDetails.h"
+
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/Pass/PassManager.h"
+#include "mlir/Pass/PassRegistry.h"
+#include "polygeist/Passes/Passes.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <array>
+
+#define DEBUG_TYPE "fixed-point"
+
+using namespace mlir;
+using namespace polygeist;
+
+using FingerPrint = std::array<uint8_t, 20>;
+
+/// Summarize `root` by the identity of every operation and block nested in
+/// it together with their attributes, operands, result types and block
+/// arguments. Rewrites that change the IR create, erase, move or update
+/// operations and therefore change the fingerprint.
+static FingerPrint computeFingerPrint(Operation *root) {
+  llvm::SHA1 hasher;
+  auto addPointer = [&](const void *ptr) {
+    hasher.update(ArrayRef<uint8_t>(reinterpret_cast<const uint8_t *>(&ptr),
+                                    sizeof(ptr)));
+  };
+  root->walk<WalkOrder::PreOrder>([&](Operation *op) {
+    addPointer(op);
+    addPointer(op->getAttrDictionary().getAsOpaquePointer());
+    for (Value operand : op->getOperands())
+      addPointer(operand.getAsOpaquePointer());
+    for (Type type : op->getResultTypes())
+      addPointer(type.getAsOpaquePointer());
+    for (Block *successor : op->getSuccessors())
+      addPointer(successor);
+    for (Region &region : op->getRegions())
+      for (Block &block : region) {
+        addPointer(&block);
+        for (BlockArgument arg : block.getArguments())
+          addPointer(arg.getType().getAsOpaquePointer());
+      }
+  });
+  return hasher.result();
+}
+
+namespace {
+struct FixedPoint : public FixedPointBase<FixedPoint> {
+  FixedPoint() = default;
+  FixedPoint(OpPassManager nested, unsigned iterations) {
+    std::string str;
+    llvm::raw_string_ostream os(str);
+    nested.printAsTextualPipeline(os);
+    pipeline = os.str();
+    maxIterations = iterations;
+    anchor = nested.getOpName().str();
+    group = std::move(nested);
+  }
+
+  void getDependentDialects(DialectRegistry &registry) const override {
+    if (group) {
+      group->getDependentDialects(registry);
+      return;
+    }
+    OpPassManager parsed(ModuleOp::getOperationName());
+    if (succeeded(
+            parsePassPipeline(pipeline.getValue(), parsed, llvm::nulls())))
+      parsed.getDependentDialects(registry);
+  }
+
+  void runOnOperation() override;
+
+private:
+  /// The pipeline to repeat, anchored on `anchor`. Textual pipelines are
+  /// parsed when the pass first runs, once the anchor is known.
+  Optional<OpPassManager> group;
+  std::string anchor;
+};
+} // end anonymous namespace
+
+void FixedPoint::runOnOperation() {
+  Operation *op = getOperation();
+  StringRef opName = op->getName().getStringRef();
+  if (!group || anchor != opName) {
+    OpPassManager parsed(opName);
+    if (failed(parsePassPipeline(pipeline.getValue(), parsed))) {
+      op->emitError() << "failed to parse fixed-point pipeline '"
+                      << pipeline.getValue() << "'";
+      return signalPassFailure();
+    }
+    group = std::move(parsed);
+    anchor = opName.str();
+  }
+
+  FingerPrint before = computeFingerPrint(op);
+  for (unsigned i = 0; i < maxIterations; i++) {
+    numIterations++;
+    if (failed(runPipeline(*group, op)))
+      return signalPassFailure();
+    FingerPrint after = computeFingerPrint(op);
+    if (after == before) {
+      LLVM_DEBUG(llvm::dbgs() << "converged after " << (i + 1)
+                              << " iterations\n");
+      return;
+    }
+    before = after;
+  }
+  LLVM_DEBUG(llvm::dbgs() << "stopped after " << maxIterations
+                          << " iterations without converging\n");
+}
+
+namespace mlir {
+namespace polygeist {
+std::unique_ptr<Pass> createFixedPointPass() {
+  return std::make_unique<FixedPoint>();
+}
+std::unique_ptr<Pass> createFixedPointPass(OpPassManager pipeline,
+                                           unsigned maxIterations) {
+  return std::make_unique<FixedPoint>(std::move(pipeline), maxIterations);
+}
+} // namespace polygeist
+} // namespace mlir
@@ -157,8 +157,9 @@ struct ForBreakLoweringPattern : public OpRewritePattern<ForOp> {
                                                  next, forOp.getUpperBound());
     Value andOp =
         rewriter.create<arith::AndIOp>(loc, cmpOp, innerExitArgs[iterArgPos]);
-    rewriter.create<cf::CondBranchOp>(loc, andOp, forBegin, continueArgs,
-                                      continuation, innerExitArgs);
+    auto backEdge = rewriter.create<cf::CondBranchOp>(
+        loc, andOp, forBegin, continueArgs, continuation, innerExitArgs);
+    copyLoopHints(forOp, backEdge);
 
     rewriter.replaceOp(forOp, continuation->getArguments());
 
@@ -0,0 +1,86 @@
+//===- LoopHintUnroll.cpp - Unroll affine loops following their hints ----===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a pass unrolling affine loops as requested by the
+// unroll pragmas of the source, recorded as loop hints by the frontend.
+//===----------------------------------------------------------------------===//
+#include "PassDetails.h"
+
+#include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/Affine/LoopUtils.h"
+#include "polygeist/Ops.h"
+#include "polygeist/Passes/Passes.h"
+
+#define DEBUG_TYPE "loop-hint-unroll"
+
+using namespace mlir;
+using namespace polygeist;
+
+namespace {
+struct LoopHintUnroll : public LoopHintUnrollBase<LoopHintUnroll> {
+  LoopHintUnroll() = default;
+  LoopHintUnroll(bool unrollFull) { this->unrollFull.setValue(unrollFull); }
+  void runOnOperation() override;
+};
+} // end anonymous namespace
+
+namespace mlir {
+namespace polygeist {
+std::unique_ptr<Pass> createLoopHintUnrollPass(bool unrollFull) {
+  return std::make_unique<LoopHintUnroll>(unrollFull);
+}
+} // namespace polygeist
+} // namespace mlir
+
+/// Replace the unroll hints of `forOp` by one that disables unrolling, so
+/// that neither this pass nor LLVM unrolls the loop again.
+static void disableUnroll(AffineForOp forOp, DictionaryAttr hints) {
+  NamedAttrList newHints(hints);
+  newHints.erase("unroll_count");
+  newHints.set("unroll", StringAttr::get(forOp.getContext(), "disable"));
+  forOp->setAttr(LoopHintsAttrName,
+                 newHints.getDictionary(forOp.getContext()));
+}
+
+void LoopHintUnroll::runOnOperation() {
+  // Inner loops come first, and whether a loop is innermost is decided before
+  // unrolling any of them, like the upstream unroller does.
+  SmallVector<std::pair<AffineForOp, bool>> loops;
+  getOperation()->walk([&](AffineForOp forOp) {
+    auto inner = forOp.getBody()->walk(
+        [](AffineForOp) { return WalkResult::interrupt(); });
+    loops.emplace_back(forOp, !inner.wasInterrupted());
+  });
+
+  for (auto [forOp, innermost] : loops) {
+    auto hints = forOp->getAttrOfType<DictionaryAttr>(LoopHintsAttrName);
+    StringRef unroll;
+    if (hints)
+      if (auto kind = hints.getAs<StringAttr>("unroll"))
+        unroll = kind.getValue();
+    IntegerAttr count;
+    if (hints)
+      count = hints.getAs<IntegerAttr>("unroll_count");
+
+    if (unroll == "disable")
+      continue;
+
+    if (count) {
+      // Disable further unrolling first, as the cleanup loop is a clone.
+      disableUnroll(forOp, hints);
+      if (count.getInt() > 1 &&
+          failed(loopUnrollByFactor(forOp, count.getInt())))
+        forOp->setAttr(LoopHintsAttrName, hints);
+      continue;
+    }
+
+    // Without a constant trip count, full unrolling is left to LLVM.
+    if (unroll == "full" || (unrollFull && innermost))
+      (void)loopUnrollFull(forOp);
+  }
+}
@@ -423,6 +423,10 @@ void LoopRestructure::runOnRegion(DominanceInfo &domInfo, Region &region) {
 
       auto loop = builder.create<mlir::scf::WhileOp>(
           header->front().getLoc(), combinedTypes, valsCallingLoop);
+      // Keep the hints the frontend attached to the back edges of the loop.
+      for (auto *block : header->getPredecessors())
+        if (L->contains((Wrapper *)block))
+          copyLoopHints(block->getTerminator(), loop);
       {
         SmallVector<Value, 4> RetVals;
         for (size_t i = 0; i < returns.size(); ++i) {
@@ -0,0 +1,99 @@
+//===- LowerAffine.cpp - Lower affine operations, keeping type tags -------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a pass lowering affine operations like -lower-affine,
+// except that loads and stores keep the type tags the frontend put on them,
+// so that they can still become TBAA metadata.
+//===----------------------------------------------------------------------===//
+#include "PassDetails.h"
+
+#include "mlir/Conversion/AffineToStandard/AffineToStandard.h"
+#include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/Affine/Utils.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/Transforms/DialectConversion.h"
+#include "polygeist/Ops.h"
+#include "polygeist/Passes/Passes.h"
+
+#define DEBUG_TYPE "polygeist-lower-affine"
+
+using namespace mlir;
+using namespace polygeist;
+
+namespace {
+struct LowerAffine : public LowerAffineBase<LowerAffine> {
+  void runOnOperation() override;
+};
+
+/// Lowers a tagged affine.load to a memref.load with the same tag.
+struct TaggedAffineLoadLowering : public OpRewritePattern<AffineLoadOp> {
+  using OpRewritePattern<AffineLoadOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(AffineLoadOp op,
+                                PatternRewriter &rewriter) const override {
+    Attribute tag = op->getAttr(TypeTagAttrName);
+    if (!tag)
+      return failure();
+    SmallVector<Value, 8> indices(op.getMapOperands());
+    auto resultOperands =
+        expandAffineMap(rewriter, op.getLoc(), op.getAffineMap(), indices);
+    if (!resultOperands)
+      return failure();
+    auto load = rewriter.replaceOpWithNewOp<memref::LoadOp>(
+        op, op.getMemRef(), *resultOperands);
+    load->setAttr(TypeTagAttrName, tag);
+    return success();
+  }
+};
+
+/// Lowers a tagged affine.store to a memref.store with the same tag.
+struct TaggedAffineStoreLowering : public OpRewritePattern<AffineStoreOp> {
+  using OpRewritePattern<AffineStoreOp>::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(AffineStoreOp op,
+                                PatternRewriter &rewriter) const override {
+    Attribute tag = op->getAttr(TypeTagAttrName);
+    if (!tag)
+      return failure();
+    SmallVector<Value, 8> indices(op.getMapOperands());
+    auto resultOperands =
+        expandAffineMap(rewriter, op.getLoc(), op.getAffineMap(), indices);
+    if (!resultOperands)
+      return failure();
+    auto store = rewriter.replaceOpWithNewOp<memref::StoreOp>(
+        op, op.getValueToStore(), op.getMemRef(), *resultOperands);
+    store->setAttr(TypeTagAttrName, tag);
+    return success();
+  }
+};
+} // end anonymous namespace
+
+namespace mlir {
+namespace polygeist {
+std::unique_ptr<Pass> createLowerAffinePass() {
+  return std::make_unique<LowerAffine>();
+}
+} // namespace polygeist
+} // namespace mlir
+
+void LowerAffine::runOnOperation() {
+  RewritePatternSet patterns(&getContext());
+  // Preferred over the upstream patterns for tagged accesses.
+  patterns.add<TaggedAffineLoadLowering, TaggedAffineStoreLowering>(
+      &getContext(), /*benefit=*/2);
+  populateAffineToStdConversionPatterns(patterns);
+
+  ConversionTarget target(getContext());
+  target.addLegalDialect<arith::ArithDialect, memref::MemRefDialect,
+                         scf::SCFDialect>();
+  if (failed(applyPartialConversion(getOperation(), target,
+                                    std::move(patterns))))
+    signalPassFailure();
+}
@@ -128,6 +128,12 @@ bool mayWriteTo(Operation *op, Value val, bool ignoreBarrier) {
   return true;
 }
 
+/// Whether `op` has clauses, like num_threads or proc_bind, that would be lost
+/// by rebuilding it.
+static bool hasClauses(omp::ParallelOp op) {
+  return op->getNumOperands() || op.getProcBindValAttr();
+}
+
 struct CombineParallel : public OpRewritePattern<omp::ParallelOp> {
   using OpRewritePattern<omp::ParallelOp>::OpRewritePattern;
 
@@ -178,6 +184,12 @@ struct CombineParallel : public OpRewritePattern<omp::ParallelOp> {
       return success(changed);
     }
 
+    // Both regions must run with the same threads.
+    if (prevParallel->getAttrDictionary() !=
+            nextParallel->getAttrDictionary() ||
+        !llvm::equal(prevParallel->getOperands(), nextParallel->getOperands()))
+      return success(changed);
+
     // TODO analyze if already has barrier at the end
     bool preBarrier = false;
     rewriter.setInsertionPointToEnd(&prevParallel.getRegion().front());
@@ -201,7 +213,8 @@ struct ParallelForInterchange : public OpRewritePattern<omp::ParallelOp> {
       return failure();
 
     auto prevFor = dyn_cast<scf::ForOp>(nextParallel->getParentOp());
-    if (!prevFor || prevFor->getResults().size())
+    if (!prevFor || prevFor->getResults().size() ||
+        hasClauses(nextParallel))
       return failure();
 
     rewriter.setInsertionPoint(prevFor);
@@ -242,7 +255,7 @@ struct ParallelIfInterchange : public OpRewritePattern<scf::IfOp> {
         return failure();
       nextParallel = dyn_cast<omp::ParallelOp>(&thenB->front());
     }
-    if (!nextParallel)
+    if (!nextParallel || hasClauses(nextParallel))
       return failure();
 
     omp::ParallelOp elseParallel = nullptr;
@@ -250,7 +263,7 @@ struct ParallelIfInterchange : public OpRewritePattern<scf::IfOp> {
       if (elseB->getOperations().size() != 2)
         return failure();
       elseParallel = dyn_cast<omp::ParallelOp>(&elseB->front());
-      if (!elseParallel)
+      if (!elseParallel || hasClauses(elseParallel))
         return failure();
     }
 
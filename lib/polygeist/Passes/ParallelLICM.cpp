@@ -93,6 +93,9 @@ static bool canBeParallelHoisted(Operation *op, Operation *scope,
                    << *b << "\n");
         return true;
       }
+      // Objects of different types cannot overlap under strict aliasing.
+      if (!mayAliasByType(op, b))
+        return false;
       for (auto res : readResources) {
         SmallVector<MemoryEffects::EffectInstance> effects;
         memEffect.getEffectsOnResource(res.getResource(), effects);
@@ -146,11 +146,36 @@ struct AlwaysInlinerInterface : public InlinerInterface {
   }
 };
 
-// TODO
+/// Function passes may run concurrently on sibling functions and call the
+/// helpers below to declare runtime functions in the shared parent module.
+/// A single lock serializes all such lookups and insertions.
+static std::mutex &getRuntimeDeclMutex() {
+  static std::mutex _mutex;
+  return _mutex;
+}
+
+/// Position `builder` so that runtime declarations form a name-sorted prefix
+/// of the module body. The resulting order does not depend on which thread
+/// declared a function first, keeping multithreaded output deterministic.
+static void setRuntimeDeclInsertionPoint(mlir::OpBuilder &builder,
+                                         mlir::ModuleOp module,
+                                         StringRef name) {
+  Block *body = module.getBody();
+  auto it = body->begin();
+  while (it != body->end()) {
+    auto fn = dyn_cast<LLVM::LLVMFuncOp>(&*it);
+    if (!fn || !fn.isExternal() ||
+        (fn.getName() != "free" && fn.getName() != "malloc") ||
+        fn.getName() >= name)
+      break;
+    ++it;
+  }
+  builder.setInsertionPoint(body, it);
+}
+
 mlir::Value callMalloc(mlir::OpBuilder &ibuilder, mlir::ModuleOp module,
                        mlir::Location loc, mlir::Value arg) {
-  static std::mutex _mutex;
-  std::unique_lock<std::mutex> lock(_mutex);
+  std::unique_lock<std::mutex> lock(getRuntimeDeclMutex());
 
   mlir::OpBuilder builder(module.getContext());
   SymbolTableCollection symbolTable;
@@ -168,7 +193,7 @@ mlir::Value callMalloc(mlir::OpBuilder &ibuilder, mlir::ModuleOp module,
         false);
 
     LLVM::Linkage lnk = LLVM::Linkage::External;
-    builder.setInsertionPointToStart(module.getBody());
+    setRuntimeDeclInsertionPoint(builder, module, "malloc");
     builder.create<LLVM::LLVMFuncOp>(module.getLoc(), "malloc", llvmFnType,
                                      lnk);
   }
@@ -178,8 +203,7 @@ mlir::Value callMalloc(mlir::OpBuilder &ibuilder, mlir::ModuleOp module,
   return ibuilder.create<mlir::LLVM::CallOp>(loc, fn, args)->getResult(0);
 }
 mlir::LLVM::LLVMFuncOp GetOrCreateFreeFunction(ModuleOp module) {
-  static std::mutex _mutex;
-  std::unique_lock<std::mutex> lock(_mutex);
+  std::unique_lock<std::mutex> lock(getRuntimeDeclMutex());
 
   mlir::OpBuilder builder(module.getContext());
   SymbolTableCollection symbolTable;
@@ -193,7 +217,7 @@ mlir::LLVM::LLVMFuncOp GetOrCreateFreeFunction(ModuleOp module) {
       false);
 
   LLVM::Linkage lnk = LLVM::Linkage::External;
-  builder.setInsertionPointToStart(module.getBody());
+  setRuntimeDeclInsertionPoint(builder, module, "free");
   return builder.create<LLVM::LLVMFuncOp>(module.getLoc(), "free", llvmFnType,
                                           lnk);
 }
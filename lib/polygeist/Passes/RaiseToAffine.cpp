@@ -138,6 +138,7 @@ struct ForOpRaising : public OpRewritePattern<scf::ForOp> {
       AffineForOp affineLoop = rewriter.create<AffineForOp>(
           loop.getLoc(), lbs, lbMap, ubs, ubMap, getStep(loop.getStep()),
           loop.getIterOperands());
+      copyLoopHints(loop, affineLoop);
 
       auto mergedYieldOp =
           cast<scf::YieldOp>(loop.getRegion().front().getTerminator());
@@ -163,3 +163,37 @@ module {
 // CHECK-NEXT:     return
 // CHECK-NEXT:   }
 
+
+// -----
+
+module {
+  func.func @nsw_index(%arg0: memref<?xf32>, %n: i32, %j: i32) {
+    affine.for %i = 0 to 10 {
+      %0 = arith.index_cast %i : index to i32
+      %1 = arith.muli %0, %n {polygeist.nsw} : i32
+      %2 = arith.addi %1, %j {polygeist.nsw} : i32
+      %3 = arith.index_cast %2 : i32 to index
+      %v = memref.load %arg0[%3] : memref<?xf32>
+      "test.use"(%v) : (f32) -> ()
+    }
+    return
+  }
+  func.func @wrap_index(%arg0: memref<?xf32>, %n: i32, %j: i32) {
+    affine.for %i = 0 to 10 {
+      %0 = arith.index_cast %i : index to i32
+      %1 = arith.muli %0, %n : i32
+      %2 = arith.addi %1, %j : i32
+      %3 = arith.index_cast %2 : i32 to index
+      %v = memref.load %arg0[%3] : memref<?xf32>
+      "test.use"(%v) : (f32) -> ()
+    }
+    return
+  }
+}
+
+// CHECK-LABEL:   func.func @nsw_index(
+// CHECK:           affine.for %[[I:.+]] = 0 to 10 {
+// CHECK-NEXT:        affine.load %arg0[%[[I]] * symbol(%{{.*}}) + symbol(%{{.*}})] : memref<?xf32>
+
+// CHECK-LABEL:   func.func @wrap_index(
+// CHECK:           memref.load %arg0[%{{.*}}] : memref<?xf32>
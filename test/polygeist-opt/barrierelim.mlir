@@ -137,3 +137,41 @@ module {
 // CHECK-NEXT:     }
 // CHECK-NEXT:     return
 // CHECK-NEXT:   }
+
+// -----
+
+module {
+  func.func @barrier_tbaa(%f: memref<?xf32>, %i: memref<?xi32>, %n: index) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %cst = arith.constant 1.000000e+00 : f32
+    scf.parallel (%t) = (%c0) to (%n) step (%c1) {
+      memref.store %cst, %f[%t] {polygeist.tbaa = "float"} : memref<?xf32>
+      "polygeist.barrier"(%t) : (index) -> ()
+      %v = memref.load %i[%t] {polygeist.tbaa = "int"} : memref<?xi32>
+      memref.store %v, %i[%c0] {polygeist.tbaa = "int"} : memref<?xi32>
+      scf.yield
+    }
+    return
+  }
+  func.func @barrier_untagged(%f: memref<?xf32>, %i: memref<?xi32>, %n: index) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %cst = arith.constant 1.000000e+00 : f32
+    scf.parallel (%t) = (%c0) to (%n) step (%c1) {
+      memref.store %cst, %f[%t] : memref<?xf32>
+      "polygeist.barrier"(%t) : (index) -> ()
+      %v = memref.load %i[%t] {polygeist.tbaa = "int"} : memref<?xi32>
+      memref.store %v, %i[%c0] {polygeist.tbaa = "int"} : memref<?xi32>
+      scf.yield
+    }
+    return
+  }
+}
+
+// Accesses to objects of different types do not need to be synchronized.
+// CHECK-LABEL:   func.func @barrier_tbaa(
+// CHECK-NOT:       polygeist.barrier
+// CHECK-LABEL:   func.func @barrier_untagged(
+// CHECK:           memref.store %{{.*}}, %arg0[%{{.*}}] : memref<?xf32>
+// CHECK-NEXT:      "polygeist.barrier"
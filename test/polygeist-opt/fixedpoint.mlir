@@ -0,0 +1,25 @@
+// RUN: polygeist-opt --fixed-point="max-iterations=2 pipeline=func.func(affine-loop-unroll{unroll-factor=2})" %s | FileCheck %s --check-prefix=CAP
+// RUN: polygeist-opt --fixed-point="max-iterations=10 pipeline=func.func(affine-loop-unroll{unroll-factor=2})" %s | FileCheck %s --check-prefix=FIX
+
+module {
+  func.func private @use(index)
+  func.func @unroll() {
+    affine.for %i = 0 to 8 {
+      func.call @use(%i) : (index) -> ()
+    }
+    return
+  }
+}
+
+// Every iteration unrolls the loop once more until nothing is left to unroll.
+
+// CAP-LABEL: func.func @unroll()
+// CAP:         affine.for %{{.*}} = 0 to 8 step 4 {
+// CAP-COUNT-4:   func.call @use
+// CAP-NOT:       func.call @use
+// CAP:         return
+
+// FIX-LABEL: func.func @unroll()
+// FIX-COUNT-8:   func.call @use
+// FIX-NOT:       func.call @use
+// FIX:         return
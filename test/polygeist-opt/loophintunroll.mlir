@@ -0,0 +1,65 @@
+// RUN: polygeist-opt --loop-hint-unroll="unroll-full=1" --split-input-file %s | FileCheck %s
+
+module {
+  func.func @count(%arg0: memref<?xf32>) {
+    %cst = arith.constant 0.000000e+00 : f32
+    affine.for %arg1 = 0 to 8 {
+      affine.store %cst, %arg0[%arg1] : memref<?xf32>
+    } {polygeist.loop_hints = {unroll_count = 4 : i64, vectorize = true}}
+    return
+  }
+}
+
+// CHECK-LABEL: func.func @count
+// CHECK: affine.for %{{.*}} = 0 to 8 step 4 {
+// CHECK-COUNT-4: affine.store
+// CHECK: } {polygeist.loop_hints = {unroll = "disable", vectorize = true}}
+
+// -----
+
+module {
+  func.func @disabled(%arg0: memref<?xf32>) {
+    %cst = arith.constant 0.000000e+00 : f32
+    affine.for %arg1 = 0 to 8 {
+      affine.store %cst, %arg0[%arg1] : memref<?xf32>
+    } {polygeist.loop_hints = {unroll = "disable"}}
+    return
+  }
+}
+
+// CHECK-LABEL: func.func @disabled
+// CHECK: affine.for %{{.*}} = 0 to 8 {
+// CHECK-NEXT: affine.store
+// CHECK-NEXT: } {polygeist.loop_hints = {unroll = "disable"}}
+
+// -----
+
+module {
+  func.func @innermost(%arg0: memref<?xf32>) {
+    %cst = arith.constant 0.000000e+00 : f32
+    affine.for %arg1 = 0 to 2 {
+      affine.store %cst, %arg0[%arg1] : memref<?xf32>
+    }
+    return
+  }
+}
+
+// CHECK-LABEL: func.func @innermost
+// CHECK-NOT: affine.for
+// CHECK-COUNT-2: affine.store
+
+// -----
+
+module {
+  func.func @unknown(%arg0: memref<?xf32>, %arg1: index) {
+    %cst = arith.constant 0.000000e+00 : f32
+    affine.for %arg2 = 0 to %arg1 {
+      affine.store %cst, %arg0[%arg2] : memref<?xf32>
+    } {polygeist.loop_hints = {unroll = "full"}}
+    return
+  }
+}
+
+// CHECK-LABEL: func.func @unknown
+// CHECK: affine.for %{{.*}} = 0 to %{{.*}} {
+// CHECK: } {polygeist.loop_hints = {unroll = "full"}}
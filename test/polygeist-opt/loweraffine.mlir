@@ -0,0 +1,20 @@
+// RUN: polygeist-opt --polygeist-lower-affine %s | FileCheck %s
+
+module {
+  func.func @tagged(%x: memref<?xf32>, %y: memref<?xi32>, %n: index) {
+    affine.for %i = 0 to %n {
+      %v = affine.load %x[%i + 1] {polygeist.tbaa = "float"} : memref<?xf32>
+      affine.store %v, %x[%i] {polygeist.tbaa = "float"} : memref<?xf32>
+      %w = affine.load %y[%i] : memref<?xi32>
+      affine.store %w, %y[%i + 1] : memref<?xi32>
+    }
+    return
+  }
+}
+
+// CHECK-LABEL:   func.func @tagged(
+// CHECK:           scf.for %[[I:.+]] = %{{.*}} to %{{.*}} step %{{.*}} {
+// CHECK:             %[[V:.+]] = memref.load %arg0[%{{.*}}] {polygeist.tbaa = "float"} : memref<?xf32>
+// CHECK-NEXT:        memref.store %[[V]], %arg0[%[[I]]] {polygeist.tbaa = "float"} : memref<?xf32>
+// CHECK-NEXT:        %[[W:.+]] = memref.load %arg1[%[[I]]] : memref<?xi32>
+// CHECK:             memref.store %[[W]], %arg1[%{{.*}}] : memref<?xi32>
@@ -51,3 +51,44 @@ module {
 // CHECK-NEXT:     }
 // CHECK-NEXT:     return
 // CHECK-NEXT:   }
+
+// -----
+
+module {
+  func.func private @inner(index) -> ()
+  func.func @clauses(%start : index, %end : index, %step : index, %n : i32) {
+    scf.for %arg15 = %start to %end step %step {
+      omp.parallel num_threads(%n : i32) {
+        func.call @inner(%arg15) : (index) -> ()
+        omp.terminator
+      }
+    }
+    omp.parallel proc_bind(spread) {
+      func.call @inner(%start) : (index) -> ()
+      omp.terminator
+    }
+    omp.parallel {
+      func.call @inner(%end) : (index) -> ()
+      omp.terminator
+    }
+    return
+  }
+}
+
+// CHECK:   func.func @clauses(%arg0: index, %arg1: index, %arg2: index, %arg3: i32) {
+// CHECK-NEXT:     scf.for %arg4 = %arg0 to %arg1 step %arg2 {
+// CHECK-NEXT:       omp.parallel num_threads(%arg3 : i32) {
+// CHECK-NEXT:         func.call @inner(%arg4) : (index) -> ()
+// CHECK-NEXT:         omp.terminator
+// CHECK-NEXT:       }
+// CHECK-NEXT:     }
+// CHECK-NEXT:     omp.parallel proc_bind(spread) {
+// CHECK-NEXT:       func.call @inner(%arg0) : (index) -> ()
+// CHECK-NEXT:       omp.terminator
+// CHECK-NEXT:     }
+// CHECK-NEXT:     omp.parallel {
+// CHECK-NEXT:       func.call @inner(%arg1) : (index) -> ()
+// CHECK-NEXT:       omp.terminator
+// CHECK-NEXT:     }
+// CHECK-NEXT:     return
+// CHECK-NEXT:   }
@@ -153,3 +153,68 @@ module {
 // CHECK-NEXT:     return
 // CHECK-NEXT:   }
 
+
+// -----
+
+module {
+  func.func @hoist_noalias(%out: memref<?xf32> {llvm.noalias}, %in: memref<?xf32> {llvm.noalias}, %arg1: index, %arg2: index) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    scf.parallel (%arg3) = (%arg1) to (%arg2) step (%c1) {
+      %v = memref.load %in[%c0] : memref<?xf32>
+      memref.store %v, %out[%arg3] : memref<?xf32>
+    }
+    return
+  }
+  func.func @nohoist_alias(%out: memref<?xf32>, %in: memref<?xf32>, %arg1: index, %arg2: index) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    scf.parallel (%arg3) = (%arg1) to (%arg2) step (%c1) {
+      %v = memref.load %in[%c0] : memref<?xf32>
+      memref.store %v, %out[%arg3] : memref<?xf32>
+    }
+    return
+  }
+}
+
+// CHECK-LABEL:   func.func @hoist_noalias(
+// CHECK:           %[[V:.+]] = memref.load %arg1[%c0] : memref<?xf32>
+// CHECK-NEXT:      scf.parallel
+// CHECK-NEXT:        memref.store %[[V]], %arg0[%arg4] : memref<?xf32>
+
+// CHECK-LABEL:   func.func @nohoist_alias(
+// CHECK:           scf.parallel
+// CHECK-NEXT:        memref.load %arg1[%c0] : memref<?xf32>
+
+// -----
+
+module {
+  func.func @hoist_tbaa(%out: memref<?xf32>, %in: memref<?xi32>, %arg1: index, %arg2: index) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    scf.parallel (%arg3) = (%arg1) to (%arg2) step (%c1) {
+      %v = memref.load %in[%c0] {polygeist.tbaa = "int"} : memref<?xi32>
+      %f = arith.sitofp %v : i32 to f32
+      memref.store %f, %out[%arg3] {polygeist.tbaa = "float"} : memref<?xf32>
+    }
+    return
+  }
+  func.func @nohoist_untagged(%out: memref<?xf32>, %in: memref<?xi32>, %arg1: index, %arg2: index) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    scf.parallel (%arg3) = (%arg1) to (%arg2) step (%c1) {
+      %v = memref.load %in[%c0] {polygeist.tbaa = "int"} : memref<?xi32>
+      %f = arith.sitofp %v : i32 to f32
+      memref.store %f, %out[%arg3] : memref<?xf32>
+    }
+    return
+  }
+}
+
+// CHECK-LABEL:   func.func @hoist_tbaa(
+// CHECK:           %[[V:.+]] = memref.load %arg1[%c0] {polygeist.tbaa = "int"} : memref<?xi32>
+// CHECK:           scf.parallel
+
+// CHECK-LABEL:   func.func @nohoist_untagged(
+// CHECK:           scf.parallel
+// CHECK-NEXT:        memref.load %arg1[%c0] {polygeist.tbaa = "int"} : memref<?xi32>
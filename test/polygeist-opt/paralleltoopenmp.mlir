@@ -0,0 +1,189 @@
+// RUN: polygeist-opt --convert-parallel-to-openmp --split-input-file %s | FileCheck %s
+
+module {
+  func.func @small(%x : memref<?xf32>, %v : f32) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %c16 = arith.constant 16 : index
+    scf.parallel (%i) = (%c0) to (%c16) step (%c1) {
+      memref.store %v, %x[%i] : memref<?xf32>
+      scf.yield
+    }
+    return
+  }
+}
+
+// CHECK-LABEL:   func.func @small(
+// CHECK-NOT:     omp.parallel
+// CHECK:         scf.for %[[I:.+]] = %{{.*}} to %{{.*}} step %{{.*}} {
+// CHECK-NEXT:      memref.store %{{.*}}, %{{.*}}[%[[I]]] : memref<?xf32>
+// CHECK-NEXT:    }
+
+// -----
+
+module {
+  func.func @rectangular(%x : memref<?xf32>, %v : f32, %n : index) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    scf.parallel (%i) = (%c0) to (%n) step (%c1) {
+      memref.store %v, %x[%i] : memref<?xf32>
+      scf.yield
+    }
+    return
+  }
+}
+
+// CHECK-LABEL:   func.func @rectangular(
+// CHECK:         omp.parallel {
+// CHECK-NEXT:      omp.wsloop schedule(static) for (%[[I:.+]]) : index = (%{{.*}}) to (%{{.*}}) step (%{{.*}}) {
+// CHECK-NEXT:        memref.alloca_scope {
+// CHECK-NEXT:          memref.store %{{.*}}, %{{.*}}[%[[I]]] : memref<?xf32>
+// CHECK-NEXT:        }
+// CHECK-NEXT:        omp.yield
+// CHECK-NEXT:      }
+// CHECK-NEXT:      omp.terminator
+// CHECK-NEXT:    }
+
+// -----
+
+module {
+  func.func @triangular(%x : memref<?xf32>, %v : f32, %n : index) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    scf.parallel (%i) = (%c0) to (%n) step (%c1) {
+      %e = arith.addi %i, %c1 : index
+      scf.for %j = %c0 to %e step %c1 {
+        memref.store %v, %x[%j] : memref<?xf32>
+      }
+      scf.yield
+    }
+    return
+  }
+}
+
+// CHECK-LABEL:   func.func @triangular(
+// CHECK:         omp.parallel {
+// CHECK-NEXT:      omp.wsloop schedule(dynamic) for
+
+// -----
+
+module {
+  func.func @collapse(%x : memref<?x?xf32>, %v : f32, %n : index) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %c4 = arith.constant 4 : index
+    scf.parallel (%i) = (%c0) to (%c4) step (%c1) {
+      scf.parallel (%j) = (%c0) to (%n) step (%c1) {
+        memref.store %v, %x[%i, %j] : memref<?x?xf32>
+        scf.yield
+      }
+      scf.yield
+    }
+    return
+  }
+}
+
+// CHECK-LABEL:   func.func @collapse(
+// CHECK:         omp.parallel {
+// CHECK-NEXT:      omp.wsloop schedule(static) for (%[[I:.+]], %[[J:.+]]) : index = (%{{.*}}, %{{.*}}) to (%{{.*}}, %{{.*}}) step (%{{.*}}, %{{.*}}) {
+// CHECK-NEXT:        memref.alloca_scope {
+// CHECK-NEXT:          memref.store %{{.*}}, %{{.*}}[%[[I]], %[[J]]] : memref<?x?xf32>
+// CHECK-NEXT:        }
+
+// -----
+
+module {
+  func.func @nested(%x : memref<?x?xf32>, %v : f32, %n : index) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    scf.parallel (%i) = (%c0) to (%n) step (%c1) {
+      scf.parallel (%j) = (%c0) to (%n) step (%c1) {
+        memref.store %v, %x[%i, %j] : memref<?x?xf32>
+        scf.yield
+      }
+      scf.yield
+    }
+    return
+  }
+}
+
+// CHECK-LABEL:   func.func @nested(
+// CHECK:         omp.parallel {
+// CHECK-NEXT:      omp.wsloop schedule(static) for (%[[I:.+]]) : index = (%{{.*}}) to (%{{.*}}) step (%{{.*}}) {
+// CHECK-NEXT:        memref.alloca_scope {
+// CHECK-NEXT:          scf.for %[[J:.+]] = %{{.*}} to %{{.*}} step %{{.*}} {
+// CHECK-NEXT:            memref.store %{{.*}}, %{{.*}}[%[[I]], %[[J]]] : memref<?x?xf32>
+// CHECK-NEXT:          }
+// CHECK-NEXT:        }
+
+// -----
+
+module {
+  func.func @nested_reduction(%x : memref<?x?xf32>, %y : memref<?xf32>,
+                              %n : index) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %zero = arith.constant 0.0 : f32
+    scf.parallel (%i) = (%c0) to (%n) step (%c1) {
+      %sum = scf.parallel (%j) = (%c0) to (%n) step (%c1) init (%zero) -> f32 {
+        %e = memref.load %x[%i, %j] : memref<?x?xf32>
+        scf.reduce(%e) : f32 {
+        ^bb0(%lhs : f32, %rhs : f32):
+          %r = arith.addf %lhs, %rhs : f32
+          scf.reduce.return %r : f32
+        }
+        scf.yield
+      }
+      memref.store %sum, %y[%i] : memref<?xf32>
+      scf.yield
+    }
+    return
+  }
+}
+
+// CHECK-LABEL:   func.func @nested_reduction(
+// CHECK:         omp.parallel {
+// CHECK-NEXT:      omp.wsloop schedule(static) for (%[[I:.+]]) : index = (%{{.*}}) to (%{{.*}}) step (%{{.*}}) {
+// CHECK-NEXT:        memref.alloca_scope {
+// CHECK-NEXT:          %[[SUM:.+]] = scf.parallel (%[[J:.+]]) = (%{{.*}}) to (%{{.*}}) step (%{{.*}}) init (%{{.*}}) -> f32 {
+// CHECK-NEXT:            %[[E:.+]] = memref.load %{{.*}}[%[[I]], %[[J]]] : memref<?x?xf32>
+// CHECK-NEXT:            scf.reduce(%[[E]])
+// CHECK:                 scf.reduce.return
+// CHECK:               memref.store %[[SUM]], %{{.*}}[%[[I]]] : memref<?xf32>
+
+// -----
+
+module {
+  func.func @in_parallel_reduction(%x : memref<?x?xf32>, %y : memref<?xf32>,
+                                   %n : index) {
+    %c0 = arith.constant 0 : index
+    %c1 = arith.constant 1 : index
+    %zero = arith.constant 0.0 : f32
+    omp.parallel {
+      scf.parallel (%i) = (%c0) to (%n) step (%c1) {
+        %sum = scf.parallel (%j) = (%c0) to (%n) step (%c1) init (%zero) -> f32 {
+          %e = memref.load %x[%i, %j] : memref<?x?xf32>
+          scf.reduce(%e) : f32 {
+          ^bb0(%lhs : f32, %rhs : f32):
+            %r = arith.addf %lhs, %rhs : f32
+            scf.reduce.return %r : f32
+          }
+          scf.yield
+        }
+        memref.store %sum, %y[%i] : memref<?xf32>
+        scf.yield
+      }
+      omp.terminator
+    }
+    return
+  }
+}
+
+// CHECK-LABEL:   func.func @in_parallel_reduction(
+// CHECK:         omp.parallel {
+// CHECK-NEXT:      scf.for %[[I:.+]] = %{{.*}} to %{{.*}} step %{{.*}} {
+// CHECK-NEXT:        %[[SUM:.+]] = scf.parallel (%[[J:.+]]) = (%{{.*}}) to (%{{.*}}) step (%{{.*}}) init (%{{.*}}) -> f32 {
+// CHECK:               scf.reduce.return
+// CHECK:             memref.store %[[SUM]], %{{.*}}[%[[I]]] : memref<?xf32>
+// CHECK-NEXT:      }
+// CHECK-NEXT:      omp.terminator
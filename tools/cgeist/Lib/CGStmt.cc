@@ -158,7 +158,7 @@ bool MLIRScanner::isTrivialAffineLoop(clang::ForStmt *fors,
   return true;
 }
 
-void MLIRScanner::buildAffineLoopImpl(
+mlir::AffineForOp MLIRScanner::buildAffineLoopImpl(
     clang::ForStmt *fors, mlir::Location loc, mlir::Value lb, mlir::Value ub,
     const mlirclang::AffineLoopDescriptor &descr) {
   auto affineOp = builder.create<AffineForOp>(
@@ -201,38 +201,158 @@ void MLIRScanner::buildAffineLoopImpl(
   // TODO: set the value of the iteration value to the final bound at the
   // end of the loop.
   builder.setInsertionPoint(oldblock, oldpoint);
+  return affineOp;
 }
 
-void MLIRScanner::buildAffineLoop(
+mlir::AffineForOp MLIRScanner::buildAffineLoop(
     clang::ForStmt *fors, mlir::Location loc,
     const mlirclang::AffineLoopDescriptor &descr) {
   mlir::Value lb = descr.getLowerBound();
   mlir::Value ub = descr.getUpperBound();
-  buildAffineLoopImpl(fors, loc, lb, ub, descr);
+  return buildAffineLoopImpl(fors, loc, lb, ub, descr);
+}
+
+mlir::DictionaryAttr MLIRScanner::getLoopHints(clang::SourceLocation loc) {
+  auto attrs = loopAttrs;
+  loopAttrs = {};
+
+  mlir::NamedAttrList hints;
+  for (const auto *A : attrs) {
+    const auto *LH = dyn_cast<LoopHintAttr>(A);
+    if (!LH)
+      continue;
+    bool enable = LH->getState() != LoopHintAttr::Disable;
+    mlir::IntegerAttr value;
+    if (auto *E = LH->getValue())
+      value = builder.getI64IntegerAttr(
+          E->EvaluateKnownConstInt(Glob.astContext).getSExtValue());
+    switch (LH->getOption()) {
+    case LoopHintAttr::Unroll: {
+      StringRef unroll = enable ? "enable" : "disable";
+      if (LH->getState() == LoopHintAttr::Full)
+        unroll = "full";
+      hints.set("unroll", builder.getStringAttr(unroll));
+      break;
+    }
+    case LoopHintAttr::UnrollCount:
+      hints.set("unroll_count", value);
+      break;
+    case LoopHintAttr::Vectorize:
+      hints.set("vectorize", builder.getBoolAttr(enable));
+      if (LH->getState() == LoopHintAttr::AssumeSafety)
+        hints.set("parallel", builder.getUnitAttr());
+      break;
+    case LoopHintAttr::VectorizeWidth:
+      if (value)
+        hints.set("vectorize_width", value);
+      break;
+    case LoopHintAttr::Interleave:
+      // Disabling interleaving is an interleave count of one; enabling it
+      // leaves the count to the vectorizer.
+      if (!enable)
+        hints.set("interleave_count", builder.getI64IntegerAttr(1));
+      break;
+    case LoopHintAttr::InterleaveCount:
+      hints.set("interleave_count", value);
+      break;
+    case LoopHintAttr::Distribute:
+      hints.set("distribute", builder.getBoolAttr(enable));
+      break;
+    default:
+      emitWarning(getMLIRLocation(LH->getLocation()))
+          << "ignoring loop hint " << LH->getOptionName(LH->getOption())
+          << "\n";
+      break;
+    }
+  }
+  // Like vectorize(assume_safety), GCC's ivdep asserts that the loop has no
+  // dependences the vectorizer would have to respect.
+  if (Glob.ivdepLocList.appliesTo(Glob.SM, loc)) {
+    hints.set("vectorize", builder.getBoolAttr(true));
+    hints.set("parallel", builder.getUnitAttr());
+  }
+
+  if (hints.empty())
+    return nullptr;
+  return hints.getDictionary(builder.getContext());
+}
+
+LoopContext MLIRScanner::createLoopContext(mlir::Location loc,
+                                           clang::Stmt *body) {
+  if (DirectSSA && !mlirclang::mayExitLoopEarly(body))
+    return {};
+
+  auto i1Ty = builder.getIntegerType(1);
+  auto type = mlir::MemRefType::get({}, i1Ty, {}, 0);
+  auto truev = builder.create<ConstantIntOp>(loc, true, 1);
+
+  LoopContext lctx{builder.create<mlir::memref::AllocaOp>(loc, type),
+                   builder.create<mlir::memref::AllocaOp>(loc, type)};
+  builder.create<mlir::memref::StoreOp>(loc, truev, lctx.noBreak);
+  return lctx;
+}
+
+SmallVector<const VarDecl *>
+MLIRScanner::getLoopCarriedLocals(clang::Stmt *loop) {
+  SmallVector<const VarDecl *> assigned;
+  mlirclang::collectAssignedLocals(loop, assigned);
+  SmallVector<const VarDecl *> carried;
+  for (const VarDecl *VD : assigned) {
+    // Locals declared in the loop are not bound yet.
+    auto found = params.find(VD);
+    if (ssaLocals.count(VD) && found != params.end() &&
+        !found->second.isReference)
+      carried.push_back(VD);
+  }
+  return carried;
+}
+
+SmallVector<mlir::Value>
+MLIRScanner::getLocalValues(ArrayRef<const VarDecl *> locals) {
+  SmallVector<mlir::Value> values;
+  for (const VarDecl *VD : locals)
+    values.push_back(params[VD].val);
+  return values;
+}
+
+void MLIRScanner::rebindLocals(ArrayRef<const VarDecl *> locals,
+                               mlir::ValueRange values) {
+  for (auto en : llvm::zip(locals, values))
+    params[std::get<0>(en)] =
+        ValueCategory(std::get<1>(en), /*isReference*/ false);
+}
+
+SmallVector<mlir::Value>
+MLIRScanner::bindBlockArguments(Block *header,
+                                ArrayRef<const VarDecl *> locals,
+                                mlir::Location loc) {
+  SmallVector<mlir::Value> args;
+  for (const VarDecl *VD : locals)
+    args.push_back(header->addArgument(params[VD].val.getType(), loc));
+  rebindLocals(locals, args);
+  return args;
 }
 
 ValueCategory MLIRScanner::VisitForStmt(clang::ForStmt *fors) {
   IfScope scope(*this);
 
   auto loc = getMLIRLocation(fors->getForLoc());
+  auto hints = getLoopHints(fors->getForLoc());
 
   mlirclang::AffineLoopDescriptor affineLoopDescr;
   if (Glob.scopLocList.isInScop(fors->getForLoc()) &&
       isTrivialAffineLoop(fors, affineLoopDescr)) {
-    buildAffineLoop(fors, loc, affineLoopDescr);
+    auto affineOp = buildAffineLoop(fors, loc, affineLoopDescr);
+    if (hints)
+      affineOp->setAttr(LoopHintsAttrName, hints);
   } else {
 
     if (auto *s = fors->getInit()) {
       Visit(s);
     }
 
-    auto i1Ty = builder.getIntegerType(1);
-    auto type = mlir::MemRefType::get({}, i1Ty, {}, 0);
-    auto truev = builder.create<ConstantIntOp>(loc, true, 1);
-
-    LoopContext lctx{builder.create<mlir::memref::AllocaOp>(loc, type),
-                     builder.create<mlir::memref::AllocaOp>(loc, type)};
-    builder.create<mlir::memref::StoreOp>(loc, truev, lctx.noBreak);
+    LoopContext lctx = createLoopContext(loc, fors->getBody());
+    auto carried = getLoopCarriedLocals(fors);
 
     auto *toadd = builder.getInsertionBlock()->getParent();
     auto &condB = *(new Block());
@@ -242,9 +362,10 @@ ValueCategory MLIRScanner::VisitForStmt(clang::ForStmt *fors) {
     auto &exitB = *(new Block());
     toadd->getBlocks().push_back(&exitB);
 
-    builder.create<mlir::cf::BranchOp>(loc, &condB);
+    builder.create<mlir::cf::BranchOp>(loc, &condB, getLocalValues(carried));
 
     builder.setInsertionPointToStart(&condB);
+    auto header = bindBlockArguments(&condB, carried, loc);
 
     if (auto *s = fors->getCond()) {
       auto condRes = Visit(s);
@@ -267,31 +388,37 @@ ValueCategory MLIRScanner::VisitForStmt(clang::ForStmt *fors) {
             loc, CmpIPredicate::ne, cond,
             builder.create<ConstantIntOp>(loc, 0, ty));
       }
-      auto nb = builder.create<mlir::memref::LoadOp>(
-          loc, lctx.noBreak, std::vector<mlir::Value>());
-      cond = builder.create<AndIOp>(loc, cond, nb);
+      if (lctx.noBreak) {
+        auto nb = builder.create<mlir::memref::LoadOp>(
+            loc, lctx.noBreak, std::vector<mlir::Value>());
+        cond = builder.create<AndIOp>(loc, cond, nb);
+      }
       builder.create<mlir::cf::CondBranchOp>(loc, cond, &bodyB, &exitB);
-    } else {
+    } else if (lctx.noBreak) {
       auto cond = builder.create<mlir::memref::LoadOp>(
           loc, lctx.noBreak, std::vector<mlir::Value>());
       builder.create<mlir::cf::CondBranchOp>(loc, cond, &bodyB, &exitB);
+    } else {
+      builder.create<mlir::cf::BranchOp>(loc, &bodyB);
     }
 
     builder.setInsertionPointToStart(&bodyB);
-    builder.create<mlir::memref::StoreOp>(
-        loc,
-        builder.create<mlir::memref::LoadOp>(loc, lctx.noBreak,
-                                             std::vector<mlir::Value>()),
-        lctx.keepRunning, std::vector<mlir::Value>());
+    if (lctx.keepRunning)
+      builder.create<mlir::memref::StoreOp>(
+          loc,
+          builder.create<mlir::memref::LoadOp>(loc, lctx.noBreak,
+                                               std::vector<mlir::Value>()),
+          lctx.keepRunning, std::vector<mlir::Value>());
 
     loops.push_back(lctx);
     Visit(fors->getBody());
 
-    builder.create<mlir::memref::StoreOp>(
-        loc,
-        builder.create<mlir::memref::LoadOp>(loc, lctx.noBreak,
-                                             std::vector<mlir::Value>()),
-        lctx.keepRunning, std::vector<mlir::Value>());
+    if (lctx.keepRunning)
+      builder.create<mlir::memref::StoreOp>(
+          loc,
+          builder.create<mlir::memref::LoadOp>(loc, lctx.noBreak,
+                                               std::vector<mlir::Value>()),
+          lctx.keepRunning, std::vector<mlir::Value>());
     if (auto *s = fors->getInc()) {
       IfScope scope(*this);
       Visit(s);
@@ -299,10 +426,14 @@ ValueCategory MLIRScanner::VisitForStmt(clang::ForStmt *fors) {
     loops.pop_back();
     if (builder.getInsertionBlock()->empty() ||
         !isTerminator(&builder.getInsertionBlock()->back())) {
-      builder.create<mlir::cf::BranchOp>(loc, &condB);
+      auto backEdge = builder.create<mlir::cf::BranchOp>(
+          loc, &condB, getLocalValues(carried));
+      if (hints)
+        backEdge->setAttr(LoopHintsAttrName, hints);
     }
 
     builder.setInsertionPointToStart(&exitB);
+    rebindLocals(carried, header);
   }
   return nullptr;
 }
@@ -311,6 +442,7 @@ ValueCategory MLIRScanner::VisitCXXForRangeStmt(clang::CXXForRangeStmt *fors) {
   IfScope scope(*this);
 
   auto loc = getMLIRLocation(fors->getForLoc());
+  auto hints = getLoopHints(fors->getForLoc());
 
   if (auto *s = fors->getInit()) {
     Visit(s);
@@ -319,13 +451,7 @@ ValueCategory MLIRScanner::VisitCXXForRangeStmt(clang::CXXForRangeStmt *fors) {
   Visit(fors->getBeginStmt());
   Visit(fors->getEndStmt());
 
-  auto i1Ty = builder.getIntegerType(1);
-  auto type = mlir::MemRefType::get({}, i1Ty, {}, 0);
-  auto truev = builder.create<ConstantIntOp>(loc, true, 1);
-
-  LoopContext lctx{builder.create<mlir::memref::AllocaOp>(loc, type),
-                   builder.create<mlir::memref::AllocaOp>(loc, type)};
-  builder.create<mlir::memref::StoreOp>(loc, truev, lctx.noBreak);
+  LoopContext lctx = createLoopContext(loc, fors->getBody());
 
   auto *toadd = builder.getInsertionBlock()->getParent();
   auto &condB = *(new Block());
@@ -353,32 +479,38 @@ ValueCategory MLIRScanner::VisitCXXForRangeStmt(clang::CXXForRangeStmt *fors) {
           loc, CmpIPredicate::ne, cond,
           builder.create<ConstantIntOp>(loc, 0, ty));
     }
-    auto nb = builder.create<mlir::memref::LoadOp>(loc, lctx.noBreak,
-                                                   std::vector<mlir::Value>());
-    cond = builder.create<AndIOp>(loc, cond, nb);
+    if (lctx.noBreak) {
+      auto nb = builder.create<mlir::memref::LoadOp>(
+          loc, lctx.noBreak, std::vector<mlir::Value>());
+      cond = builder.create<AndIOp>(loc, cond, nb);
+    }
     builder.create<mlir::cf::CondBranchOp>(loc, cond, &bodyB, &exitB);
-  } else {
+  } else if (lctx.noBreak) {
     auto cond = builder.create<mlir::memref::LoadOp>(
         loc, lctx.noBreak, std::vector<mlir::Value>());
     builder.create<mlir::cf::CondBranchOp>(loc, cond, &bodyB, &exitB);
+  } else {
+    builder.create<mlir::cf::BranchOp>(loc, &bodyB);
   }
 
   builder.setInsertionPointToStart(&bodyB);
-  builder.create<mlir::memref::StoreOp>(
-      loc,
-      builder.create<mlir::memref::LoadOp>(loc, lctx.noBreak,
-                                           std::vector<mlir::Value>()),
-      lctx.keepRunning, std::vector<mlir::Value>());
+  if (lctx.keepRunning)
+    builder.create<mlir::memref::StoreOp>(
+        loc,
+        builder.create<mlir::memref::LoadOp>(loc, lctx.noBreak,
+                                             std::vector<mlir::Value>()),
+        lctx.keepRunning, std::vector<mlir::Value>());
 
   loops.push_back(lctx);
   Visit(fors->getLoopVarStmt());
   Visit(fors->getBody());
 
-  builder.create<mlir::memref::StoreOp>(
-      loc,
-      builder.create<mlir::memref::LoadOp>(loc, lctx.noBreak,
-                                           std::vector<mlir::Value>()),
-      lctx.keepRunning, std::vector<mlir::Value>());
+  if (lctx.keepRunning)
+    builder.create<mlir::memref::StoreOp>(
+        loc,
+        builder.create<mlir::memref::LoadOp>(loc, lctx.noBreak,
+                                             std::vector<mlir::Value>()),
+        lctx.keepRunning, std::vector<mlir::Value>());
   if (auto *s = fors->getInc()) {
     IfScope scope(*this);
     Visit(s);
@@ -386,13 +518,245 @@ ValueCategory MLIRScanner::VisitCXXForRangeStmt(clang::CXXForRangeStmt *fors) {
   loops.pop_back();
   if (builder.getInsertionBlock()->empty() ||
       !isTerminator(&builder.getInsertionBlock()->back())) {
-    builder.create<mlir::cf::BranchOp>(loc, &condB);
+    auto backEdge = builder.create<mlir::cf::BranchOp>(loc, &condB);
+    if (hints)
+      backEdge->setAttr(LoopHintsAttrName, hints);
   }
 
   builder.setInsertionPointToStart(&exitB);
   return nullptr;
 }
 
+/// The value leaving the other operand of reduction `kind` unchanged.
+static mlir::Value getReductionIdentity(OpBuilder &builder, Location loc,
+                                        OMPReduction::Kind kind,
+                                        mlir::Type ty, bool isSigned) {
+  if (auto ft = ty.dyn_cast<mlir::FloatType>()) {
+    const auto &sem = ft.getFloatSemantics();
+    APFloat val = APFloat::getZero(sem);
+    if (kind == OMPReduction::Mul)
+      val = APFloat(sem, 1);
+    else if (kind == OMPReduction::Min)
+      val = APFloat::getInf(sem);
+    else if (kind == OMPReduction::Max)
+      val = APFloat::getInf(sem, /*Negative*/ true);
+    return builder.create<arith::ConstantFloatOp>(loc, val, ft);
+  }
+
+  unsigned width = ty.getIntOrFloatBitWidth();
+  APInt val(width, 0);
+  if (kind == OMPReduction::Mul)
+    val = APInt(width, 1);
+  else if (kind == OMPReduction::And)
+    val = APInt::getAllOnes(width);
+  else if (kind == OMPReduction::Min)
+    val = isSigned ? APInt::getSignedMaxValue(width)
+                   : APInt::getMaxValue(width);
+  else if (kind == OMPReduction::Max && isSigned)
+    val = APInt::getSignedMinValue(width);
+  return builder.create<arith::ConstantOp>(loc, ty,
+                                           builder.getIntegerAttr(ty, val));
+}
+
+/// Combine `lhs` and `rhs` with the operator of `red`.
+static mlir::Value combineReduction(OpBuilder &builder, Location loc,
+                                    const OMPReduction &red, mlir::Value lhs,
+                                    mlir::Value rhs) {
+  bool isFloat = lhs.getType().isa<mlir::FloatType>();
+  switch (red.kind) {
+  case OMPReduction::Add:
+    if (isFloat)
+      return builder.create<arith::AddFOp>(loc, lhs, rhs);
+    return builder.create<arith::AddIOp>(loc, lhs, rhs);
+  case OMPReduction::Mul:
+    if (isFloat)
+      return builder.create<arith::MulFOp>(loc, lhs, rhs);
+    return builder.create<arith::MulIOp>(loc, lhs, rhs);
+  case OMPReduction::And:
+    return builder.create<arith::AndIOp>(loc, lhs, rhs);
+  case OMPReduction::Or:
+    return builder.create<arith::OrIOp>(loc, lhs, rhs);
+  case OMPReduction::Xor:
+    return builder.create<arith::XOrIOp>(loc, lhs, rhs);
+  case OMPReduction::Min:
+  case OMPReduction::Max: {
+    mlir::Value lt;
+    if (isFloat)
+      lt = builder.create<arith::CmpFOp>(loc, arith::CmpFPredicate::OLT, lhs,
+                                         rhs);
+    else
+      lt = builder.create<arith::CmpIOp>(
+          loc,
+          red.isSigned ? arith::CmpIPredicate::slt : arith::CmpIPredicate::ult,
+          lhs, rhs);
+    if (red.kind == OMPReduction::Min)
+      return builder.create<arith::SelectOp>(loc, lt, lhs, rhs);
+    return builder.create<arith::SelectOp>(loc, lt, rhs, lhs);
+  }
+  }
+  llvm_unreachable("unknown reduction kind");
+}
+
+/// Atomically fold `priv` into `*shared` with the min or max operator of
+/// `red`. The OpenMP translation only accepts atomic update regions made of a
+/// single binary operation, which a compare and select is not, so integers use
+/// atomicrmw and floating-point values a compare-and-swap loop instead.
+static void buildAtomicMinMax(OpBuilder &builder, Location loc,
+                              const OMPReduction &red, mlir::Value shared,
+                              mlir::Value priv) {
+  auto ty = priv.getType();
+  if (ty.isa<mlir::IntegerType>()) {
+    LLVM::AtomicBinOp op;
+    if (red.kind == OMPReduction::Min)
+      op = red.isSigned ? LLVM::AtomicBinOp::min : LLVM::AtomicBinOp::umin;
+    else
+      op = red.isSigned ? LLVM::AtomicBinOp::max : LLVM::AtomicBinOp::umax;
+    builder.create<LLVM::AtomicRMWOp>(loc, ty, op, shared, priv,
+                                      LLVM::AtomicOrdering::monotonic);
+    return;
+  }
+
+  auto intTy = builder.getIntegerType(ty.getIntOrFloatBitWidth());
+  auto ptrTy = shared.getType().cast<LLVM::LLVMPointerType>();
+  mlir::Value ptr = builder.create<LLVM::BitcastOp>(
+      loc, LLVM::LLVMPointerType::get(intTy, ptrTy.getAddressSpace()), shared);
+  mlir::Value init = builder.create<LLVM::LoadOp>(loc, ptr);
+  auto loop = builder.create<scf::WhileOp>(loc, intTy, init);
+
+  OpBuilder::InsertionGuard guard(builder);
+  Block *before = builder.createBlock(&loop.getBefore(), {}, intTy, loc);
+  mlir::Value old = before->getArgument(0);
+  mlir::Value combined = combineReduction(
+      builder, loc, red, builder.create<arith::BitcastOp>(loc, ty, old), priv);
+  auto pairTy = LLVM::LLVMStructType::getLiteral(
+      builder.getContext(), {intTy, builder.getI1Type()});
+  auto pair = builder.create<LLVM::AtomicCmpXchgOp>(
+      loc, pairTy, ptr, old,
+      builder.create<arith::BitcastOp>(loc, intTy, combined),
+      LLVM::AtomicOrdering::monotonic, LLVM::AtomicOrdering::monotonic);
+  mlir::Value seen =
+      builder.create<LLVM::ExtractValueOp>(loc, pair, ArrayRef<int64_t>{0});
+  mlir::Value swapped =
+      builder.create<LLVM::ExtractValueOp>(loc, pair, ArrayRef<int64_t>{1});
+  mlir::Value retry = builder.create<arith::XOrIOp>(
+      loc, swapped, builder.create<arith::ConstantIntOp>(loc, 1, 1));
+  builder.create<scf::ConditionOp>(loc, retry, seen);
+
+  Block *after = builder.createBlock(&loop.getAfter(), {}, intTy, loc);
+  builder.create<scf::YieldOp>(loc, after->getArgument(0));
+}
+
+void MLIRScanner::reportUnsupportedReduction(clang::SourceLocation loc,
+                                             const Twine &what) {
+  auto &diags = Glob.CGM.getDiags();
+  unsigned id = diags.getCustomDiagID(
+      clang::DiagnosticsEngine::Error, "unsupported OpenMP reduction %0");
+  diags.Report(loc, id) << what.str();
+}
+
+SmallVector<OMPReduction> MLIRScanner::privatizeReductions(
+    clang::OMPExecutableDirective *dir,
+    std::map<const ValueDecl *, ValueCategory> &prev) {
+  SmallVector<OMPReduction> reductions;
+  for (auto *clause : dir->getClausesOfKind<OMPReductionClause>()) {
+    auto loc = getMLIRLocation(clause->getBeginLoc());
+    DeclarationName id = clause->getNameInfo().getName();
+
+    OMPReduction::Kind kind;
+    switch (id.getCXXOverloadedOperator()) {
+    case OO_Plus:
+    case OO_Minus:
+      kind = OMPReduction::Add;
+      break;
+    case OO_Star:
+      kind = OMPReduction::Mul;
+      break;
+    case OO_Amp:
+      kind = OMPReduction::And;
+      break;
+    case OO_Pipe:
+      kind = OMPReduction::Or;
+      break;
+    case OO_Caret:
+      kind = OMPReduction::Xor;
+      break;
+    default:
+      if (id.isIdentifier() && id.getAsIdentifierInfo()->isStr("min"))
+        kind = OMPReduction::Min;
+      else if (id.isIdentifier() && id.getAsIdentifierInfo()->isStr("max"))
+        kind = OMPReduction::Max;
+      else {
+        reportUnsupportedReduction(clause->getBeginLoc(),
+                                   "'" + id.getAsString() + "'");
+        continue;
+      }
+    }
+
+    for (auto *ref : clause->varlists()) {
+      auto *var = cast<VarDecl>(cast<DeclRefExpr>(ref)->getDecl());
+      auto ty = getMLIRType(var->getType());
+      if (!ty.isa<mlir::IntegerType, mlir::FloatType>()) {
+        reportUnsupportedReduction(ref->getExprLoc(),
+                                   "of type '" + var->getType().getAsString() +
+                                       "'");
+        continue;
+      }
+
+      OMPReduction red{kind, var, Visit(ref),
+                       var->getType()->isSignedIntegerType()};
+      assert(red.shared.isReference);
+
+      if (params.find(var) != params.end()) {
+        prev[var] = params[var];
+        params.erase(var);
+      }
+
+      auto allocop = createAllocOp(ty, var, /*memtype*/ 0, /*isArray*/ false,
+                                   /*LLVMABI*/ false);
+      params[var] = ValueCategory(allocop, true);
+      params[var].store(
+          loc, builder,
+          getReductionIdentity(builder, loc, kind, ty, red.isSigned));
+      reductions.push_back(red);
+    }
+  }
+  return reductions;
+}
+
+void MLIRScanner::combineReductions(ArrayRef<OMPReduction> reductions) {
+  for (const auto &red : reductions) {
+    auto loc = getMLIRLocation(red.var->getLocation());
+    auto priv = params[red.var].getValue(loc, builder);
+    params.erase(red.var);
+
+    // Go through a pointer, as atomics on memrefs do not lower to C-style
+    // memrefs.
+    mlir::Value shared = red.shared.val;
+    if (auto mt = shared.getType().dyn_cast<MemRefType>())
+      shared = builder.create<polygeist::Memref2PointerOp>(
+          loc,
+          LLVM::LLVMPointerType::get(mt.getElementType(),
+                                     mt.getMemorySpaceAsInt()),
+          shared);
+
+    if (red.kind == OMPReduction::Min || red.kind == OMPReduction::Max) {
+      buildAtomicMinMax(builder, loc, red, shared, priv);
+      continue;
+    }
+
+    OperationState state(loc, omp::AtomicUpdateOp::getOperationName());
+    state.addOperands(shared);
+    state.addRegion();
+    auto *update = builder.create(state);
+
+    OpBuilder::InsertionGuard guard(builder);
+    Block *body =
+        builder.createBlock(&update->getRegion(0), {}, priv.getType(), loc);
+    builder.create<omp::YieldOp>(
+        loc, combineReduction(builder, loc, red, body->getArgument(0), priv));
+  }
+}
+
 ValueCategory
 MLIRScanner::VisitOMPSingleDirective(clang::OMPSingleDirective *par) {
   auto loc = getMLIRLocation(par->getBeginLoc());
@@ -427,15 +791,84 @@ MLIRScanner::VisitOMPSingleDirective(clang::OMPSingleDirective *par) {
   return nullptr;
 }
 
-ValueCategory MLIRScanner::VisitOMPForDirective(clang::OMPForDirective *fors) {
-  IfScope scope(*this);
+mlir::Value MLIRScanner::buildScheduleChunk(clang::OMPLoopDirective *fors) {
+  auto *schedule = fors->getSingleClause<OMPScheduleClause>();
+  if (!schedule || !schedule->getChunkSize())
+    return nullptr;
+  auto loc = getMLIRLocation(schedule->getBeginLoc());
+  if (auto *preInit = schedule->getPreInitStmt())
+    Visit(preInit);
+  return builder.create<IndexCastOp>(
+      loc, builder.getIndexType(),
+      Visit(schedule->getChunkSize()).getValue(loc, builder));
+}
+
+void MLIRScanner::setScheduleClause(omp::WsLoopOp loop,
+                                    clang::OMPLoopDirective *fors,
+                                    mlir::Value chunk) {
+  auto *schedule = fors->getSingleClause<OMPScheduleClause>();
+  if (!schedule)
+    return;
+  auto *ctx = builder.getContext();
+
+  switch (schedule->getScheduleKind()) {
+  case OMPC_SCHEDULE_static:
+    loop.setScheduleValAttr(
+        omp::ClauseScheduleKindAttr::get(ctx, omp::ClauseScheduleKind::Static));
+    break;
+  case OMPC_SCHEDULE_dynamic:
+    loop.setScheduleValAttr(omp::ClauseScheduleKindAttr::get(
+        ctx, omp::ClauseScheduleKind::Dynamic));
+    break;
+  case OMPC_SCHEDULE_guided:
+    loop.setScheduleValAttr(
+        omp::ClauseScheduleKindAttr::get(ctx, omp::ClauseScheduleKind::Guided));
+    break;
+  case OMPC_SCHEDULE_auto:
+    loop.setScheduleValAttr(
+        omp::ClauseScheduleKindAttr::get(ctx, omp::ClauseScheduleKind::Auto));
+    break;
+  case OMPC_SCHEDULE_runtime:
+    loop.setScheduleValAttr(omp::ClauseScheduleKindAttr::get(
+        ctx, omp::ClauseScheduleKind::Runtime));
+    break;
+  case OMPC_SCHEDULE_unknown:
+    break;
+  }
+
+  for (auto modifier : {schedule->getFirstScheduleModifier(),
+                        schedule->getSecondScheduleModifier()}) {
+    switch (modifier) {
+    case OMPC_SCHEDULE_MODIFIER_monotonic:
+      loop.setScheduleModifierAttr(omp::ScheduleModifierAttr::get(
+          ctx, omp::ScheduleModifier::monotonic));
+      break;
+    case OMPC_SCHEDULE_MODIFIER_nonmonotonic:
+      loop.setScheduleModifierAttr(omp::ScheduleModifierAttr::get(
+          ctx, omp::ScheduleModifier::nonmonotonic));
+      break;
+    case OMPC_SCHEDULE_MODIFIER_simd:
+      loop.setSimdModifierAttr(builder.getUnitAttr());
+      break;
+    default:
+      break;
+    }
+  }
+
+  if (chunk)
+    loop.getScheduleChunkVarMutable().assign(chunk);
+}
+
+void MLIRScanner::buildOMPLoopBounds(clang::OMPLoopDirective *fors,
+                                     SmallVectorImpl<mlir::Value> &inits,
+                                     SmallVectorImpl<mlir::Value> &finals,
+                                     SmallVectorImpl<mlir::Value> &incs) {
   auto loc = getMLIRLocation(fors->getBeginLoc());
 
   if (fors->getPreInits()) {
     Visit(fors->getPreInits());
   }
 
-  SmallVector<mlir::Value> inits;
   for (auto *f : fors->inits()) {
     assert(f);
     f = cast<clang::BinaryOperator>(f)->getRHS();
@@ -443,14 +876,12 @@ ValueCategory MLIRScanner::VisitOMPForDirective(clang::OMPForDirective *fors) {
         loc, builder.getIndexType(), Visit(f).getValue(loc, builder)));
   }
 
-  SmallVector<mlir::Value> finals;
   for (auto *f : fors->finals()) {
     f = cast<clang::BinaryOperator>(f)->getRHS();
     finals.push_back(builder.create<IndexCastOp>(
         loc, builder.getIndexType(), Visit(f).getValue(loc, builder)));
   }
 
-  SmallVector<mlir::Value> incs;
   for (auto *f : fors->updates()) {
     f = cast<clang::BinaryOperator>(f)->getRHS();
     while (auto *ce = dyn_cast<clang::CastExpr>(f))
@@ -466,28 +897,12 @@ ValueCategory MLIRScanner::VisitOMPForDirective(clang::OMPForDirective *fors) {
     incs.push_back(builder.create<IndexCastOp>(
         loc, builder.getIndexType(), Visit(f).getValue(loc, builder)));
   }
+}
 
-  auto affineOp = builder.create<omp::WsLoopOp>(loc, inits, finals, incs);
-  affineOp.getRegion().push_back(new Block());
-  for (auto init : inits)
-    affineOp.getRegion().front().addArgument(init.getType(), init.getLoc());
-  auto inds = affineOp.getRegion().front().getArguments();
-
-  auto oldpoint = builder.getInsertionPoint();
-  auto *oldblock = builder.getInsertionBlock();
-
-  builder.setInsertionPointToStart(&affineOp.getRegion().front());
-
-  auto executeRegion =
-      builder.create<scf::ExecuteRegionOp>(loc, ArrayRef<mlir::Type>());
-  builder.create<omp::YieldOp>(loc, ValueRange());
-  executeRegion.getRegion().push_back(new Block());
-  builder.setInsertionPointToStart(&executeRegion.getRegion().back());
-
-  auto *oldScope = allocationScope;
-  allocationScope = &executeRegion.getRegion().back();
-
-  std::map<VarDecl *, ValueCategory> prevInduction;
+void MLIRScanner::privatizeCounters(
+    clang::OMPLoopDirective *fors, mlir::ValueRange inds,
+    std::map<const ValueDecl *, ValueCategory> &prev) {
+  auto loc = getMLIRLocation(fors->getBeginLoc());
   for (auto zp : zip(inds, fors->counters())) {
     auto idx = builder.create<IndexCastOp>(
         loc, getMLIRType(fors->getIterationVariable()->getType()),
@@ -496,7 +911,7 @@ ValueCategory MLIRScanner::VisitOMPForDirective(clang::OMPForDirective *fors) {
         cast<VarDecl>(cast<DeclRefExpr>(std::get<1>(zp))->getDecl());
 
     if (params.find(name) != params.end()) {
-      prevInduction[name] = params[name];
+      prev[name] = params[name];
       params.erase(name);
     }
 
@@ -514,10 +929,105 @@ ValueCategory MLIRScanner::VisitOMPForDirective(clang::OMPForDirective *fors) {
     params[name] = ValueCategory(allocop, true);
     params[name].store(loc, builder, idx);
   }
+}
+
+void MLIRScanner::buildOMPLoopBody(clang::OMPLoopDirective *fors,
+                                   ArrayRef<mlir::Value> outerInds,
+                                   ValueRange lbs, ValueRange ubs,
+                                   ValueRange incs,
+                                   mlir::DictionaryAttr hints) {
+  auto loc = getMLIRLocation(fors->getBeginLoc());
+  OpBuilder::InsertionGuard guard(builder);
+
+  SmallVector<mlir::Value> inds(outerInds);
+  scf::ForOp inner;
+  for (auto bounds : llvm::zip(lbs, ubs, incs)) {
+    inner = builder.create<scf::ForOp>(loc, std::get<0>(bounds),
+                                       std::get<1>(bounds),
+                                       std::get<2>(bounds));
+    inds.push_back(inner.getInductionVar());
+    builder.setInsertionPointToStart(inner.getBody());
+  }
+  if (inner) {
+    if (hints)
+      inner->setAttr(LoopHintsAttrName, hints);
+    auto executeRegion =
+        builder.create<scf::ExecuteRegionOp>(loc, ArrayRef<mlir::Type>());
+    executeRegion.getRegion().push_back(new Block());
+    builder.setInsertionPointToStart(&executeRegion.getRegion().back());
+  }
+
+  std::map<const ValueDecl *, ValueCategory> prevInduction;
+  privatizeCounters(fors, inds, prevInduction);
 
   // TODO: set loop context.
   Visit(fors->getBody());
 
+  if (inner)
+    builder.create<scf::YieldOp>(loc);
+
+  for (auto pair : prevInduction)
+    params[pair.first] = pair.second;
+}
+
+/// Iterations of the innermost loop of a worksharing simd loop that a thread
+/// runs as one vectorizable loop, without a schedule chunk.
+static constexpr int64_t SimdBlockIterations = 256;
+
+void MLIRScanner::buildOMPWsLoop(clang::OMPLoopDirective *fors) {
+  auto loc = getMLIRLocation(fors->getBeginLoc());
+
+  SmallVector<mlir::Value> inits, finals, incs;
+  buildOMPLoopBounds(fors, inits, finals, incs);
+  mlir::Value chunk = buildScheduleChunk(fors);
+
+  // The threads of a simd loop share out blocks of iterations of its
+  // innermost loop, each run as a vectorizable loop. A block is a schedule
+  // chunk, if any, so that chunks still count iterations.
+  mlir::DictionaryAttr simdHints;
+  SmallVector<mlir::Value> steps(incs);
+  if (isOpenMPSimdDirective(fors->getDirectiveKind())) {
+    simdHints = buildOMPSimdClauses(fors);
+    mlir::Value block =
+        chunk ? chunk
+              : builder.create<ConstantIndexOp>(loc, SimdBlockIterations);
+    chunk = nullptr;
+    steps.back() = builder.create<MulIOp>(loc, incs.back(), block);
+  }
+
+  auto affineOp = builder.create<omp::WsLoopOp>(loc, inits, finals, steps);
+  setScheduleClause(affineOp, fors, chunk);
+  if (fors->getSingleClause<OMPNowaitClause>())
+    affineOp.setNowaitAttr(builder.getUnitAttr());
+  affineOp.getRegion().push_back(new Block());
+  for (auto init : inits)
+    affineOp.getRegion().front().addArgument(init.getType(), init.getLoc());
+  auto inds = affineOp.getRegion().front().getArguments();
+
+  auto oldpoint = builder.getInsertionPoint();
+  auto *oldblock = builder.getInsertionBlock();
+
+  builder.setInsertionPointToStart(&affineOp.getRegion().front());
+
+  auto executeRegion =
+      builder.create<scf::ExecuteRegionOp>(loc, ArrayRef<mlir::Type>());
+  builder.create<omp::YieldOp>(loc, ValueRange());
+  executeRegion.getRegion().push_back(new Block());
+  builder.setInsertionPointToStart(&executeRegion.getRegion().back());
+
+  auto *oldScope = allocationScope;
+  allocationScope = &executeRegion.getRegion().back();
+
+  if (simdHints) {
+    SmallVector<mlir::Value> outerInds(inds.begin(), std::prev(inds.end()));
+    mlir::Value lb = inds.back();
+    mlir::Value ub = builder.create<MinSIOp>(
+        loc, builder.create<AddIOp>(loc, lb, steps.back()), finals.back());
+    buildOMPLoopBody(fors, outerInds, lb, ub, incs.back(), simdHints);
+  } else
+    buildOMPLoopBody(fors, SmallVector<mlir::Value>(inds.begin(), inds.end()),
+                     {}, {}, {}, nullptr);
+
   builder.create<scf::YieldOp>(loc, ValueRange());
 
   allocationScope = oldScope;
@@ -525,19 +1035,78 @@ ValueCategory MLIRScanner::VisitOMPForDirective(clang::OMPForDirective *fors) {
   // TODO: set the value of the iteration value to the final bound at the
   // end of the loop.
   builder.setInsertionPoint(oldblock, oldpoint);
+}
 
-  for (auto pair : prevInduction)
+void MLIRScanner::buildOMPFor(clang::OMPLoopDirective *fors) {
+  auto loc = getMLIRLocation(fors->getBeginLoc());
+
+  std::map<const ValueDecl *, ValueCategory> prevReduction;
+  auto reductions = privatizeReductions(fors, prevReduction);
+
+  buildOMPWsLoop(fors);
+
+  if (!reductions.empty()) {
+    combineReductions(reductions);
+    // Like the loop itself, the combined values are only published to the
+    // other threads by a barrier unless nowait leaves that to the program.
+    if (!fors->getSingleClause<OMPNowaitClause>())
+      builder.create<omp::BarrierOp>(loc);
+  }
+
+  for (auto pair : prevReduction)
     params[pair.first] = pair.second;
+}
 
+ValueCategory MLIRScanner::VisitOMPForDirective(clang::OMPForDirective *fors) {
+  IfScope scope(*this);
+  buildOMPFor(fors);
   return nullptr;
 }
 
 ValueCategory
-MLIRScanner::VisitOMPParallelDirective(clang::OMPParallelDirective *par) {
+MLIRScanner::VisitOMPForSimdDirective(clang::OMPForSimdDirective *fors) {
   IfScope scope(*this);
+  buildOMPFor(fors);
+  return nullptr;
+}
+
+void MLIRScanner::buildOMPParallel(clang::OMPExecutableDirective *dir,
+                                   llvm::function_ref<void()> body) {
+  auto loc = getMLIRLocation(dir->getBeginLoc());
+
+  mlir::Value numThreads;
+  if (auto *clause = dir->getSingleClause<OMPNumThreadsClause>()) {
+    if (auto *preInit = clause->getPreInitStmt())
+      Visit(preInit);
+    numThreads = Visit(clause->getNumThreads()).getValue(loc, builder);
+  }
 
-  auto loc = getMLIRLocation(par->getBeginLoc());
   auto affineOp = builder.create<omp::ParallelOp>(loc);
+  if (numThreads)
+    affineOp.getNumThreadsVarMutable().assign(numThreads);
+
+  if (auto *clause = dir->getSingleClause<OMPProcBindClause>()) {
+    Optional<omp::ClauseProcBindKind> kind;
+    switch (clause->getProcBindKind()) {
+    case llvm::omp::OMP_PROC_BIND_master:
+      kind = omp::ClauseProcBindKind::Master;
+      break;
+    case llvm::omp::OMP_PROC_BIND_primary:
+      kind = omp::ClauseProcBindKind::Primary;
+      break;
+    case llvm::omp::OMP_PROC_BIND_close:
+      kind = omp::ClauseProcBindKind::Close;
+      break;
+    case llvm::omp::OMP_PROC_BIND_spread:
+      kind = omp::ClauseProcBindKind::Spread;
+      break;
+    default:
+      break;
+    }
+    if (kind)
+      affineOp.setProcBindValAttr(
+          omp::ClauseProcBindKindAttr::get(builder.getContext(), *kind));
+  }
 
   auto oldpoint = builder.getInsertionPoint();
   auto *oldblock = builder.getInsertionBlock();
@@ -554,93 +1123,108 @@ MLIRScanner::VisitOMPParallelDirective(clang::OMPParallelDirective *par) {
   auto *oldScope = allocationScope;
   allocationScope = &executeRegion.getRegion().back();
 
-  std::map<VarDecl *, ValueCategory> prevInduction;
-  for (auto *f : par->clauses()) {
-    switch (f->getClauseKind()) {
-    case llvm::omp::OMPC_private:
-      for (auto *stmt : f->children()) {
-        VarDecl *name = cast<VarDecl>(cast<DeclRefExpr>(stmt)->getDecl());
-
-        prevInduction[name] = params[name];
-        params.erase(name);
-
-        bool LLVMABI = false;
-        bool isArray = false;
-        mlir::Type ty;
-        if (Glob.getMLIRType(Glob.CGM.getContext().getLValueReferenceType(
-                                 name->getType()))
-                .isa<mlir::LLVM::LLVMPointerType>()) {
-          LLVMABI = true;
-          bool undef;
-          ty = Glob.getMLIRType(name->getType(), &undef);
-        } else
-          ty = Glob.getMLIRType(name->getType(), &isArray);
-
-        auto allocop = createAllocOp(ty, name, /*memtype*/ 0,
-                                     /*isArray*/ isArray, /*LLVMABI*/ LLVMABI);
-        params[name] = ValueCategory(allocop, true);
-        params[name].store(loc, builder, prevInduction[name], isArray);
-      }
-      break;
-    default:
-      llvm::errs() << "may not handle omp clause " << (int)f->getClauseKind()
-                   << "\n";
-    }
-  }
-
-  Visit(cast<CapturedStmt>(par->getAssociatedStmt())
-            ->getCapturedDecl()
-            ->getBody());
+  body();
 
   builder.create<scf::YieldOp>(loc);
   allocationScope = oldScope;
   builder.setInsertionPoint(oldblock, oldpoint);
+}
+
+ValueCategory
+MLIRScanner::VisitOMPParallelDirective(clang::OMPParallelDirective *par) {
+  IfScope scope(*this);
+
+  auto loc = getMLIRLocation(par->getBeginLoc());
+
+  std::map<const ValueDecl *, ValueCategory> prevInduction;
+  buildOMPParallel(par, [&] {
+    for (auto *f : par->clauses()) {
+      switch (f->getClauseKind()) {
+      case llvm::omp::OMPC_private:
+        for (auto *stmt : f->children()) {
+          VarDecl *name = cast<VarDecl>(cast<DeclRefExpr>(stmt)->getDecl());
+
+          prevInduction[name] = params[name];
+          params.erase(name);
+
+          bool LLVMABI = false;
+          bool isArray = false;
+          mlir::Type ty;
+          if (Glob.getMLIRType(Glob.CGM.getContext().getLValueReferenceType(
+                                   name->getType()))
+                  .isa<mlir::LLVM::LLVMPointerType>()) {
+            LLVMABI = true;
+            bool undef;
+            ty = Glob.getMLIRType(name->getType(), &undef);
+          } else
+            ty = Glob.getMLIRType(name->getType(), &isArray);
+
+          auto allocop =
+              createAllocOp(ty, name, /*memtype*/ 0,
+                            /*isArray*/ isArray, /*LLVMABI*/ LLVMABI);
+          params[name] = ValueCategory(allocop, true);
+          params[name].store(loc, builder, prevInduction[name], isArray);
+        }
+        break;
+      case llvm::omp::OMPC_reduction:
+        break;
+      default:
+        llvm::errs() << "may not handle omp clause "
+                     << (int)f->getClauseKind() << "\n";
+      }
+    }
+
+    auto reductions = privatizeReductions(par, prevInduction);
+
+    Visit(cast<CapturedStmt>(par->getAssociatedStmt())
+              ->getCapturedDecl()
+              ->getBody());
+
+    combineReductions(reductions);
+  });
 
   for (auto pair : prevInduction)
     params[pair.first] = pair.second;
   return nullptr;
 }
 
+void MLIRScanner::buildOMPParallelFor(clang::OMPLoopDirective *fors) {
+  std::map<const ValueDecl *, ValueCategory> prevReduction;
+  buildOMPParallel(fors, [&] {
+    auto reductions = privatizeReductions(fors, prevReduction);
+    buildOMPWsLoop(fors);
+    combineReductions(reductions);
+  });
+  for (auto pair : prevReduction)
+    params[pair.first] = pair.second;
+}
+
+ValueCategory MLIRScanner::VisitOMPParallelForSimdDirective(
+    clang::OMPParallelForSimdDirective *fors) {
+  IfScope scope(*this);
+  buildOMPParallelFor(fors);
+  return nullptr;
+}
+
 ValueCategory MLIRScanner::VisitOMPParallelForDirective(
     clang::OMPParallelForDirective *fors) {
   IfScope scope(*this);
   auto loc = getMLIRLocation(fors->getBeginLoc());
 
-  if (fors->getPreInits()) {
-    Visit(fors->getPreInits());
-  }
-
-  SmallVector<mlir::Value> inits;
-  for (auto *f : fors->inits()) {
-    assert(f);
-    f = cast<clang::BinaryOperator>(f)->getRHS();
-    inits.push_back(builder.create<IndexCastOp>(
-        loc, builder.getIndexType(), Visit(f).getValue(loc, builder)));
-  }
-
-  SmallVector<mlir::Value> finals;
-  for (auto *f : fors->finals()) {
-    f = cast<clang::BinaryOperator>(f)->getRHS();
-    finals.push_back(builder.create<arith::IndexCastOp>(
-        loc, builder.getIndexType(), Visit(f).getValue(loc, builder)));
+  // A parallel loop has no per-thread state to hold private copies of the
+  // reduction variables, nor a place for the clauses picking the threads and
+  // their schedule, so these need a parallel region around a worksharing
+  // loop instead.
+  if (fors->hasClausesOfKind<OMPReductionClause>() ||
+      fors->hasClausesOfKind<OMPScheduleClause>() ||
+      fors->hasClausesOfKind<OMPNumThreadsClause>() ||
+      fors->hasClausesOfKind<OMPProcBindClause>()) {
+    buildOMPParallelFor(fors);
+    return nullptr;
   }
 
-  SmallVector<mlir::Value> incs;
-  for (auto *f : fors->updates()) {
-    f = cast<clang::BinaryOperator>(f)->getRHS();
-    while (auto *ce = dyn_cast<clang::CastExpr>(f))
-      f = ce->getSubExpr();
-    auto *bo = cast<clang::BinaryOperator>(f);
-    assert(bo->getOpcode() == clang::BinaryOperator::Opcode::BO_Add);
-    f = bo->getRHS();
-    while (auto *ce = dyn_cast<clang::CastExpr>(f))
-      f = ce->getSubExpr();
-    bo = cast<clang::BinaryOperator>(f);
-    assert(bo->getOpcode() == clang::BinaryOperator::Opcode::BO_Mul);
-    f = bo->getRHS();
-    incs.push_back(builder.create<IndexCastOp>(
-        loc, builder.getIndexType(), Visit(f).getValue(loc, builder)));
-  }
+  SmallVector<mlir::Value> inits, finals, incs;
+  buildOMPLoopBounds(fors, inits, finals, incs);
 
   auto affineOp = builder.create<scf::ParallelOp>(loc, inits, finals, incs);
 
@@ -659,48 +1243,295 @@ ValueCategory MLIRScanner::VisitOMPParallelForDirective(
   auto *oldScope = allocationScope;
   allocationScope = &executeRegion.getRegion().back();
 
-  std::map<VarDecl *, ValueCategory> prevInduction;
-  for (auto zp : zip(inds, fors->counters())) {
-    auto idx = builder.create<IndexCastOp>(
-        loc, getMLIRType(fors->getIterationVariable()->getType()),
-        std::get<0>(zp));
-    VarDecl *name =
-        cast<VarDecl>(cast<DeclRefExpr>(std::get<1>(zp))->getDecl());
+  std::map<const ValueDecl *, ValueCategory> prevInduction;
+  privatizeCounters(fors, inds, prevInduction);
+
+  // TODO: set loop context.
+  Visit(fors->getBody());
+
+  builder.create<scf::YieldOp>(loc);
+
+  allocationScope = oldScope;
+
+  // TODO: set the value of the iteration value to the final bound at the
+  // end of the loop.
+  builder.setInsertionPoint(oldblock, oldpoint);
+
+  for (auto pair : prevInduction)
+    params[pair.first] = pair.second;
+
+  return nullptr;
+}
+
+void MLIRScanner::buildOMPTask(clang::OMPExecutableDirective *dir,
+                               llvm::function_ref<void()> body) {
+  auto loc = getMLIRLocation(dir->getBeginLoc());
+
+  // Firstprivate variables take the value they have when the task is
+  // created, which may be long before it runs, so read them here. Arrays
+  // are copied when the task starts.
+  SmallVector<std::pair<VarDecl *, ValueCategory>> copies;
+  for (auto *f : dir->clauses()) {
+    switch (f->getClauseKind()) {
+    case llvm::omp::OMPC_private:
+      for (auto *stmt : f->children())
+        copies.emplace_back(cast<VarDecl>(cast<DeclRefExpr>(stmt)->getDecl()),
+                            nullptr);
+      break;
+    case llvm::omp::OMPC_firstprivate:
+      for (auto *stmt : f->children()) {
+        auto *ref = cast<DeclRefExpr>(stmt);
+        auto val = Visit(ref);
+        if (!ref->getType()->isArrayType())
+          val = ValueCategory(val.getValue(loc, builder),
+                              /*isReference*/ false);
+        copies.emplace_back(cast<VarDecl>(ref->getDecl()), val);
+      }
+      break;
+    case llvm::omp::OMPC_shared:
+    case llvm::omp::OMPC_collapse:
+    case llvm::omp::OMPC_grainsize:
+    case llvm::omp::OMPC_num_tasks:
+    case llvm::omp::OMPC_nogroup:
+      break;
+    default:
+      llvm::errs() << "may not handle omp clause " << (int)f->getClauseKind()
+                   << "\n";
+    }
+  }
+
+  auto taskOp = builder.create<omp::TaskOp>(
+      loc, /*if_expr*/ nullptr, /*final_expr*/ nullptr, /*untied*/ nullptr,
+      /*mergeable*/ nullptr, /*in_reduction_vars*/ ValueRange(),
+      /*in_reductions*/ nullptr, /*priority*/ nullptr,
+      /*allocate_vars*/ ValueRange(), /*allocators_vars*/ ValueRange());
+
+  auto oldpoint = builder.getInsertionPoint();
+  auto *oldblock = builder.getInsertionBlock();
+
+  taskOp.getRegion().push_back(new Block());
+  builder.setInsertionPointToStart(&taskOp.getRegion().front());
 
+  auto executeRegion =
+      builder.create<scf::ExecuteRegionOp>(loc, ArrayRef<mlir::Type>());
+  executeRegion.getRegion().push_back(new Block());
+  builder.create<omp::TerminatorOp>(loc);
+  builder.setInsertionPointToStart(&executeRegion.getRegion().back());
+
+  auto *oldScope = allocationScope;
+  allocationScope = &executeRegion.getRegion().back();
+
+  std::map<const ValueDecl *, ValueCategory> prevCaptured;
+  for (auto &copy : copies) {
+    VarDecl *name = copy.first;
     if (params.find(name) != params.end()) {
-      prevInduction[name] = params[name];
+      prevCaptured[name] = params[name];
       params.erase(name);
     }
 
     bool LLVMABI = false;
     bool isArray = false;
+    mlir::Type ty;
     if (Glob.getMLIRType(
                 Glob.CGM.getContext().getLValueReferenceType(name->getType()))
-            .isa<mlir::LLVM::LLVMPointerType>())
+            .isa<mlir::LLVM::LLVMPointerType>()) {
       LLVMABI = true;
-    else
-      Glob.getMLIRType(name->getType(), &isArray);
+      bool undef;
+      ty = Glob.getMLIRType(name->getType(), &undef);
+    } else
+      ty = Glob.getMLIRType(name->getType(), &isArray);
 
-    auto allocop = createAllocOp(idx.getType(), name, /*memtype*/ 0,
+    auto allocop = createAllocOp(ty, name, /*memtype*/ 0,
                                  /*isArray*/ isArray, /*LLVMABI*/ LLVMABI);
     params[name] = ValueCategory(allocop, true);
-    params[name].store(loc, builder, idx);
+    if (copy.second.val)
+      params[name].store(loc, builder, copy.second, isArray);
   }
 
-  // TODO: set loop context.
-  Visit(fors->getBody());
+  body();
 
-  builder.create<scf::YieldOp>(loc);
+  for (auto &copy : copies)
+    params.erase(copy.first);
+  for (auto pair : prevCaptured)
+    params[pair.first] = pair.second;
 
+  builder.create<scf::YieldOp>(loc);
   allocationScope = oldScope;
+  builder.setInsertionPoint(oldblock, oldpoint);
+}
+
+ValueCategory
+MLIRScanner::VisitOMPTaskDirective(clang::OMPTaskDirective *task) {
+  IfScope scope(*this);
+  buildOMPTask(task, [&] {
+    Visit(cast<CapturedStmt>(task->getAssociatedStmt())
+              ->getCapturedDecl()
+              ->getBody());
+  });
+  return nullptr;
+}
+
+ValueCategory
+MLIRScanner::VisitOMPTaskwaitDirective(clang::OMPTaskwaitDirective *wait) {
+  builder.create<omp::TaskwaitOp>(getMLIRLocation(wait->getBeginLoc()));
+  return nullptr;
+}
+
+ValueCategory
+MLIRScanner::VisitOMPTaskLoopDirective(clang::OMPTaskLoopDirective *fors) {
+  IfScope scope(*this);
+  auto loc = getMLIRLocation(fors->getBeginLoc());
+
+  SmallVector<mlir::Value> inits, finals, incs;
+  buildOMPLoopBounds(fors, inits, finals, incs);
+
+  // Each task runs a chunk of `grain` iterations of the outermost loop.
+  mlir::Value grain;
+  if (auto *clause = fors->getSingleClause<OMPGrainsizeClause>()) {
+    if (auto *preInit = clause->getPreInitStmt())
+      Visit(preInit);
+    grain = builder.create<IndexCastOp>(
+        loc, builder.getIndexType(),
+        Visit(clause->getGrainsize()).getValue(loc, builder));
+  } else {
+    mlir::Value numTasks;
+    if (auto *clause = fors->getSingleClause<OMPNumTasksClause>()) {
+      if (auto *preInit = clause->getPreInitStmt())
+        Visit(preInit);
+      numTasks = builder.create<IndexCastOp>(
+          loc, builder.getIndexType(),
+          Visit(clause->getNumTasks()).getValue(loc, builder));
+    } else {
+      // Like libomp, create ten tasks per thread of the team by default, so
+      // that they balance the load without each task being tiny.
+      auto getNumThreads = Glob.GetOrCreateRuntimeFunction(
+          "omp_get_num_threads",
+          builder.getFunctionType({}, builder.getI32Type()));
+      mlir::Value threads = builder.create<IndexCastOp>(
+          loc, builder.getIndexType(),
+          builder.create<mlir::func::CallOp>(loc, getNumThreads, ValueRange())
+              .getResult(0));
+      numTasks = builder.create<MulIOp>(
+          loc, threads, builder.create<ConstantIndexOp>(loc, 10));
+    }
+    // No more tasks than iterations, and at least one task.
+    mlir::Value iters = builder.create<CeilDivSIOp>(
+        loc, builder.create<SubIOp>(loc, finals[0], inits[0]), incs[0]);
+    numTasks = builder.create<MinSIOp>(loc, numTasks, iters);
+    numTasks = builder.create<MaxSIOp>(
+        loc, numTasks, builder.create<ConstantIndexOp>(loc, 1));
+    grain = builder.create<CeilDivSIOp>(loc, iters, numTasks);
+  }
+  grain = builder.create<MaxSIOp>(loc, grain,
+                                  builder.create<ConstantIndexOp>(loc, 1));
+  mlir::Value chunkStep = builder.create<MulIOp>(loc, grain, incs[0]);
+
+  auto chunks =
+      builder.create<scf::ForOp>(loc, inits[0], finals[0], chunkStep);
+
+  auto oldpoint = builder.getInsertionPoint();
+  auto *oldblock = builder.getInsertionBlock();
+
+  builder.setInsertionPointToStart(chunks.getBody());
+  SmallVector<mlir::Value> lbs(inits), ubs(finals);
+  lbs[0] = chunks.getInductionVar();
+  ubs[0] = builder.create<MinSIOp>(
+      loc, builder.create<AddIOp>(loc, lbs[0], chunkStep), finals[0]);
+
+  buildOMPTask(fors, [&] {
+    buildOMPLoopBody(fors, {}, lbs, ubs, incs, nullptr);
+  });
 
-  // TODO: set the value of the iteration value to the final bound at the
-  // end of the loop.
   builder.setInsertionPoint(oldblock, oldpoint);
 
-  for (auto pair : prevInduction)
-    params[pair.first] = pair.second;
+  // The tasks of the loop form a task group, which the loop waits for.
+  if (!fors->getSingleClause<OMPNogroupClause>())
+    builder.create<omp::TaskwaitOp>(loc);
+  return nullptr;
+}
+
+mlir::DictionaryAttr
+MLIRScanner::buildOMPSimdClauses(clang::OMPLoopDirective *fors) {
+  auto loc = getMLIRLocation(fors->getBeginLoc());
+  auto &ctx = Glob.astContext;
+
+  mlir::NamedAttrList hints;
+  hints.set("vectorize", builder.getBoolAttr(true));
+
+  // Without a safelen, no iteration depends on another, except through the
+  // variables of data-sharing clauses. As these are not privatized, their
+  // accesses must stay visible to the vectorizer. With a safelen, vectors
+  // may not span more iterations than it allows.
+  bool sharesVariables = fors->hasClausesOfKind<OMPPrivateClause>() ||
+                         fors->hasClausesOfKind<OMPLastprivateClause>() ||
+                         fors->hasClausesOfKind<OMPLinearClause>() ||
+                         fors->hasClausesOfKind<OMPReductionClause>();
+  uint64_t width = 0;
+  if (auto *clause = fors->getSingleClause<OMPSimdlenClause>())
+    width = clause->getSimdlen()->EvaluateKnownConstInt(ctx).getZExtValue();
+  if (auto *clause = fors->getSingleClause<OMPSafelenClause>()) {
+    uint64_t safelen =
+        clause->getSafelen()->EvaluateKnownConstInt(ctx).getZExtValue();
+    if (!width || width > safelen)
+      width = safelen;
+  } else if (!sharesVariables)
+    hints.set("parallel", builder.getUnitAttr());
+  if (width)
+    hints.set("vectorize_width", builder.getI64IntegerAttr(width));
+
+  for (auto *clause : fors->getClausesOfKind<OMPAlignedClause>()) {
+    uint64_t align = 0;
+    if (auto *alignment = clause->getAlignment())
+      align = alignment->EvaluateKnownConstInt(ctx).getZExtValue();
+    for (auto *ref : clause->varlists()) {
+      uint64_t varAlign = align;
+      if (!varAlign) {
+        QualType elemTy = ref->getType();
+        if (auto *pt = elemTy->getAs<clang::PointerType>())
+          elemTy = pt->getPointeeType();
+        else if (auto *at = ctx.getAsArrayType(elemTy))
+          elemTy = at->getElementType();
+        varAlign = ctx.toCharUnitsFromBits(
+                          ctx.getOpenMPDefaultSimdAlign(elemTy))
+                       .getQuantity();
+      }
+      if (!llvm::isPowerOf2_64(varAlign))
+        continue;
+
+      mlir::Value ptr = Visit(ref).getValue(loc, builder);
+      if (auto mt = ptr.getType().dyn_cast<MemRefType>())
+        ptr = builder.create<polygeist::Memref2PointerOp>(
+            loc,
+            LLVM::LLVMPointerType::get(mt.getElementType(),
+                                       mt.getMemorySpaceAsInt()),
+            ptr);
+      if (!ptr.getType().isa<LLVM::LLVMPointerType>())
+        continue;
+      auto addr =
+          builder.create<LLVM::PtrToIntOp>(loc, builder.getI64Type(), ptr);
+      auto misalign = builder.create<AndIOp>(
+          loc, addr, builder.create<ConstantIntOp>(loc, varAlign - 1, 64));
+      builder.create<LLVM::AssumeOp>(
+          loc, builder.create<arith::CmpIOp>(
+                   loc, CmpIPredicate::eq, misalign,
+                   builder.create<ConstantIntOp>(loc, 0, 64)));
+    }
+  }
 
+  return hints.getDictionary(builder.getContext());
+}
+
+ValueCategory
+MLIRScanner::VisitOMPSimdDirective(clang::OMPSimdDirective *fors) {
+  IfScope scope(*this);
+
+  SmallVector<mlir::Value> inits, finals, incs;
+  buildOMPLoopBounds(fors, inits, finals, incs);
+
+  // Run in order, the loop needs no private copies for its private and
+  // reduction clauses. Vectorizing it is left to LLVM, which is not told
+  // to ignore the dependences through these variables.
+  buildOMPLoopBody(fors, {}, inits, finals, incs, buildOMPSimdClauses(fors));
   return nullptr;
 }
 
@@ -708,13 +1539,10 @@ ValueCategory MLIRScanner::VisitDoStmt(clang::DoStmt *fors) {
   IfScope scope(*this);
 
   auto loc = getMLIRLocation(fors->getDoLoc());
+  auto hints = getLoopHints(fors->getDoLoc());
 
-  auto i1Ty = builder.getIntegerType(1);
-  auto type = mlir::MemRefType::get({}, i1Ty, {}, 0);
-  auto truev = builder.create<ConstantIntOp>(loc, true, 1);
-  loops.push_back({builder.create<mlir::memref::AllocaOp>(loc, type),
-                   builder.create<mlir::memref::AllocaOp>(loc, type)});
-  builder.create<mlir::memref::StoreOp>(loc, truev, loops.back().noBreak);
+  loops.push_back(createLoopContext(loc, fors->getBody()));
+  auto carried = getLoopCarriedLocals(fors);
 
   auto *toadd = builder.getInsertionBlock()->getParent();
   auto &condB = *(new Block());
@@ -724,8 +1552,23 @@ ValueCategory MLIRScanner::VisitDoStmt(clang::DoStmt *fors) {
   auto &exitB = *(new Block());
   toadd->getBlocks().push_back(&exitB);
 
-  builder.create<mlir::cf::BranchOp>(loc, &bodyB);
+  builder.create<mlir::cf::BranchOp>(loc, &bodyB, getLocalValues(carried));
 
+  builder.setInsertionPointToStart(&bodyB);
+  bindBlockArguments(&bodyB, carried, loc);
+  if (loops.back().keepRunning)
+    builder.create<mlir::memref::StoreOp>(
+        loc,
+        builder.create<mlir::memref::LoadOp>(loc, loops.back().noBreak,
+                                             std::vector<mlir::Value>()),
+        loops.back().keepRunning, std::vector<mlir::Value>());
+
+  Visit(fors->getBody());
+
+  builder.create<mlir::cf::BranchOp>(loc, &condB);
+
+  // The condition is emitted after the body so that it, the back edge and
+  // the code after the loop see the values the body leaves in locals.
   builder.setInsertionPointToStart(&condB);
 
   if (auto *s = fors->getCond()) {
@@ -742,24 +1585,20 @@ ValueCategory MLIRScanner::VisitDoStmt(clang::DoStmt *fors) {
           loc, CmpIPredicate::ne, cond,
           builder.create<ConstantIntOp>(loc, 0, ty));
     }
-    auto nb = builder.create<mlir::memref::LoadOp>(loc, loops.back().noBreak,
-                                                   std::vector<mlir::Value>());
-    cond = builder.create<AndIOp>(loc, cond, nb);
-    builder.create<mlir::cf::CondBranchOp>(loc, cond, &bodyB, &exitB);
+    if (loops.back().noBreak) {
+      auto nb = builder.create<mlir::memref::LoadOp>(
+          loc, loops.back().noBreak, std::vector<mlir::Value>());
+      cond = builder.create<AndIOp>(loc, cond, nb);
+    }
+    // The condition closes the back edge of a do loop.
+    auto backEdge = builder.create<mlir::cf::CondBranchOp>(
+        loc, cond, &bodyB, getLocalValues(carried), &exitB,
+        mlir::ValueRange());
+    if (hints)
+      backEdge->setAttr(LoopHintsAttrName, hints);
   }
-
-  builder.setInsertionPointToStart(&bodyB);
-  builder.create<mlir::memref::StoreOp>(
-      loc,
-      builder.create<mlir::memref::LoadOp>(loc, loops.back().noBreak,
-                                           std::vector<mlir::Value>()),
-      loops.back().keepRunning, std::vector<mlir::Value>());
-
-  Visit(fors->getBody());
   loops.pop_back();
 
-  builder.create<mlir::cf::BranchOp>(loc, &condB);
-
   builder.setInsertionPointToStart(&exitB);
 
   return nullptr;
@@ -769,13 +1608,10 @@ ValueCategory MLIRScanner::VisitWhileStmt(clang::WhileStmt *stmt) {
   IfScope scope(*this);
 
   auto loc = getMLIRLocation(stmt->getLParenLoc());
+  auto hints = getLoopHints(stmt->getWhileLoc());
 
-  auto i1Ty = builder.getIntegerType(1);
-  auto type = mlir::MemRefType::get({}, i1Ty, {}, 0);
-  auto truev = builder.create<ConstantIntOp>(loc, true, 1);
-  loops.push_back({builder.create<mlir::memref::AllocaOp>(loc, type),
-                   builder.create<mlir::memref::AllocaOp>(loc, type)});
-  builder.create<mlir::memref::StoreOp>(loc, truev, loops.back().noBreak);
+  loops.push_back(createLoopContext(loc, stmt->getBody()));
+  auto carried = getLoopCarriedLocals(stmt);
 
   auto *toadd = builder.getInsertionBlock()->getParent();
   auto &condB = *(new Block());
@@ -785,9 +1621,10 @@ ValueCategory MLIRScanner::VisitWhileStmt(clang::WhileStmt *stmt) {
   auto &exitB = *(new Block());
   toadd->getBlocks().push_back(&exitB);
 
-  builder.create<mlir::cf::BranchOp>(loc, &condB);
+  builder.create<mlir::cf::BranchOp>(loc, &condB, getLocalValues(carried));
 
   builder.setInsertionPointToStart(&condB);
+  auto header = bindBlockArguments(&condB, carried, loc);
 
   if (auto declStmt = stmt->getConditionVariableDeclStmt())
     Visit(declStmt);
@@ -805,25 +1642,32 @@ ValueCategory MLIRScanner::VisitWhileStmt(clang::WhileStmt *stmt) {
           loc, CmpIPredicate::ne, cond,
           builder.create<ConstantIntOp>(loc, 0, ty));
     }
-    auto nb = builder.create<mlir::memref::LoadOp>(loc, loops.back().noBreak,
-                                                   std::vector<mlir::Value>());
-    cond = builder.create<AndIOp>(loc, cond, nb);
+    if (loops.back().noBreak) {
+      auto nb = builder.create<mlir::memref::LoadOp>(
+          loc, loops.back().noBreak, std::vector<mlir::Value>());
+      cond = builder.create<AndIOp>(loc, cond, nb);
+    }
     builder.create<mlir::cf::CondBranchOp>(loc, cond, &bodyB, &exitB);
   }
 
   builder.setInsertionPointToStart(&bodyB);
-  builder.create<mlir::memref::StoreOp>(
-      loc,
-      builder.create<mlir::memref::LoadOp>(loc, loops.back().noBreak,
-                                           std::vector<mlir::Value>()),
-      loops.back().keepRunning, std::vector<mlir::Value>());
+  if (loops.back().keepRunning)
+    builder.create<mlir::memref::StoreOp>(
+        loc,
+        builder.create<mlir::memref::LoadOp>(loc, loops.back().noBreak,
+                                             std::vector<mlir::Value>()),
+        loops.back().keepRunning, std::vector<mlir::Value>());
 
   Visit(stmt->getBody());
   loops.pop_back();
 
-  builder.create<mlir::cf::BranchOp>(loc, &condB);
+  auto backEdge =
+      builder.create<mlir::cf::BranchOp>(loc, &condB, getLocalValues(carried));
+  if (hints)
+    backEdge->setAttr(LoopHintsAttrName, hints);
 
   builder.setInsertionPointToStart(&exitB);
+  rebindLocals(carried, header);
 
   return nullptr;
 }
@@ -1031,8 +1875,13 @@ ValueCategory MLIRScanner::VisitDeclStmt(clang::DeclStmt *decl) {
 }
 
 ValueCategory MLIRScanner::VisitAttributedStmt(AttributedStmt *AS) {
-  emitWarning(getMLIRLocation(AS->getAttrLoc())) << "ignoring attributes\n";
-  return Visit(AS->getSubStmt());
+  if (!llvm::all_of(AS->getAttrs(),
+                    [](const Attr *A) { return isa<LoopHintAttr>(A); }))
+    emitWarning(getMLIRLocation(AS->getAttrLoc())) << "ignoring attributes\n";
+  loopAttrs = AS->getAttrs();
+  auto res = Visit(AS->getSubStmt());
+  loopAttrs = {};
+  return res;
 }
 
 ValueCategory MLIRScanner::VisitCompoundStmt(clang::CompoundStmt *stmt) {
@@ -1181,6 +2030,8 @@ ValueCategory MLIRScanner::VisitReturnStmt(clang::ReturnStmt *stmt) {
   auto vfalse =
       builder.create<ConstantIntOp>(builder.getUnknownLoc(), false, 1);
   for (auto l : loops) {
+    if (!l.keepRunning)
+      continue;
     builder.create<mlir::memref::StoreOp>(loc, vfalse, l.keepRunning);
     builder.create<mlir::memref::StoreOp>(loc, vfalse, l.noBreak);
   }
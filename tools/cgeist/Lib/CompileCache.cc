@@ -0,0 +1,259 @@
+//===- CompileCache.cc - On-disk cache of cgeist outputs --------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "CompileCache.h"
+
+#include "clang/Basic/Version.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/SHA256.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace llvm;
+using namespace mlirclang;
+
+/// Bump whenever the layout of cached entries changes.
+static constexpr unsigned CacheFormatVersion = 1;
+
+static constexpr StringLiteral EntrySuffix = ".entry";
+
+CompileCache::CompileCache(StringRef directory, uint64_t maxSizeInBytes)
+    : directory(directory.str()), maxSizeInBytes(maxSizeInBytes) {
+  sys::fs::create_directories(directory);
+}
+
+const std::string &CompileCache::getToolIdentity() {
+  static const std::string identity = [] {
+    static int anchor;
+    std::string identity = clang::getClangFullVersion();
+    std::string exe = sys::fs::getMainExecutable("cgeist", (void *)&anchor);
+    sys::fs::file_status status;
+    if (!exe.empty() && !sys::fs::status(exe, status))
+      identity += " " + std::to_string(status.getSize()) + " " +
+                  std::to_string(status.getLastModificationTime()
+                                     .time_since_epoch()
+                                     .count());
+    return identity;
+  }();
+  return identity;
+}
+
+std::string CompileCache::computeKey(ArrayRef<std::string> options,
+                                     ArrayRef<std::string> inputs) {
+  SHA256 hasher;
+  // Length-prefix every field so that adjacent fields cannot alias.
+  auto add = [&](StringRef field) {
+    hasher.update(std::to_string(field.size()));
+    hasher.update(":");
+    hasher.update(field);
+  };
+  add("cgeist-cache-v" + std::to_string(CacheFormatVersion));
+  add(getToolIdentity());
+  for (const auto &option : options)
+    add(option);
+  for (const auto &input : inputs)
+    add(input);
+  return toHex(hasher.final(), /*LowerCase*/ true);
+}
+
+std::string CompileCache::getEntryPath(StringRef key) const {
+  SmallString<128> path(directory);
+  sys::path::append(path, key + EntrySuffix);
+  return std::string(path.str());
+}
+
+std::unique_ptr<MemoryBuffer> CompileCache::lookup(StringRef key) {
+  std::string entry = getEntryPath(key);
+  auto buffer = MemoryBuffer::getFile(entry, /*IsText*/ false,
+                                      /*RequiresNullTerminator*/ false);
+  if (!buffer) {
+    updateStatistics(/*hit*/ false);
+    return nullptr;
+  }
+
+  // Refresh the timestamp that eviction is based on.
+  int FD;
+  if (!sys::fs::openFileForWrite(entry, FD, sys::fs::CD_OpenExisting,
+                                 sys::fs::OF_Append)) {
+    sys::fs::setLastAccessAndModificationTime(FD,
+                                              std::chrono::system_clock::now());
+    sys::Process::SafelyCloseFileDescriptor(FD);
+  }
+  updateStatistics(/*hit*/ true);
+  return std::move(*buffer);
+}
+
+bool CompileCache::lookup(StringRef key, StringRef output) {
+  auto buffer = lookup(key);
+  if (!buffer)
+    return false;
+
+  std::error_code EC;
+  raw_fd_ostream out(output, EC, sys::fs::OF_None);
+  if (EC) {
+    errs() << "Failed to open " << output << ": " << EC.message() << "\n";
+    return false;
+  }
+  out << buffer->getBuffer();
+  return true;
+}
+
+/// Entries are written to a private file first and renamed into place so
+/// that concurrent readers never observe a partially written entry.
+bool CompileCache::createTemporaryEntry(int &FD, SmallVectorImpl<char> &path) {
+  SmallString<128> model(directory);
+  sys::path::append(model, "%%%%%%%%.tmp");
+  return !sys::fs::createUniqueFile(model, FD, path);
+}
+
+bool CompileCache::commitEntry(StringRef key, StringRef tmp) {
+  if (sys::fs::rename(tmp, getEntryPath(key))) {
+    sys::fs::remove(tmp);
+    return false;
+  }
+  prune();
+  return true;
+}
+
+bool CompileCache::store(StringRef key, StringRef path) {
+  int FD;
+  SmallString<128> tmp;
+  if (!createTemporaryEntry(FD, tmp))
+    return false;
+  sys::Process::SafelyCloseFileDescriptor(FD);
+  if (sys::fs::copy_file(path, tmp)) {
+    sys::fs::remove(tmp);
+    return false;
+  }
+  return commitEntry(key, tmp);
+}
+
+bool CompileCache::storeBuffer(StringRef key, StringRef contents) {
+  int FD;
+  SmallString<128> tmp;
+  if (!createTemporaryEntry(FD, tmp))
+    return false;
+  {
+    raw_fd_ostream out(FD, /*shouldClose*/ true);
+    out << contents;
+    out.close();
+    if (out.has_error()) {
+      out.clear_error();
+      sys::fs::remove(tmp);
+      return false;
+    }
+  }
+  return commitEntry(key, tmp);
+}
+
+void CompileCache::prune() {
+  struct Entry {
+    std::string path;
+    uint64_t size;
+    sys::TimePoint<> lastUse;
+  };
+  std::vector<Entry> entries;
+  uint64_t totalSize = 0;
+
+  std::error_code EC;
+  for (sys::fs::directory_iterator it(directory, EC), end; it != end && !EC;
+       it.increment(EC)) {
+    if (!StringRef(it->path()).endswith(EntrySuffix))
+      continue;
+    sys::fs::file_status status;
+    if (sys::fs::status(it->path(), status))
+      continue;
+    entries.push_back({it->path(), status.getSize(),
+                       status.getLastModificationTime()});
+    totalSize += status.getSize();
+  }
+  if (totalSize <= maxSizeInBytes)
+    return;
+
+  llvm::sort(entries, [](const Entry &a, const Entry &b) {
+    return a.lastUse < b.lastUse;
+  });
+  for (const auto &entry : entries) {
+    if (totalSize <= maxSizeInBytes)
+      break;
+    if (!sys::fs::remove(entry.path))
+      totalSize -= entry.size;
+  }
+}
+
+/// Statistics live in a small text file next to the entries. Updates are
+/// serialized with an advisory lock since several cgeist processes may share
+/// one cache.
+void CompileCache::updateStatistics(bool hit) {
+  SmallString<128> path(directory);
+  sys::path::append(path, "stats");
+  int FD;
+  if (sys::fs::openFileForReadWrite(path, FD, sys::fs::CD_OpenAlways,
+                                    sys::fs::OF_None))
+    return;
+  if (sys::fs::lockFile(FD)) {
+    sys::Process::SafelyCloseFileDescriptor(FD);
+    return;
+  }
+
+  uint64_t hits = 0, misses = 0;
+  SmallString<64> contents;
+  if (!errorToBool(sys::fs::readNativeFileToEOF(
+          sys::fs::convertFDToNativeFile(FD), contents))) {
+    SmallVector<StringRef, 2> lines;
+    StringRef(contents).split(lines, '\n', -1, /*KeepEmpty*/ false);
+    for (StringRef line : lines) {
+      auto [name, value] = line.split(' ');
+      if (name == "hits")
+        value.getAsInteger(10, hits);
+      else if (name == "misses")
+        value.getAsInteger(10, misses);
+    }
+  }
+  (hit ? hits : misses)++;
+
+  {
+    raw_fd_ostream out(FD, /*shouldClose*/ false);
+    out.seek(0);
+    out << "hits " << hits << "\nmisses " << misses << "\n";
+  }
+  sys::fs::resize_file(FD, std::to_string(hits).size() +
+                               std::to_string(misses).size() + 14);
+  sys::fs::unlockFile(FD);
+  sys::Process::SafelyCloseFileDescriptor(FD);
+}
+
+void CompileCache::printStatistics(raw_ostream &os) const {
+  SmallString<128> path(directory);
+  sys::path::append(path, "stats");
+  uint64_t entries = 0, totalSize = 0;
+  std::error_code EC;
+  for (sys::fs::directory_iterator it(directory, EC), end; it != end && !EC;
+       it.increment(EC)) {
+    sys::fs::file_status status;
+    if (!StringRef(it->path()).endswith(EntrySuffix) ||
+        sys::fs::status(it->path(), status))
+      continue;
+    entries++;
+    totalSize += status.getSize();
+  }
+
+  os << "cgeist cache: " << directory << "\n";
+  if (auto buffer = MemoryBuffer::getFile(path))
+    os << (*buffer)->getBuffer();
+  os << "entries " << entries << "\nsize " << totalSize << " / "
+     << maxSizeInBytes << " bytes\n";
+}
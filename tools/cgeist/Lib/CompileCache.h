@@ -0,0 +1,73 @@
+//===- CompileCache.h - On-disk cache of cgeist outputs ---------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MLIR_TOOLS_MLIRCLANG_COMPILECACHE_H
+#define MLIR_TOOLS_MLIRCLANG_COMPILECACHE_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace llvm {
+class MemoryBuffer;
+class raw_ostream;
+} // namespace llvm
+
+namespace mlirclang {
+
+/// A content-addressed store of compilation results. Entries are keyed on a
+/// hash of the preprocessed inputs, the options that influence code
+/// generation and the tool build, and are evicted least-recently-used once
+/// the directory grows past its size limit.
+class CompileCache {
+public:
+  CompileCache(llvm::StringRef directory, uint64_t maxSizeInBytes);
+
+  /// Identifies the cgeist build, so that cached results of an older build
+  /// are not reused after cgeist or its passes are rebuilt. This is the clang
+  /// version along with the size and modification time of the executable.
+  static const std::string &getToolIdentity();
+
+  /// Hash the tool identity, `options` and the preprocessed `inputs`.
+  static std::string computeKey(llvm::ArrayRef<std::string> options,
+                                llvm::ArrayRef<std::string> inputs);
+
+  /// Copy the entry for `key` to `output` ("-" for stdout). Returns false and
+  /// records a miss if there is no such entry.
+  bool lookup(llvm::StringRef key, llvm::StringRef output);
+
+  /// Return the contents of the entry for `key`, or null (recording a miss)
+  /// if there is no such entry.
+  std::unique_ptr<llvm::MemoryBuffer> lookup(llvm::StringRef key);
+
+  /// Insert the file at `path` under `key` and trim the cache to its limit.
+  bool store(llvm::StringRef key, llvm::StringRef path);
+
+  /// Insert `contents` under `key` and trim the cache to its limit.
+  bool storeBuffer(llvm::StringRef key, llvm::StringRef contents);
+
+  void printStatistics(llvm::raw_ostream &os) const;
+
+private:
+  std::string getEntryPath(llvm::StringRef key) const;
+  bool createTemporaryEntry(int &FD, llvm::SmallVectorImpl<char> &path);
+  bool commitEntry(llvm::StringRef key, llvm::StringRef tmp);
+  void updateStatistics(bool hit);
+  void prune();
+
+  std::string directory;
+  uint64_t maxSizeInBytes;
+};
+
+} // namespace mlirclang
+
+#endif
@@ -0,0 +1,306 @@
+//===- CompileReport.cc - Compile-time and memory report --------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Passes nested in an adaptor run once per operation and possibly on several
+// threads at once, so their times are summed over all runs and may add up to
+// more than the wall time of the adaptor itself.
+//
+//===----------------------------------------------------------------------===//
+
+#include "CompileReport.h"
+
+#include "mlir/Pass/Pass.h"
+#include "mlir/Pass/PassInstrumentation.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <ctime>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace llvm;
+using namespace mlirclang;
+
+static double getProcessCPUSeconds() {
+  sys::TimePoint<> now;
+  std::chrono::nanoseconds user, sys;
+  sys::Process::GetTimeUsage(now, user, sys);
+  return std::chrono::duration<double>(user + sys).count();
+}
+
+static double getThreadCPUSeconds() {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+  return getProcessCPUSeconds();
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+uint64_t CompileReport::getPeakRSS() {
+#ifndef _WIN32
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage))
+    return 0;
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else
+  return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+#else
+  return 0;
+#endif
+}
+
+CompileReport::CompileReport()
+    : current(&root), wallStart(std::chrono::steady_clock::now()),
+      cpuStart(getProcessCPUSeconds()), rssStart(getPeakRSS()) {
+  root.name = "cgeist";
+}
+
+CompileReport::~CompileReport() = default;
+
+CompileReport::Node *CompileReport::getOrCreateChild(Node *parent,
+                                                     StringRef name) {
+  for (auto &child : parent->children)
+    if (child->name == name)
+      return child.get();
+  parent->children.push_back(std::make_unique<Node>());
+  parent->children.back()->name = name.str();
+  return parent->children.back().get();
+}
+
+void CompileReport::record(Node *node, double wallSeconds, double cpuSeconds,
+                           uint64_t rssStart, Optional<uint64_t> opCount) {
+  uint64_t growth = getPeakRSS() - rssStart;
+  std::lock_guard<std::mutex> lock(mutex);
+  node->wallSeconds += wallSeconds;
+  node->cpuSeconds += cpuSeconds;
+  node->peakRSSGrowth = std::max(node->peakRSSGrowth, growth);
+  node->runs++;
+  if (opCount)
+    node->opCount = opCount;
+}
+
+CompileReport::Scope::Scope(CompileReport *report, StringRef name,
+                            bool nested)
+    : report(report), nested(nested) {
+  if (!report)
+    return;
+  {
+    std::lock_guard<std::mutex> lock(report->mutex);
+    parent = report->current;
+    node = report->getOrCreateChild(parent, name);
+    if (nested)
+      report->current = node;
+  }
+  wallStart = std::chrono::steady_clock::now();
+  cpuStart = getProcessCPUSeconds();
+  rssStart = getPeakRSS();
+}
+
+void CompileReport::Scope::finish(Optional<uint64_t> opCount) {
+  if (!node)
+    return;
+  report->record(node, secondsSince(wallStart),
+                 getProcessCPUSeconds() - cpuStart, rssStart, opCount);
+  if (nested) {
+    std::lock_guard<std::mutex> lock(report->mutex);
+    report->current = parent;
+  }
+  node = nullptr;
+}
+
+namespace mlirclang {
+class CompileReport::Instrumentation : public mlir::PassInstrumentation {
+public:
+  Instrumentation(CompileReport &report, Node *stage)
+      : report(report), stage(stage) {}
+
+  void runBeforePipeline(Optional<mlir::OperationName> name,
+                         const PipelineParentInfo &parentInfo) override {
+    std::lock_guard<std::mutex> lock(mutex);
+    // Adaptors are named after the operation their pipeline runs on.
+    Node *node = passes.lookup(parentInfo.parentPass);
+    threads[get_threadid()].pipelines.push_back({node, 0});
+    if (name && node && node->name == AdaptorName) {
+      std::lock_guard<std::mutex> reportLock(report.mutex);
+      node->name = (AdaptorName + " '" + name->getStringRef() + "'").str();
+    }
+  }
+
+  void runAfterPipeline(Optional<mlir::OperationName>,
+                        const PipelineParentInfo &) override {
+    std::lock_guard<std::mutex> lock(mutex);
+    threads[get_threadid()].pipelines.pop_back();
+  }
+
+  void runBeforePass(mlir::Pass *pass, mlir::Operation *) override {
+    std::lock_guard<std::mutex> lock(mutex);
+    ThreadState &state = threads[get_threadid()];
+    // Passes of the top-level pipeline are never cloned. Nested ones are
+    // found by their position in the pipeline run by their adaptor, which
+    // is the same in every clone.
+    Node *parent = stage;
+    Node **slot;
+    if (!state.pipelines.empty() && state.pipelines.back().node) {
+      PipelineRun &run = state.pipelines.back();
+      parent = run.node;
+      slot = &nested[{parent, run.nextIndex++}];
+    } else {
+      slot = &topLevel[pass];
+    }
+    if (!*slot) {
+      StringRef name = pass->getArgument();
+      if (name.empty())
+        name = AdaptorName;
+      // Every pass gets its own entry, even if the same pass appears several
+      // times in the pipeline.
+      std::lock_guard<std::mutex> reportLock(report.mutex);
+      parent->children.push_back(std::make_unique<Node>());
+      *slot = parent->children.back().get();
+      (*slot)->name = name.str();
+    }
+    passes[pass] = *slot;
+    state.running.push_back({std::chrono::steady_clock::now(),
+                             getThreadCPUSeconds(), getPeakRSS()});
+  }
+
+  void runAfterPass(mlir::Pass *pass, mlir::Operation *) override {
+    finishPass(pass);
+  }
+
+  void runAfterPassFailed(mlir::Pass *pass, mlir::Operation *) override {
+    finishPass(pass);
+  }
+
+private:
+  static constexpr StringLiteral AdaptorName = "pipeline";
+
+  struct Running {
+    std::chrono::steady_clock::time_point wallStart;
+    double cpuStart;
+    uint64_t rssStart;
+  };
+  struct PipelineRun {
+    Node *node;
+    unsigned nextIndex;
+  };
+  struct ThreadState {
+    SmallVector<PipelineRun, 2> pipelines;
+    SmallVector<Running, 4> running;
+  };
+
+  void finishPass(mlir::Pass *pass) {
+    double cpuEnd = getThreadCPUSeconds();
+    Node *node;
+    Running start;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      start = threads[get_threadid()].running.pop_back_val();
+      node = passes.lookup(pass);
+    }
+    report.record(node, secondsSince(start.wallStart), cpuEnd - start.cpuStart,
+                  start.rssStart, None);
+  }
+
+  CompileReport &report;
+  Node *stage;
+  std::mutex mutex;
+  DenseMap<uint64_t, ThreadState> threads;
+  /// The entry of every pass instance seen, including per-thread clones.
+  DenseMap<mlir::Pass *, Node *> passes;
+  DenseMap<mlir::Pass *, Node *> topLevel;
+  DenseMap<std::pair<Node *, unsigned>, Node *> nested;
+};
+} // namespace mlirclang
+
+std::unique_ptr<mlir::PassInstrumentation>
+CompileReport::createPassInstrumentation() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return std::make_unique<Instrumentation>(*this, current);
+}
+
+static void printNode(raw_ostream &os, const CompileReport::Node &node,
+                      unsigned depth) {
+  os << format("%10.4f  %10.4f  %15.1f  ", node.wallSeconds, node.cpuSeconds,
+               node.peakRSSGrowth / (1024.0 * 1024.0));
+  if (node.opCount)
+    os << format("%10llu", (unsigned long long)*node.opCount);
+  else
+    os << format("%10s", "-");
+  os << "  ";
+  os.indent(2 * depth) << node.name;
+  if (node.runs > 1)
+    os << " (" << node.runs << " runs)";
+  os << "\n";
+  for (auto &child : node.children)
+    printNode(os, *child, depth + 1);
+}
+
+static void printNodeJSON(json::OStream &J, const CompileReport::Node &node,
+                          Optional<uint64_t> processPeakRSS = None) {
+  J.object([&] {
+    J.attribute("name", node.name);
+    J.attribute("wall_seconds", node.wallSeconds);
+    J.attribute("cpu_seconds", node.cpuSeconds);
+    J.attribute("peak_rss_growth_bytes", (int64_t)node.peakRSSGrowth);
+    if (processPeakRSS)
+      J.attribute("process_peak_rss_bytes", (int64_t)*processPeakRSS);
+    if (node.opCount)
+      J.attribute("ops", (int64_t)*node.opCount);
+    J.attribute("runs", (int64_t)node.runs);
+    J.attributeArray("children", [&] {
+      for (auto &child : node.children)
+        printNodeJSON(J, *child);
+    });
+  });
+}
+
+void CompileReport::finishRoot() {
+  root.wallSeconds = secondsSince(wallStart);
+  root.cpuSeconds = getProcessCPUSeconds() - cpuStart;
+  root.peakRSSGrowth = getPeakRSS() - rssStart;
+  root.runs = 1;
+}
+
+void CompileReport::print(raw_ostream &os) {
+  std::lock_guard<std::mutex> lock(mutex);
+  finishRoot();
+  os << "===" << std::string(73, '-') << "===\n";
+  os.indent(27) << "cgeist compile-time report\n";
+  os << "===" << std::string(73, '-') << "===\n";
+  os << "  Wall (s)     CPU (s)  +Peak RSS (MiB)         Ops  Name\n";
+  printNode(os, root, 0);
+  os << format("Process peak RSS: %.1f MiB\n",
+               getPeakRSS() / (1024.0 * 1024.0));
+  os.flush();
+}
+
+void CompileReport::printJSON(raw_ostream &os) {
+  std::lock_guard<std::mutex> lock(mutex);
+  finishRoot();
+  json::OStream J(os, 2);
+  printNodeJSON(J, root, getPeakRSS());
+  os << "\n";
+  os.flush();
+}
@@ -0,0 +1,106 @@
+//===- CompileReport.h - Compile-time and memory report ---------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MLIR_TOOLS_MLIRCLANG_COMPILEREPORT_H
+#define MLIR_TOOLS_MLIRCLANG_COMPILEREPORT_H
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+} // namespace llvm
+
+namespace mlir {
+class PassInstrumentation;
+} // namespace mlir
+
+namespace mlirclang {
+
+/// A hierarchical report of wall time, CPU time, peak RSS growth and IR size
+/// for the stages of a compilation and the passes run within them.
+class CompileReport {
+public:
+  struct Node {
+    std::string name;
+    double wallSeconds = 0;
+    double cpuSeconds = 0;
+    /// How much the peak RSS of the process grew while the stage ran, the
+    /// most over all of its runs. Work running concurrently on other threads
+    /// contributes to it too.
+    uint64_t peakRSSGrowth = 0;
+    llvm::Optional<uint64_t> opCount;
+    unsigned runs = 0;
+    std::vector<std::unique_ptr<Node>> children;
+  };
+
+  /// Times a stage from construction until finish() or destruction. Stages
+  /// are children of the innermost nested stage open at construction. Only
+  /// the main thread may open nested stages; other threads accumulate into
+  /// a stage without becoming the parent of later ones. CPU time is that of
+  /// the whole process. A null report makes this a no-op.
+  class Scope {
+  public:
+    Scope(CompileReport *report, llvm::StringRef name, bool nested = true);
+    ~Scope() { finish(); }
+
+    /// Stop timing and record the size of the IR the stage produced.
+    void finish(llvm::Optional<uint64_t> opCount = llvm::None);
+
+  private:
+    CompileReport *report;
+    Node *node = nullptr;
+    Node *parent = nullptr;
+    bool nested;
+    std::chrono::steady_clock::time_point wallStart;
+    double cpuStart = 0;
+    uint64_t rssStart = 0;
+  };
+
+  CompileReport();
+  ~CompileReport();
+
+  /// Instrumentation that reports every pass of a PassManager as a child of
+  /// the innermost open stage, nested under the pass adaptor that runs it.
+  /// Passes are identified by their position in the pipeline, so the clones
+  /// of a nested pipeline made for each thread share their entries. CPU time
+  /// of a pass is that of the thread running it.
+  std::unique_ptr<mlir::PassInstrumentation> createPassInstrumentation();
+
+  void print(llvm::raw_ostream &os);
+  void printJSON(llvm::raw_ostream &os);
+
+  /// Current peak resident set size of the process in bytes.
+  static uint64_t getPeakRSS();
+
+private:
+  friend class Scope;
+  class Instrumentation;
+
+  Node *getOrCreateChild(Node *parent, llvm::StringRef name);
+  void record(Node *node, double wallSeconds, double cpuSeconds,
+              uint64_t rssStart, llvm::Optional<uint64_t> opCount);
+  void finishRoot();
+
+  Node root;
+  Node *current;
+  std::chrono::steady_clock::time_point wallStart;
+  double cpuStart;
+  uint64_t rssStart;
+  std::mutex mutex;
+};
+
+} // namespace mlirclang
+
+#endif
@@ -0,0 +1,302 @@
+//===- CompileServer.cc - Persistent cgeist compile server ------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// A request is a single byte carrying the client's stdin, stdout and stderr
+// as SCM_RIGHTS, followed by a magic number and the length-prefixed argv,
+// environment and working directory. The reply is the 32-bit exit status of
+// the compilation.
+//
+//===----------------------------------------------------------------------===//
+
+#include "CompileServer.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+#endif
+
+using namespace llvm;
+using namespace mlirclang;
+
+#ifndef _WIN32
+static constexpr uint32_t RequestMagic = 0x43475331; // "CGS1"
+
+static bool writeAll(int FD, const void *data, size_t size) {
+  const char *ptr = static_cast<const char *>(data);
+  while (size) {
+    ssize_t n = ::write(FD, ptr, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    ptr += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool readAll(int FD, void *data, size_t size) {
+  char *ptr = static_cast<char *>(data);
+  while (size) {
+    ssize_t n = ::read(FD, ptr, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    ptr += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool writeU32(int FD, uint32_t value) {
+  return writeAll(FD, &value, sizeof(value));
+}
+
+static bool readU32(int FD, uint32_t &value) {
+  return readAll(FD, &value, sizeof(value));
+}
+
+static bool writeStrings(int FD, ArrayRef<StringRef> strings) {
+  if (!writeU32(FD, strings.size()))
+    return false;
+  for (StringRef str : strings)
+    if (!writeU32(FD, str.size()) || !writeAll(FD, str.data(), str.size()))
+      return false;
+  return true;
+}
+
+static bool readStrings(int FD, std::vector<std::string> &strings) {
+  uint32_t count;
+  if (!readU32(FD, count))
+    return false;
+  strings.resize(count);
+  for (auto &str : strings) {
+    uint32_t size;
+    if (!readU32(FD, size))
+      return false;
+    str.resize(size);
+    if (size && !readAll(FD, &str[0], size))
+      return false;
+  }
+  return true;
+}
+
+static bool getSocketAddress(StringRef socketPath, sockaddr_un &addr) {
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(addr.sun_path))
+    return false;
+  memcpy(addr.sun_path, socketPath.data(), socketPath.size());
+  return true;
+}
+
+static void replaceEnvironment(std::vector<std::string> &env) {
+  std::vector<std::string> names;
+  for (char **var = environ; *var; var++)
+    names.push_back(StringRef(*var).split('=').first.str());
+  for (auto &name : names)
+    unsetenv(name.c_str());
+  for (auto &var : env)
+    putenv(&var[0]);
+}
+
+/// Runs in the process forked for a connection. The compilation itself runs
+/// in a further child so that its exit status, including crashes and calls to
+/// exit(), can be relayed to the client.
+static int serveRequest(int connFD,
+                        function_ref<int(int, char **)> compile) {
+  char byte;
+  int fds[3];
+  iovec iov = {&byte, 1};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))];
+  msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  if (recvmsg(connFD, &msg, 0) != 1)
+    return 1;
+  cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (!cmsg || cmsg->cmsg_level != SOL_SOCKET ||
+      cmsg->cmsg_type != SCM_RIGHTS ||
+      cmsg->cmsg_len != CMSG_LEN(sizeof(fds)))
+    return 1;
+  memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+  uint32_t magic;
+  std::vector<std::string> args, env, cwd;
+  if (!readU32(connFD, magic) || magic != RequestMagic ||
+      !readStrings(connFD, args) || !readStrings(connFD, env) ||
+      !readStrings(connFD, cwd) || args.empty() || cwd.size() != 1)
+    return 1;
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(connFD);
+    for (int i = 0; i < 3; i++) {
+      dup2(fds[i], i);
+      close(fds[i]);
+    }
+    if (chdir(cwd[0].c_str()) != 0) {
+      errs() << "error: cannot change to directory '" << cwd[0]
+             << "': " << strerror(errno) << "\n";
+      exit(1);
+    }
+    replaceEnvironment(env);
+
+    std::vector<char *> argv;
+    for (auto &arg : args)
+      argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+    exit(compile(args.size(), argv.data()));
+  }
+  for (int fd : fds)
+    close(fd);
+
+  int status;
+  uint32_t res = 1;
+  if (pid > 0 && waitpid(pid, &status, 0) == pid)
+    res = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+  // The log is written before replying, so it is complete once the client
+  // has returned.
+  errs() << "served";
+  for (auto &arg : args)
+    errs() << " " << arg;
+  errs() << ": exit status " << res << "\n";
+  writeU32(connFD, res);
+  return 0;
+}
+
+int mlirclang::runCompileServer(StringRef socketPath,
+                                function_ref<int(int, char **)> compile) {
+  sockaddr_un addr;
+  if (!getSocketAddress(socketPath, addr)) {
+    errs() << "error: socket path too long: " << socketPath << "\n";
+    return 1;
+  }
+  int listenFD = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenFD < 0) {
+    errs() << "error: cannot create socket: " << strerror(errno) << "\n";
+    return 1;
+  }
+  // A server that went away leaves its socket behind.
+  sys::fs::remove(socketPath);
+  if (bind(listenFD, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) ||
+      listen(listenFD, SOMAXCONN)) {
+    errs() << "error: cannot listen on " << socketPath << ": "
+           << strerror(errno) << "\n";
+    close(listenFD);
+    return 1;
+  }
+
+  // Children are never waited for; let the kernel reap them.
+  signal(SIGCHLD, SIG_IGN);
+  while (true) {
+    int connFD = accept(listenFD, nullptr, nullptr);
+    if (connFD < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      errs() << "error: accept failed: " << strerror(errno) << "\n";
+      close(listenFD);
+      return 1;
+    }
+    outs().flush();
+    errs().flush();
+    fflush(nullptr);
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(listenFD);
+      // Connection handlers and compilations wait for their own children.
+      signal(SIGCHLD, SIG_DFL);
+      _exit(serveRequest(connFD, compile));
+    }
+    if (pid < 0)
+      errs() << "error: fork failed: " << strerror(errno) << "\n";
+    close(connFD);
+  }
+}
+
+Optional<int> mlirclang::forwardToCompileServer(StringRef socketPath,
+                                                int argc, char **argv) {
+  sockaddr_un addr;
+  if (!getSocketAddress(socketPath, addr))
+    return None;
+  int FD = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (FD < 0)
+    return None;
+  if (connect(FD, reinterpret_cast<sockaddr *>(&addr), sizeof(addr))) {
+    close(FD);
+    return None;
+  }
+
+  char byte = 0;
+  int fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+  iovec iov = {&byte, 1};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))];
+  msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+  std::vector<StringRef> args(argv, argv + argc), env;
+  for (char **var = environ; *var; var++)
+    env.push_back(*var);
+  SmallString<128> cwd;
+  if (sendmsg(FD, &msg, 0) != 1 || sys::fs::current_path(cwd)) {
+    close(FD);
+    return None;
+  }
+  // Once the request is accepted the server owns the compilation, so
+  // failures past this point are reported rather than retried locally.
+  uint32_t res;
+  if (!writeU32(FD, RequestMagic) || !writeStrings(FD, args) ||
+      !writeStrings(FD, env) || !writeStrings(FD, StringRef(cwd)) ||
+      !readU32(FD, res)) {
+    errs() << "error: compile server at " << socketPath
+           << " did not complete the request\n";
+    close(FD);
+    return 1;
+  }
+  close(FD);
+  return (int)res;
+}
+#else
+int mlirclang::runCompileServer(StringRef socketPath,
+                                function_ref<int(int, char **)> compile) {
+  errs() << "error: the compile server is not supported on this platform\n";
+  return 1;
+}
+
+Optional<int> mlirclang::forwardToCompileServer(StringRef socketPath,
+                                                int argc, char **argv) {
+  return None;
+}
+#endif
@@ -0,0 +1,34 @@
+//===- CompileServer.h - Persistent cgeist compile server -------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MLIR_TOOLS_MLIRCLANG_COMPILESERVER_H
+#define MLIR_TOOLS_MLIRCLANG_COMPILESERVER_H
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace mlirclang {
+
+/// Accept compile requests on the Unix socket at `socketPath` until killed.
+/// Every request is served by a child forked from the warm server process,
+/// which runs `compile` on the client's arguments with the client's working
+/// directory, environment and standard streams. Each request is logged with
+/// its exit status to the server's stderr. Returns non-zero if the socket
+/// cannot be set up.
+int runCompileServer(llvm::StringRef socketPath,
+                     llvm::function_ref<int(int, char **)> compile);
+
+/// Forward this invocation to the server listening on `socketPath` and
+/// return its exit code, or None if no server is reachable.
+llvm::Optional<int> forwardToCompileServer(llvm::StringRef socketPath,
+                                           int argc, char **argv);
+
+} // namespace mlirclang
+
+#endif
@@ -0,0 +1,205 @@
+//===- FunctionCache.cc - Per-function lowering cache keys ------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "FunctionCache.h"
+
+#include "CompileCache.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Lex/Lexer.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/SHA256.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace clang;
+using namespace mlirclang;
+
+/// Bump whenever the layout of cached functions changes.
+static constexpr unsigned FunctionCacheFormatVersion = 1;
+
+namespace {
+/// Hashes everything the lowering of a function body depends on.
+class FunctionKeyBuilder : public RecursiveASTVisitor<FunctionKeyBuilder> {
+public:
+  FunctionKeyBuilder(const SourceManager &SM, const PrintingPolicy &policy,
+                     SmallVectorImpl<const FunctionDecl *> &callees)
+      : SM(SM), policy(policy), callees(callees) {}
+
+  void add(StringRef field) {
+    hasher.update(std::to_string(field.size()));
+    hasher.update(":");
+    hasher.update(field);
+  }
+
+  void addDecl(const Decl *D) {
+    std::string str;
+    llvm::raw_string_ostream os(str);
+    D->print(os, policy);
+    add(os.str());
+  }
+
+  /// Hash `T` along with the definitions of all records reachable from it,
+  /// since those determine the layout the lowering relies on.
+  void addType(QualType T) {
+    if (T.isNull())
+      return;
+    T = T.getCanonicalType();
+    add(T.getAsString(policy));
+    SmallVector<const Type *, 4> worklist = {T.getTypePtr()};
+    while (!worklist.empty()) {
+      const Type *ty = worklist.pop_back_val();
+      if (!seenTypes.insert(ty).second)
+        continue;
+      auto push = [&](QualType sub) {
+        worklist.push_back(sub.getCanonicalType().getTypePtr());
+      };
+      if (auto *PT = ty->getAs<PointerType>())
+        push(PT->getPointeeType());
+      else if (auto *AT = ty->getAsArrayTypeUnsafe())
+        push(AT->getElementType());
+      else if (auto *VT = ty->getAs<VectorType>())
+        push(VT->getElementType());
+      else if (auto *FT = ty->getAs<FunctionProtoType>()) {
+        push(FT->getReturnType());
+        for (QualType param : FT->getParamTypes())
+          push(param);
+      } else if (auto *ET = ty->getAs<EnumType>()) {
+        if (auto *def = ET->getDecl()->getDefinition())
+          addDecl(def);
+      } else if (auto *RT = ty->getAs<RecordType>()) {
+        if (auto *def = RT->getDecl()->getDefinition()) {
+          addDecl(def);
+          for (auto *field : def->fields())
+            push(field->getType());
+        }
+      }
+    }
+  }
+
+  /// Locations produced by macros are spelled outside of the function, so
+  /// they have to be part of the key.
+  void addLocation(SourceLocation loc) {
+    if (!loc.isMacroID())
+      return;
+    SourceLocation spelling = SM.getSpellingLoc(loc);
+    add(SM.getFilename(spelling));
+    add(std::to_string(SM.getSpellingLineNumber(spelling)));
+    add(std::to_string(SM.getSpellingColumnNumber(spelling)));
+  }
+
+  bool VisitStmt(Stmt *S) {
+    addLocation(S->getBeginLoc());
+    return true;
+  }
+
+  bool VisitExpr(Expr *E) {
+    addType(E->getType());
+    return true;
+  }
+
+  bool VisitUnaryExprOrTypeTraitExpr(UnaryExprOrTypeTraitExpr *E) {
+    if (E->isArgumentType())
+      addType(E->getArgumentType());
+    return true;
+  }
+
+  bool VisitValueDecl(ValueDecl *D) {
+    addLocation(D->getLocation());
+    addType(D->getType());
+    return true;
+  }
+
+  bool VisitDeclRefExpr(DeclRefExpr *E) {
+    const ValueDecl *D = E->getDecl();
+    if (auto *ECD = dyn_cast<EnumConstantDecl>(D)) {
+      add(ECD->getName());
+      add(llvm::toString(ECD->getInitVal(), 10));
+    } else if (auto *FD = dyn_cast<FunctionDecl>(D)) {
+      if (!seenDecls.insert(FD->getCanonicalDecl()).second)
+        return true;
+      callees.push_back(FD);
+      // Only the signature of a callee matters to its callers.
+      add(FD->getQualifiedNameAsString());
+      addType(FD->getType());
+      add(std::to_string((int)FD->getStorageClass()));
+      add(std::to_string(FD->isInlined()));
+      add(std::to_string(FD->isDefined()));
+    } else if (auto *VD = dyn_cast<VarDecl>(D)) {
+      if (!VD->hasGlobalStorage() || VD->isStaticLocal())
+        return true;
+      if (!seenDecls.insert(VD->getCanonicalDecl()).second)
+        return true;
+      // Globals are lowered together with their initializers, which may in
+      // turn refer to functions and other globals.
+      for (auto *redecl : VD->redecls()) {
+        addDecl(redecl);
+        if (auto *init = redecl->getInit())
+          TraverseStmt(const_cast<Expr *>(init));
+      }
+    }
+    return true;
+  }
+
+  std::string finish() {
+    return llvm::toHex(hasher.final(), /*LowerCase*/ true);
+  }
+
+private:
+  const SourceManager &SM;
+  const PrintingPolicy &policy;
+  SmallVectorImpl<const FunctionDecl *> &callees;
+  llvm::SHA256 hasher;
+  llvm::SmallPtrSet<const Type *, 16> seenTypes;
+  llvm::SmallPtrSet<const Decl *, 16> seenDecls;
+};
+} // namespace
+
+llvm::Optional<std::string> mlirclang::computeFunctionCacheKey(
+    const FunctionDecl *FD, const SourceManager &SM, StringRef context,
+    SmallVectorImpl<const FunctionDecl *> &callees,
+    FunctionCacheLocation &location) {
+  const ASTContext &astContext = FD->getASTContext();
+  const LangOptions &langOpts = astContext.getLangOpts();
+  // C++ lowering emits implicit calls (constructors, destructors, operators)
+  // that do not show up as references in the body.
+  if (langOpts.CPlusPlus || langOpts.CUDA || langOpts.ObjC)
+    return llvm::None;
+
+  const FunctionDecl *def = nullptr;
+  if (!FD->hasBody(def) || !def->getBody())
+    return llvm::None;
+  SourceRange range = def->getSourceRange();
+  if (range.getBegin().isMacroID() || range.getEnd().isMacroID())
+    return llvm::None;
+
+  bool invalid = false;
+  StringRef text = Lexer::getSourceText(CharSourceRange::getTokenRange(range),
+                                        SM, langOpts, &invalid);
+  if (invalid || text.empty())
+    return llvm::None;
+
+  location.filename = SM.getFilename(range.getBegin()).str();
+  location.beginLine = SM.getSpellingLineNumber(range.getBegin());
+  location.endLine = SM.getSpellingLineNumber(range.getEnd());
+
+  PrintingPolicy policy(langOpts);
+  FunctionKeyBuilder builder(SM, policy, callees);
+  builder.add("cgeist-function-cache-v" +
+              std::to_string(FunctionCacheFormatVersion));
+  builder.add(CompileCache::getToolIdentity());
+  builder.add(context);
+  builder.add(location.filename);
+  builder.add(std::to_string(SM.getSpellingColumnNumber(range.getBegin())));
+  builder.add(text);
+  builder.addDecl(def);
+  builder.TraverseDecl(const_cast<FunctionDecl *>(def));
+  return builder.finish();
+}
@@ -0,0 +1,48 @@
+//===- FunctionCache.h - Per-function lowering cache keys -------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MLIR_TOOLS_MLIRCLANG_FUNCTIONCACHE_H
+#define MLIR_TOOLS_MLIRCLANG_FUNCTIONCACHE_H
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <string>
+
+namespace clang {
+class FunctionDecl;
+class SourceManager;
+} // namespace clang
+
+namespace mlirclang {
+
+/// Where a cached function was defined. Locations inside [beginLine, endLine]
+/// of `filename` are shifted when the function moves within its file.
+struct FunctionCacheLocation {
+  std::string filename;
+  unsigned beginLine = 0;
+  unsigned endLine = 0;
+};
+
+/// Compute the key under which the lowering of `FD` is cached. The key
+/// covers the source text and AST of the body, the layout of every type it
+/// uses, and the declarations and initializers of every function and global
+/// it references, but not the line on which the function starts. Functions
+/// referenced from the body (directly or through global initializers) are
+/// appended to `callees`. Returns None if the lowering of `FD` cannot be
+/// cached.
+llvm::Optional<std::string> computeFunctionCacheKey(
+    const clang::FunctionDecl *FD, const clang::SourceManager &SM,
+    llvm::StringRef context,
+    llvm::SmallVectorImpl<const clang::FunctionDecl *> &callees,
+    FunctionCacheLocation &location);
+
+} // namespace mlirclang
+
+#endif
@@ -0,0 +1,205 @@
+//===- LocalAnalysis.cc - Locals and early exits --------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "LocalAnalysis.h"
+
+#include "clang/AST/Decl.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/Stmt.h"
+#include "clang/AST/StmtCXX.h"
+#include "clang/AST/StmtOpenMP.h"
+
+using namespace clang;
+
+/// Whether `VD` has a type and initialization that an SSA value can hold.
+static bool isSSACandidate(const VarDecl *VD) {
+  QualType T = VD->getType();
+  if (T.isVolatileQualified() || VD->hasAttrs())
+    return false;
+  if (!T->isIntegerType() && !T->isRealFloatingType() && !T->isPointerType())
+    return false;
+  if (isa<ParmVarDecl>(VD))
+    return true;
+  if (!VD->hasLocalStorage() || VD->isExceptionVariable())
+    return false;
+  const Expr *init = VD->getInit();
+  return init && !isa<InitListExpr, CXXConstructExpr>(init);
+}
+
+/// The variable that `S` assigns, increments or decrements directly, if any.
+static const VarDecl *getAssignedVar(const Stmt *S) {
+  const Expr *target = nullptr;
+  if (auto *BO = dyn_cast<BinaryOperator>(S)) {
+    if (BO->isAssignmentOp())
+      target = BO->getLHS();
+  } else if (auto *UO = dyn_cast<UnaryOperator>(S)) {
+    if (UO->isIncrementDecrementOp())
+      target = UO->getSubExpr();
+  }
+  auto *DRE = dyn_cast_or_null<DeclRefExpr>(target);
+  return DRE ? dyn_cast<VarDecl>(DRE->getDecl()) : nullptr;
+}
+
+namespace {
+/// Records the variables declared in a function body and those used other
+/// than by loading their value or by a statement reassigning them that code
+/// generation can turn into rebinding an SSA value.
+struct LocalUses {
+  llvm::function_ref<bool(const ForStmt *)> isRegionLoop;
+  llvm::SmallPtrSetImpl<const VarDecl *> &locals;
+  llvm::SmallPtrSet<const VarDecl *, 8> escaped;
+  bool hasJumps = false;
+
+  LocalUses(llvm::function_ref<bool(const ForStmt *)> isRegionLoop,
+            llvm::SmallPtrSetImpl<const VarDecl *> &locals)
+      : isRegionLoop(isRegionLoop), locals(locals) {}
+
+  /// Whether `child` of `S` is emitted into the same blocks as `S`, or into
+  /// the blocks of a loop without early exits.
+  /// TODO: Also yield locals reassigned in the branches of an if statement
+  /// from the scf.if it becomes.
+  bool isStructuredChild(const Stmt *S, const Stmt *child) {
+    if (isa<CompoundStmt, AttributedStmt>(S))
+      return true;
+    if (auto *For = dyn_cast<ForStmt>(S)) {
+      if (isRegionLoop(For))
+        return false;
+      if (child == For->getInit())
+        return true;
+      return (child == For->getInc() || child == For->getBody()) &&
+             !mlirclang::mayExitLoopEarly(For->getBody());
+    }
+    if (auto *While = dyn_cast<WhileStmt>(S))
+      return child == While->getBody() &&
+             !mlirclang::mayExitLoopEarly(While->getBody());
+    if (auto *Do = dyn_cast<DoStmt>(S))
+      return child == Do->getBody() &&
+             !mlirclang::mayExitLoopEarly(Do->getBody());
+    return false;
+  }
+
+  void visit(const Stmt *S, bool inSwitch, bool structured) {
+    if (!S)
+      return;
+    if (auto *ICE = dyn_cast<ImplicitCastExpr>(S))
+      if (ICE->getCastKind() == CK_LValueToRValue &&
+          isa<DeclRefExpr>(ICE->getSubExpr()))
+        return;
+    if (structured)
+      if (const VarDecl *VD = getAssignedVar(S)) {
+        QualType T = VD->getType();
+        if (T->isIntegerType() || T->isRealFloatingType()) {
+          if (auto *BO = dyn_cast<BinaryOperator>(S))
+            visit(BO->getRHS(), inSwitch, /*structured*/ false);
+          return;
+        }
+      }
+    if (auto *DRE = dyn_cast<DeclRefExpr>(S)) {
+      if (auto *VD = dyn_cast<VarDecl>(DRE->getDecl()))
+        escaped.insert(VD);
+      return;
+    }
+    if (isa<GotoStmt, IndirectGotoStmt, LabelStmt>(S))
+      hasJumps = true;
+    if (auto *DS = dyn_cast<DeclStmt>(S))
+      for (auto *D : DS->decls())
+        if (auto *VD = dyn_cast<VarDecl>(D))
+          if (!inSwitch && isSSACandidate(VD))
+            locals.insert(VD);
+    if (auto *BE = dyn_cast<BlockExpr>(S))
+      for (auto &C : BE->getBlockDecl()->captures())
+        escaped.insert(C.getVariable());
+    // Clause operands such as private or reduction variables are not
+    // children of the directive.
+    if (auto *D = dyn_cast<OMPExecutableDirective>(S))
+      for (auto *C : D->clauses())
+        for (auto *child : C->children())
+          visit(child, inSwitch, /*structured*/ false);
+    bool inNestedSwitch = inSwitch || isa<SwitchStmt>(S);
+    for (const Stmt *child : S->children())
+      visit(child, inNestedSwitch,
+            structured && isStructuredChild(S, child));
+  }
+};
+} // end anonymous namespace
+
+void mlirclang::findSSALocals(
+    const FunctionDecl *fd,
+    llvm::function_ref<bool(const ForStmt *)> isRegionLoop,
+    llvm::SmallPtrSetImpl<const VarDecl *> &locals) {
+  const Stmt *body = fd->getBody();
+  if (!body)
+    return;
+  LocalUses uses(isRegionLoop, locals);
+  for (const ParmVarDecl *parm : fd->parameters())
+    if (isSSACandidate(parm))
+      locals.insert(parm);
+  // Early returns guard the statements of the body with regions.
+  uses.visit(body, /*inSwitch*/ false, /*structured*/ !mayReturnEarly(fd));
+  if (uses.hasJumps) {
+    locals.clear();
+    return;
+  }
+  for (const VarDecl *VD : uses.escaped)
+    locals.erase(VD);
+}
+
+void mlirclang::collectAssignedLocals(
+    const Stmt *S, llvm::SmallVectorImpl<const VarDecl *> &assigned) {
+  if (!S)
+    return;
+  if (const VarDecl *VD = getAssignedVar(S))
+    if (!llvm::is_contained(assigned, VD))
+      assigned.push_back(VD);
+  for (const Stmt *child : S->children())
+    collectAssignedLocals(child, assigned);
+}
+
+/// Whether executing `S` may transfer control out of the innermost loop
+/// around it, where `breakLeaves` and `continueLeaves` tell whether a break
+/// or continue at this nesting level targets that loop.
+static bool mayLeave(const Stmt *S, bool breakLeaves, bool continueLeaves) {
+  if (!S)
+    return false;
+  if (isa<ReturnStmt, GotoStmt, IndirectGotoStmt, LabelStmt>(S))
+    return true;
+  if (isa<BreakStmt>(S))
+    return breakLeaves;
+  if (isa<ContinueStmt>(S))
+    return continueLeaves;
+  // Bodies of lambdas, blocks and OpenMP regions cannot branch out of them.
+  if (isa<LambdaExpr, BlockExpr, OMPExecutableDirective>(S))
+    return false;
+  if (isa<ForStmt, WhileStmt, DoStmt, CXXForRangeStmt>(S))
+    breakLeaves = continueLeaves = false;
+  else if (isa<SwitchStmt>(S))
+    breakLeaves = false;
+  for (const Stmt *child : S->children())
+    if (mayLeave(child, breakLeaves, continueLeaves))
+      return true;
+  return false;
+}
+
+bool mlirclang::mayExitLoopEarly(const Stmt *body) {
+  return mayLeave(body, /*breakLeaves*/ true, /*continueLeaves*/ true);
+}
+
+bool mlirclang::mayReturnEarly(const FunctionDecl *fd) {
+  const Stmt *body = fd->getBody();
+  auto *CS = dyn_cast_or_null<CompoundStmt>(body);
+  if (!CS)
+    return body != nullptr;
+  for (const Stmt *S : CS->body()) {
+    if (S == CS->body_back() && isa<ReturnStmt>(S))
+      break;
+    if (mayLeave(S, /*breakLeaves*/ false, /*continueLeaves*/ false))
+      return true;
+  }
+  return false;
+}
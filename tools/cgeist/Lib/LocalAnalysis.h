@@ -0,0 +1,58 @@
+//===- LocalAnalysis.h - Locals and early exits -----------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MLIR_TOOLS_MLIRCLANG_LOCALANALYSIS_H
+#define MLIR_TOOLS_MLIRCLANG_LOCALANALYSIS_H
+
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+
+namespace clang {
+class ForStmt;
+class FunctionDecl;
+class Stmt;
+class VarDecl;
+} // namespace clang
+
+namespace mlirclang {
+
+/// Collect the parameters and local variables of `fd` that can be bound
+/// directly to an SSA value instead of a stack slot: scalars whose address is
+/// never taken, whether explicitly, by reference binding or by a by-reference
+/// capture, and that are only ever read after their initialization.
+/// Arithmetic locals may also be reassigned by whole statements that are
+/// emitted into the function's CFG, i.e. not nested in an if, switch or
+/// expression, nor in a loop that needs flags for early exits or that
+/// `isRegionLoop` says is emitted as a region. Loops then carry them as
+/// block arguments. Locals declared in a switch body and all variables of
+/// functions that use goto are excluded, since a jump may skip their
+/// definition.
+void findSSALocals(
+    const clang::FunctionDecl *fd,
+    llvm::function_ref<bool(const clang::ForStmt *)> isRegionLoop,
+    llvm::SmallPtrSetImpl<const clang::VarDecl *> &locals);
+
+/// Append the variables that `S` assigns or increments to `assigned`, each
+/// once and in the order of their first assignment.
+void collectAssignedLocals(
+    const clang::Stmt *S,
+    llvm::SmallVectorImpl<const clang::VarDecl *> &assigned);
+
+/// Whether control may leave the loop with body `body` other than by
+/// failing the loop condition, i.e. through a break or continue of that
+/// loop, a return or a goto. Loops for which this is false need no flags to
+/// track early exits.
+bool mayExitLoopEarly(const clang::Stmt *body);
+
+/// Whether the body of `fd` may return before reaching its last statement.
+bool mayReturnEarly(const clang::FunctionDecl *fd);
+
+} // namespace mlirclang
+
+#endif
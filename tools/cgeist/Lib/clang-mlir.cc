@@ -7,10 +7,16 @@
 //===----------------------------------------------------------------------===//
 
 #include "clang-mlir.h"
+#include "CompileCache.h"
+#include "CompileReport.h"
 #include "TypeUtils.h"
+#include "mlir/Bytecode/BytecodeWriter.h"
 #include "mlir/Dialect/Arith/IR/Arith.h"
 #include "mlir/Dialect/DLTI/DLTI.h"
 #include "mlir/Dialect/SCF/IR/SCF.h"
+#include "mlir/IR/Diagnostics.h"
+#include "mlir/IR/FunctionInterfaces.h"
+#include "mlir/Parser/Parser.h"
 #include "mlir/Target/LLVMIR/Import.h"
 #include "utils.h"
 #include "clang/AST/Attr.h"
@@ -35,8 +41,11 @@
 #include "clang/Parse/Parser.h"
 #include "clang/Sema/Sema.h"
 #include "clang/Sema/SemaDiagnostic.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetOptions.h"
 
 using namespace std;
 using namespace clang;
@@ -60,9 +69,29 @@ static cl::opt<bool> memRefABI("memref-abi", cl::init(true),
 cl::opt<std::string> PrefixABI("prefix-abi", cl::init(""),
                                cl::desc("Prefix for emitted symbols"));
 
+/// Cache of lowered function bodies, set up by the driver when
+/// -function-cache is given. The context holds the options the lowering
+/// depends on.
+static std::unique_ptr<CompileCache> FunctionLoweringCache;
+static std::string FunctionLoweringCacheContext;
+
+/// Compile-time report of the current compilation, set up by the driver when
+/// -ftime-report or -ftime-report-json is given.
+static CompileReport *CompileTimeReport = nullptr;
+
 cl::opt<bool> CStyleMemRef("c-style-memref", cl::init(true),
                            cl::desc("Use c style memrefs when possible"));
 
+cl::opt<bool> DirectSSA(
+    "direct-ssa", cl::init(true),
+    cl::desc("Bind scalar locals whose address is never taken to SSA values "
+             "and only track early exits of loops that have them"));
+
+static cl::opt<unsigned> BulkInitThreshold(
+    "bulk-init-threshold", cl::init(16),
+    cl::desc("Initialize local arrays of at least this many elements with a "
+             "memset or a copy from a constant table"));
+
 static cl::opt<bool>
     CombinedStructABI("struct-abi", cl::init(true),
                       cl::desc("Use literal LLVM ABI for structs"));
@@ -117,6 +146,15 @@ void MLIRScanner::init(mlir::func::FuncOp function, const FunctionDecl *fd) {
 
   setEntryAndAllocBlock(function.addEntryBlock());
 
+  ssaLocals.clear();
+  if (DirectSSA)
+    findSSALocals(
+        fd,
+        [&](const clang::ForStmt *fors) {
+          return Glob.scopLocList.isInScop(fors->getForLoc());
+        },
+        ssaLocals);
+
   unsigned i = 0;
   if (auto CM = dyn_cast<CXXMethodDecl>(fd)) {
     if (CM->getParent()->isLambda()) {
@@ -159,6 +197,8 @@ void MLIRScanner::init(mlir::func::FuncOp function, const FunctionDecl *fd) {
     assert(val);
     if (isArray) {
       params.emplace(parm, ValueCategory(val, /*isReference*/ true));
+    } else if (ssaLocals.count(parm)) {
+      params.emplace(parm, ValueCategory(val, /*isReference*/ false));
     } else {
       auto alloc = createAllocOp(val.getType(), parm, /*memspace*/ 0, isArray,
                                  /*LLVMABI*/ LLVMABI);
@@ -272,13 +312,19 @@ void MLIRScanner::init(mlir::func::FuncOp function, const FunctionDecl *fd) {
     llvm::errs() << " warning, destructor not fully handled yet\n";
   }
 
-  auto i1Ty = builder.getIntegerType(1);
-  auto type = mlir::MemRefType::get({}, i1Ty, {}, 0);
-  auto truev = builder.create<ConstantIntOp>(loc, true, 1);
-  loops.push_back({builder.create<mlir::memref::AllocaOp>(loc, type),
-                   builder.create<mlir::memref::AllocaOp>(loc, type)});
-  builder.create<mlir::memref::StoreOp>(loc, truev, loops.back().noBreak);
-  builder.create<mlir::memref::StoreOp>(loc, truev, loops.back().keepRunning);
+  // Without early returns, no statement of the body needs to be guarded.
+  if (DirectSSA && !mayReturnEarly(fd)) {
+    loops.push_back({});
+  } else {
+    auto i1Ty = builder.getIntegerType(1);
+    auto type = mlir::MemRefType::get({}, i1Ty, {}, 0);
+    auto truev = builder.create<ConstantIntOp>(loc, true, 1);
+    loops.push_back({builder.create<mlir::memref::AllocaOp>(loc, type),
+                     builder.create<mlir::memref::AllocaOp>(loc, type)});
+    builder.create<mlir::memref::StoreOp>(loc, truev, loops.back().noBreak);
+    builder.create<mlir::memref::StoreOp>(loc, truev,
+                                          loops.back().keepRunning);
+  }
   if (function.getFunctionType().getResults().size()) {
     auto type = mlir::MemRefType::get(
         {}, function.getFunctionType().getResult(0), {}, 0);
@@ -645,6 +691,130 @@ MLIRScanner::VisitImplicitValueInitExpr(clang::ImplicitValueInitExpr *decl) {
   assert(0 && "bad");
 }
 
+/// Append the elements of the array of shape `shape` initialized by `expr`
+/// to `elements` in row-major order. Fails if one of them is not a constant.
+static bool getConstantElements(ASTContext &ctx, Expr *expr,
+                                ArrayRef<int64_t> shape, mlir::Type elTy,
+                                SmallVectorImpl<mlir::Attribute> &elements) {
+  if (isa<ImplicitValueInitExpr>(expr)) {
+    int64_t num = 1;
+    for (int64_t n : shape)
+      num *= n;
+    mlir::Attribute zero;
+    if (auto FT = elTy.dyn_cast<mlir::FloatType>())
+      zero = FloatAttr::get(FT, 0.0);
+    else
+      zero = IntegerAttr::get(elTy, 0);
+    elements.append(num, zero);
+    return true;
+  }
+  auto initListExpr = dyn_cast<InitListExpr>(expr);
+  if (!shape.empty()) {
+    if (!initListExpr || initListExpr->isStringLiteralInit())
+      return false;
+    for (unsigned i = 0, e = shape[0]; i < e; i++) {
+      Expr *elt = i < initListExpr->getNumInits()
+                      ? initListExpr->getInit(i)
+                      : initListExpr->getArrayFiller();
+      if (!elt ||
+          !getConstantElements(ctx, elt, shape.drop_front(), elTy, elements))
+        return false;
+    }
+    return true;
+  }
+  if (initListExpr) {
+    if (initListExpr->getNumInits() != 1)
+      return false;
+    expr = initListExpr->getInit(0);
+  }
+  Expr::EvalResult result;
+  if (!expr->EvaluateAsRValue(result, ctx) || result.HasSideEffects)
+    return false;
+  if (result.Val.isInt()) {
+    auto IT = elTy.dyn_cast<mlir::IntegerType>();
+    if (!IT)
+      return false;
+    elements.push_back(
+        IntegerAttr::get(IT, result.Val.getInt().extOrTrunc(IT.getWidth())));
+    return true;
+  }
+  if (result.Val.isFloat()) {
+    auto FT = elTy.dyn_cast<mlir::FloatType>();
+    if (!FT)
+      return false;
+    APFloat value = result.Val.getFloat();
+    bool losesInfo;
+    value.convert(FT.getFloatSemantics(), APFloat::rmNearestTiesToEven,
+                  &losesInfo);
+    elements.push_back(FloatAttr::get(FT, value));
+    return true;
+  }
+  return false;
+}
+
+mlir::DenseElementsAttr MLIRScanner::initializeInBulk(mlir::Value toInit,
+                                                      InitListExpr *expr,
+                                                      bool &zeroFilled) {
+  zeroFilled = false;
+  auto mt = toInit.getType().dyn_cast<MemRefType>();
+  if (!mt || !mt.hasStaticShape() || mt.getRank() == 0 ||
+      mt.getNumElements() < BulkInitThreshold)
+    return nullptr;
+  mlir::Type elTy = mt.getElementType();
+  if (!elTy.isIntOrFloat() || elTy.getIntOrFloatBitWidth() % 8 != 0)
+    return nullptr;
+
+  SmallVector<mlir::Attribute> elements;
+  mlir::DenseElementsAttr constant;
+  if (getConstantElements(Glob.CGM.getContext(), expr, mt.getShape(), elTy,
+                          elements))
+    constant = DenseElementsAttr::get(
+        RankedTensorType::get(mt.getShape(), elTy), elements);
+
+  bool isZero = false;
+  if (constant && constant.isSplat()) {
+    if (elTy.isa<mlir::FloatType>())
+      isZero = constant.getSplatValue<APFloat>().isPosZero();
+    else
+      isZero = constant.getSplatValue<APInt>().isZero();
+  }
+  bool zeroFiller = expr->hasArrayFiller() &&
+                    isa<ImplicitValueInitExpr>(expr->getArrayFiller());
+  if (!constant && !zeroFiller)
+    return nullptr;
+
+  auto loc = toInit.getLoc();
+  mlir::Value size = getTypeSize(loc, expr->getType());
+  size = builder.create<arith::IndexCastOp>(loc, builder.getI64Type(), size);
+  mlir::Value dst = builder.create<polygeist::Memref2PointerOp>(
+      loc, LLVM::LLVMPointerType::get(builder.getI8Type()), toInit);
+  auto falsev = builder.create<ConstantIntOp>(loc, false, 1);
+  if (!constant || isZero) {
+    auto i8_0 = builder.create<ConstantIntOp>(loc, 0, 8);
+    builder.create<LLVM::MemsetOp>(loc, dst, i8_0, size, falsev);
+    zeroFilled = !constant;
+    return constant;
+  }
+
+  auto globalType = mlir::MemRefType::get(mt.getShape(), elTy);
+  OpBuilder gbuilder(builder.getContext());
+  gbuilder.setInsertionPointToStart(module->getBody());
+  auto globalOp = gbuilder.create<mlir::memref::GlobalOp>(
+      module->getLoc(),
+      builder.getStringAttr(function.getName() + "@const@" +
+                            Twine(numConstantInits++)),
+      /*sym_visibility*/ mlir::StringAttr(), mlir::TypeAttr::get(globalType),
+      constant, /*constant*/ builder.getUnitAttr(), /*alignment*/ nullptr);
+  SymbolTable::setSymbolVisibility(globalOp,
+                                   mlir::SymbolTable::Visibility::Private);
+  mlir::Value src = builder.create<memref::GetGlobalOp>(loc, globalType,
+                                                        globalOp.getName());
+  src = builder.create<polygeist::Memref2PointerOp>(
+      loc, LLVM::LLVMPointerType::get(builder.getI8Type()), src);
+  builder.create<LLVM::MemcpyOp>(loc, dst, src, size, falsev);
+  return constant;
+}
+
 /// Construct corresponding MLIR operations to initialize the given value by a
 /// provided InitListExpr.
 mlir::Attribute MLIRScanner::InitializeValueByInitListExpr(mlir::Value toInit,
@@ -663,6 +833,14 @@ mlir::Attribute MLIRScanner::InitializeValueByInitListExpr(mlir::Value toInit,
   while (auto CO = toInit.getDefiningOp<memref::CastOp>())
     toInit = CO.getSource();
 
+  // Large local arrays are zeroed or copied in one operation rather than
+  // element by element. Global initializers only need the constant.
+  bool zeroFilled = false;
+  auto initList = dyn_cast<InitListExpr>(expr);
+  if (function && initList && !inner)
+    if (auto constant = initializeInBulk(toInit, initList, zeroFilled))
+      return constant;
+
   // Recursively visit the initialization expression following the linear
   // increment of the memory address.
   std::function<mlir::DenseElementsAttr(Expr *, mlir::Value, bool)> helper =
@@ -725,6 +903,14 @@ mlir::Attribute MLIRScanner::InitializeValueByInitListExpr(mlir::Value toInit,
       }
 
       for (unsigned i = 0, e = num; i < e; ++i) {
+        Expr *elt = i < initListExpr->getNumInits()
+                        ? initListExpr->getInit(i)
+                        : initListExpr->getArrayFiller();
+        // Elements left to a zero filler were covered by the memset.
+        if (zeroFilled && isa<ImplicitValueInitExpr>(elt)) {
+          allSub = false;
+          continue;
+        }
 
         mlir::Value next;
         if (auto mt = toInit.getType().dyn_cast<MemRefType>()) {
@@ -756,10 +942,46 @@ mlir::Attribute MLIRScanner::InitializeValueByInitListExpr(mlir::Value toInit,
               toInit, idxs);
         }
 
-        auto sub =
-            helper(initListExpr->hasArrayFiller() ? initListExpr->getInit(0)
-                                                  : initListExpr->getInit(i),
-                   next, true);
+        // Aggregates left to the filler have no initializer list to visit,
+        // so they are cleared as a whole.
+        if (isa<ImplicitValueInitExpr>(elt) &&
+            (elt->getType()->isArrayType() || elt->getType()->isRecordType())) {
+          mlir::Value size = getTypeSize(loc, elt->getType());
+          size = builder.create<arith::IndexCastOp>(loc, builder.getI64Type(),
+                                                    size);
+          auto i8PtrTy = LLVM::LLVMPointerType::get(builder.getI8Type());
+          mlir::Value dst =
+              next.getType().isa<MemRefType>()
+                  ? builder
+                        .create<polygeist::Memref2PointerOp>(loc, i8PtrTy, next)
+                        .getResult()
+                  : builder.create<LLVM::BitcastOp>(loc, i8PtrTy, next)
+                        .getResult();
+          builder.create<LLVM::MemsetOp>(
+              loc, dst, builder.create<ConstantIntOp>(loc, 0, 8), size,
+              builder.create<ConstantIntOp>(loc, false, 1));
+
+          auto mt = toInit.getType().dyn_cast<MemRefType>();
+          mlir::Type elTy = mt ? mt.getElementType() : mlir::Type();
+          if (!mt || mt.getRank() < 2 || !mt.hasStaticShape() ||
+              !elTy.isIntOrFloat()) {
+            allSub = false;
+            continue;
+          }
+          mlir::Attribute zero;
+          if (auto FT = elTy.dyn_cast<mlir::FloatType>())
+            zero = FloatAttr::get(FT, 0.0);
+          else
+            zero = IntegerAttr::get(elTy, 0);
+          auto sub = DenseElementsAttr::get(
+              RankedTensorType::get(mt.getShape().drop_front(), elTy), zero);
+          for (size_t j = 0, n = sub.size(); j < n; j++)
+            for (auto ea : sub.getRawData())
+              attrs.push_back(ea);
+          continue;
+        }
+
+        auto sub = helper(elt, next, true);
         if (sub) {
           size_t n = 1;
           if (sub.isSplat())
@@ -848,6 +1070,11 @@ ValueCategory MLIRScanner::VisitVarDecl(clang::VarDecl *decl) {
           assert(0 && inite.val);
         }
         subType = inite.val.getType();
+        // The value is only visible to later statements if it is not
+        // emitted inside a region guarding against an early exit.
+        if (ssaLocals.count(decl) &&
+            (loops.empty() || !loops.back().keepRunning))
+          return params[decl] = inite;
       }
     }
   } else if (auto ava = decl->getAttr<AlignValueAttr>()) {
@@ -2080,7 +2307,7 @@ ValueCategory MLIRScanner::VisitUnaryOperator(clang::UnaryOperator *U) {
                                  loc, ty, mlir::FloatAttr::get(ty, -api)),
                              /*isReference*/ false);
       }
-      return ValueCategory(builder.create<NegFOp>(loc, val),
+      return ValueCategory(fastMath(builder.create<NegFOp>(loc, val), U),
                            /*isReference*/ false);
     } else {
       if (auto CI = val.getDefiningOp<ConstantIntOp>()) {
@@ -2099,7 +2326,6 @@ ValueCategory MLIRScanner::VisitUnaryOperator(clang::UnaryOperator *U) {
   }
   case clang::UnaryOperator::Opcode::UO_PreInc:
   case clang::UnaryOperator::Opcode::UO_PostInc: {
-    assert(sub.isReference);
     auto prev = sub.getValue(loc, builder);
     auto ty = prev.getType();
 
@@ -2110,10 +2336,11 @@ ValueCategory MLIRScanner::VisitUnaryOperator(clang::UnaryOperator *U) {
         llvm::errs() << " ty: " << ty << "prev: " << prev << "\n";
       }
       assert(prev.getType() == ty);
-      next = builder.create<AddFOp>(
-          loc, prev,
-          builder.create<ConstantFloatOp>(
-              loc, APFloat(ft.getFloatSemantics(), "1"), ft));
+      next = fastMath(builder.create<AddFOp>(
+                          loc, prev,
+                          builder.create<ConstantFloatOp>(
+                              loc, APFloat(ft.getFloatSemantics(), "1"), ft)),
+                      U);
     } else if (auto mt = ty.dyn_cast<MemRefType>()) {
       auto shape = std::vector<int64_t>(mt.getShape());
       shape[0] = -1;
@@ -2138,11 +2365,14 @@ ValueCategory MLIRScanner::VisitUnaryOperator(clang::UnaryOperator *U) {
         llvm::errs() << " ty: " << ty << "prev: " << prev << "\n";
       }
       assert(prev.getType() == ty);
-      next = builder.create<AddIOp>(
-          loc, prev,
-          builder.create<ConstantIntOp>(loc, 1, ty.cast<mlir::IntegerType>()));
+      next = noSignedWrap(
+          builder.create<AddIOp>(
+              loc, prev,
+              builder.create<ConstantIntOp>(loc, 1,
+                                            ty.cast<mlir::IntegerType>())),
+          U);
     }
-    sub.store(loc, builder, next);
+    sub = assign(loc, U->getSubExpr(), sub, next);
 
     if (U->getOpcode() == clang::UnaryOperator::Opcode::UO_PreInc)
       return sub;
@@ -2152,15 +2382,15 @@ ValueCategory MLIRScanner::VisitUnaryOperator(clang::UnaryOperator *U) {
   case clang::UnaryOperator::Opcode::UO_PreDec:
   case clang::UnaryOperator::Opcode::UO_PostDec: {
     auto ty = getMLIRType(U->getType());
-    assert(sub.isReference);
     auto prev = sub.getValue(loc, builder);
 
     mlir::Value next;
     if (auto ft = ty.dyn_cast<mlir::FloatType>()) {
-      next = builder.create<SubFOp>(
-          loc, prev,
-          builder.create<ConstantFloatOp>(
-              loc, APFloat(ft.getFloatSemantics(), "1"), ft));
+      next = fastMath(builder.create<SubFOp>(
+                          loc, prev,
+                          builder.create<ConstantFloatOp>(
+                              loc, APFloat(ft.getFloatSemantics(), "1"), ft)),
+                      U);
     } else if (auto pt = ty.dyn_cast<mlir::LLVM::LLVMPointerType>()) {
       auto ity = mlir::IntegerType::get(builder.getContext(), 64);
       next = builder.create<LLVM::GEPOp>(
@@ -2180,11 +2410,14 @@ ValueCategory MLIRScanner::VisitUnaryOperator(clang::UnaryOperator *U) {
         llvm::errs() << ty << " - " << prev << "\n";
         U->dump();
       }
-      next = builder.create<SubIOp>(
-          loc, prev,
-          builder.create<ConstantIntOp>(loc, 1, ty.cast<mlir::IntegerType>()));
-    }
-    sub.store(loc, builder, next);
+      next = noSignedWrap(
+          builder.create<SubIOp>(
+              loc, prev,
+              builder.create<ConstantIntOp>(loc, 1,
+                                            ty.cast<mlir::IntegerType>())),
+          U);
+    }
+    sub = assign(loc, U->getSubExpr(), sub, next);
     return ValueCategory(
         (U->getOpcode() == clang::UnaryOperator::Opcode::UO_PostInc) ? prev
                                                                      : next,
@@ -2385,6 +2618,157 @@ ValueCategory MLIRScanner::VisitAtomicExpr(clang::AtomicExpr *BO) {
   }
 }
 
+/// The name of the strict-aliasing class of objects of type `T`, following
+/// the type descriptors of clang's TBAA, or an empty string for types whose
+/// lvalues may access objects of any type.
+static std::string getAliasTypeName(ASTContext &ctx, QualType T) {
+  for (auto *TT = T->getAs<TypedefType>(); TT;
+       TT = TT->desugar()->getAs<TypedefType>())
+    if (TT->getDecl()->hasAttr<MayAliasAttr>())
+      return "";
+  T = T.getCanonicalType().getUnqualifiedType();
+  if (auto *ET = T->getAs<EnumType>())
+    T = ET->getDecl()->getIntegerType();
+  if (T.isNull())
+    return "";
+  if (T->isPointerType() || T->isObjCObjectPointerType())
+    return "any pointer";
+  auto *BT = T->getAs<BuiltinType>();
+  if (!BT || BT->isCharType() || (!BT->isInteger() && !BT->isFloatingPoint()))
+    return "";
+  // Signed and unsigned variants of a type may access each other.
+  if (BT->isUnsignedInteger() && !BT->isBooleanType())
+    T = ctx.getCorrespondingSignedType(T);
+  return T.getAsString(ctx.getPrintingPolicy());
+}
+
+/// Whether the lvalue `E` names a union member, possibly nested, through
+/// which the stored bytes may be read as another type.
+static bool isUnionAccess(const Expr *E) {
+  while (true) {
+    E = E->IgnoreParens();
+    if (auto *ME = dyn_cast<MemberExpr>(E)) {
+      if (auto *FD = dyn_cast<FieldDecl>(ME->getMemberDecl()))
+        if (FD->getParent()->isUnion())
+          return true;
+      if (ME->isArrow())
+        return false;
+      E = ME->getBase();
+    } else if (auto *ASE = dyn_cast<ArraySubscriptExpr>(E)) {
+      E = ASE->getBase()->IgnoreParenImpCasts();
+    } else {
+      return false;
+    }
+  }
+}
+
+mlir::StringAttr MLIRScanner::getTypeTag(const clang::Expr *lvalue) {
+  // Like clang, only rely on strict aliasing when optimizing.
+  const CodeGenOptions &CGO = Glob.CGM.getCodeGenOpts();
+  if (CGO.OptimizationLevel == 0 || CGO.RelaxedAliasing ||
+      isUnionAccess(lvalue))
+    return nullptr;
+  std::string name = getAliasTypeName(Glob.CGM.getContext(), lvalue->getType());
+  if (name.empty())
+    return nullptr;
+  return builder.getStringAttr(name);
+}
+
+void MLIRScanner::tagAccesses(mlir::Block::iterator begin, mlir::Value addr,
+                              const clang::Expr *lvalue) {
+  mlir::StringAttr tag = getTypeTag(lvalue);
+  if (!tag)
+    return;
+  for (auto &op : llvm::make_range(begin, builder.getInsertionPoint())) {
+    mlir::Value accessed;
+    if (auto load = dyn_cast<memref::LoadOp>(op))
+      accessed = load.getMemref();
+    else if (auto store = dyn_cast<memref::StoreOp>(op))
+      accessed = store.getMemref();
+    else if (auto load = dyn_cast<LLVM::LoadOp>(op))
+      accessed = load.getAddr();
+    else if (auto store = dyn_cast<LLVM::StoreOp>(op))
+      accessed = store.getAddr();
+    if (accessed && accessed == addr)
+      op.setAttr(TypeTagAttrName, tag);
+  }
+}
+
+mlir::Value MLIRScanner::noSignedWrap(mlir::Value res, const clang::Expr *E) {
+  QualType T = E->getType();
+  if (auto *CAO = dyn_cast<CompoundAssignOperator>(E)) {
+    // The computation is only done in the type of the stored value if no
+    // promotion applies.
+    T = CAO->getComputationResultType();
+    if (!Glob.CGM.getContext().hasSameUnqualifiedType(
+            T, CAO->getLHS()->getType()))
+      return res;
+  }
+  if (auto *U = dyn_cast<UnaryOperator>(E))
+    if (!U->canOverflow())
+      return res;
+  // Keep the unoptimized output free of flags nothing would consume.
+  if (Glob.CGM.getCodeGenOpts().OptimizationLevel == 0 ||
+      !T->isSignedIntegerOrEnumerationType() ||
+      Glob.CGM.getLangOpts().isSignedOverflowDefined())
+    return res;
+  if (isa_and_nonnull<AddIOp, SubIOp, MulIOp>(res.getDefiningOp()))
+    res.getDefiningOp()->setAttr(NoSignedWrapAttrName,
+                                 builder.getUnitAttr());
+  return res;
+}
+
+mlir::Value MLIRScanner::fastMath(mlir::Value res, const clang::Expr *E) {
+  auto fmi = res.getDefiningOp<arith::ArithFastMathInterface>();
+  if (!fmi)
+    return res;
+  FPOptions FPO = E->getFPFeaturesInEffect(Glob.CGM.getLangOpts());
+  auto flags = arith::FastMathFlags::none;
+  if (FPO.getAllowFPReassociate())
+    flags = flags | arith::FastMathFlags::reassoc;
+  if (FPO.getNoHonorNaNs())
+    flags = flags | arith::FastMathFlags::nnan;
+  if (FPO.getNoHonorInfs())
+    flags = flags | arith::FastMathFlags::ninf;
+  if (FPO.getNoSignedZero())
+    flags = flags | arith::FastMathFlags::nsz;
+  if (FPO.getAllowReciprocal())
+    flags = flags | arith::FastMathFlags::arcp;
+  if (FPO.getAllowApproxFunc())
+    flags = flags | arith::FastMathFlags::afn;
+  if (FPO.allowFPContractAcrossStatement())
+    flags = flags | arith::FastMathFlags::contract;
+  if (flags != arith::FastMathFlags::none)
+    res.getDefiningOp()->setAttr(
+        fmi.getFastMathAttrName(),
+        arith::FastMathFlagsAttr::get(builder.getContext(), flags));
+  return res;
+}
+
+ValueCategory MLIRScanner::assign(mlir::Location loc, clang::Expr *E,
+                                  ValueCategory lhs, mlir::Value val) {
+  if (lhs.isReference) {
+    lhs.store(loc, builder, val);
+    return lhs;
+  }
+  auto *VD = cast<VarDecl>(cast<DeclRefExpr>(E)->getDecl());
+  assert(ssaLocals.count(VD) && "assigning an rvalue");
+  return params[VD] = ValueCategory(val, /*isReference*/ false);
+}
+
+ValueCategory MLIRScanner::VisitCompoundAssignOperator(
+    clang::CompoundAssignOperator *CAO) {
+  mlir::Block *block = builder.getInsertionBlock();
+  mlir::Block::iterator ip = builder.getInsertionPoint();
+  bool atBegin = ip == block->begin();
+  mlir::Block::iterator last = atBegin ? ip : std::prev(ip);
+  ValueCategory res = VisitBinaryOperator(CAO);
+  if (res.val && builder.getInsertionBlock() == block)
+    tagAccesses(atBegin ? block->begin() : std::next(last), res.val,
+                CAO->getLHS());
+  return res;
+}
+
 ValueCategory MLIRScanner::VisitBinaryOperator(clang::BinaryOperator *BO) {
   auto loc = getMLIRLocation(BO->getExprLoc());
 
@@ -2657,11 +3041,15 @@ ValueCategory MLIRScanner::VisitBinaryOperator(clang::BinaryOperator *BO) {
     auto lhs_v = lhs.getValue(loc, builder);
     if (lhs_v.getType().isa<mlir::FloatType>()) {
       return ValueCategory(
-          builder.create<arith::MulFOp>(loc, lhs_v, rhs.getValue(loc, builder)),
+          fastMath(builder.create<arith::MulFOp>(loc, lhs_v,
+                                                rhs.getValue(loc, builder)),
+                   BO),
           /*isReference*/ false);
     } else {
       return ValueCategory(
-          builder.create<arith::MulIOp>(loc, lhs_v, rhs.getValue(loc, builder)),
+          noSignedWrap(builder.create<arith::MulIOp>(
+                           loc, lhs_v, rhs.getValue(loc, builder)),
+                       BO),
           /*isReference*/ false);
     }
   }
@@ -2669,7 +3057,9 @@ ValueCategory MLIRScanner::VisitBinaryOperator(clang::BinaryOperator *BO) {
     auto lhs_v = lhs.getValue(loc, builder);
     if (lhs_v.getType().isa<mlir::FloatType>()) {
       return ValueCategory(
-          builder.create<arith::DivFOp>(loc, lhs_v, rhs.getValue(loc, builder)),
+          fastMath(builder.create<arith::DivFOp>(loc, lhs_v,
+                                                rhs.getValue(loc, builder)),
+                   BO),
           /*isReference*/ false);
       ;
     } else {
@@ -2687,7 +3077,9 @@ ValueCategory MLIRScanner::VisitBinaryOperator(clang::BinaryOperator *BO) {
     auto lhs_v = lhs.getValue(loc, builder);
     if (lhs_v.getType().isa<mlir::FloatType>()) {
       return ValueCategory(
-          builder.create<arith::RemFOp>(loc, lhs_v, rhs.getValue(loc, builder)),
+          fastMath(builder.create<arith::RemFOp>(loc, lhs_v,
+                                                rhs.getValue(loc, builder)),
+                   BO),
           /*isReference*/ false);
     } else {
       if (signedType)
@@ -2704,8 +3096,9 @@ ValueCategory MLIRScanner::VisitBinaryOperator(clang::BinaryOperator *BO) {
     auto lhs_v = lhs.getValue(loc, builder);
     auto rhs_v = rhs.getValue(loc, builder);
     if (lhs_v.getType().isa<mlir::FloatType>()) {
-      return ValueCategory(builder.create<AddFOp>(loc, lhs_v, rhs_v),
-                           /*isReference*/ false);
+      return ValueCategory(
+          fastMath(builder.create<AddFOp>(loc, lhs_v, rhs_v), BO),
+          /*isReference*/ false);
     } else if (auto mt = lhs_v.getType().dyn_cast<mlir::MemRefType>()) {
       auto shape = std::vector<int64_t>(mt.getShape());
       shape[0] = -1;
@@ -2732,8 +3125,9 @@ ValueCategory MLIRScanner::VisitBinaryOperator(clang::BinaryOperator *BO) {
               false);
         }
       }
-      return ValueCategory(builder.create<AddIOp>(loc, lhs_v, rhs_v),
-                           /*isReference*/ false);
+      return ValueCategory(
+          noSignedWrap(builder.create<AddIOp>(loc, lhs_v, rhs_v), BO),
+          /*isReference*/ false);
     }
   }
   case clang::BinaryOperator::Opcode::BO_Sub: {
@@ -2757,8 +3151,9 @@ ValueCategory MLIRScanner::VisitBinaryOperator(clang::BinaryOperator *BO) {
     }
     if (lhs_v.getType().isa<mlir::FloatType>()) {
       assert(rhs_v.getType() == lhs_v.getType());
-      return ValueCategory(builder.create<SubFOp>(loc, lhs_v, rhs_v),
-                           /*isReference*/ false);
+      return ValueCategory(
+          fastMath(builder.create<SubFOp>(loc, lhs_v, rhs_v), BO),
+          /*isReference*/ false);
     } else if (auto pt =
                    lhs_v.getType().dyn_cast<mlir::LLVM::LLVMPointerType>()) {
       if (auto IT = rhs_v.getType().dyn_cast<mlir::IntegerType>()) {
@@ -2775,24 +3170,31 @@ ValueCategory MLIRScanner::VisitBinaryOperator(clang::BinaryOperator *BO) {
                                      loc, getMLIRType(BO->getType()), lhs_v),
                                  builder.create<LLVM::PtrToIntOp>(
                                      loc, getMLIRType(BO->getType()), rhs_v));
-      val = builder.create<DivSIOp>(
+      auto div = builder.create<DivSIOp>(
           loc, val,
           builder.create<IndexCastOp>(
               loc, val.getType(),
               builder.create<polygeist::TypeSizeOp>(
                   loc, builder.getIndexType(),
                   mlir::TypeAttr::get(pt.getElementType()))));
-      return ValueCategory(val, /*isReference*/ false);
+      // Both pointers point into the same array, so the difference of their
+      // addresses is a multiple of the element size.
+      if (Glob.CGM.getCodeGenOpts().OptimizationLevel != 0)
+        div->setAttr(ExactAttrName, builder.getUnitAttr());
+      return ValueCategory(div, /*isReference*/ false);
     } else {
-      return ValueCategory(builder.create<SubIOp>(loc, lhs_v, rhs_v),
-                           /*isReference*/ false);
+      return ValueCategory(
+          noSignedWrap(builder.create<SubIOp>(loc, lhs_v, rhs_v), BO),
+          /*isReference*/ false);
     }
   }
   case clang::BinaryOperator::Opcode::BO_Assign: {
-    assert(lhs.isReference);
     mlir::Value tostore = rhs.getValue(loc, builder);
     mlir::Type subType;
-    if (auto PT = lhs.val.getType().dyn_cast<mlir::LLVM::LLVMPointerType>())
+    if (!lhs.isReference)
+      subType = lhs.val.getType();
+    else if (auto PT =
+                 lhs.val.getType().dyn_cast<mlir::LLVM::LLVMPointerType>())
       subType = PT.getElementType();
     else
       subType = lhs.val.getType().cast<MemRefType>().getElementType();
@@ -2819,7 +3221,11 @@ ValueCategory MLIRScanner::VisitBinaryOperator(clang::BinaryOperator *BO) {
         }
       }
     }
+    if (!lhs.isReference)
+      return assign(loc, BO->getLHS(), lhs, tostore);
     lhs.store(loc, builder, tostore);
+    tagAccesses(std::prev(builder.getInsertionPoint()), lhs.val,
+                BO->getLHS());
     return lhs;
   }
 
@@ -2828,7 +3234,6 @@ ValueCategory MLIRScanner::VisitBinaryOperator(clang::BinaryOperator *BO) {
   }
 
   case clang::BinaryOperator::Opcode::BO_AddAssign: {
-    assert(lhs.isReference);
     auto prev = lhs.getValue(loc, builder);
 
     mlir::Value result;
@@ -2842,7 +3247,7 @@ ValueCategory MLIRScanner::VisitBinaryOperator(clang::BinaryOperator *BO) {
         rhsV = builder.create<mlir::arith::TruncFOp>(loc, postTy, rhsV);
       }
       assert(rhsV.getType() == prev.getType());
-      result = builder.create<AddFOp>(loc, prev, rhsV);
+      result = fastMath(builder.create<AddFOp>(loc, prev, rhsV), BO);
     } else if (auto pt =
                    prev.getType().dyn_cast<mlir::LLVM::LLVMPointerType>()) {
       result = builder.create<LLVM::GEPOp>(
@@ -2862,7 +3267,7 @@ ValueCategory MLIRScanner::VisitBinaryOperator(clang::BinaryOperator *BO) {
         rhsV = builder.create<arith::TruncIOp>(loc, postTy, rhsV);
       }
       assert(rhsV.getType() == prev.getType());
-      result = builder.create<AddIOp>(loc, prev, rhsV);
+      result = noSignedWrap(builder.create<AddIOp>(loc, prev, rhsV), BO);
     } else if (auto postTy = prev.getType().dyn_cast<mlir::MemRefType>()) {
       mlir::Value rhsV = rhs.getValue(loc, builder);
       auto shape = std::vector<int64_t>(postTy.getShape());
@@ -2876,11 +3281,9 @@ ValueCategory MLIRScanner::VisitBinaryOperator(clang::BinaryOperator *BO) {
     } else {
       assert(false && "Unsupported add assign type");
     }
-    lhs.store(loc, builder, result);
-    return lhs;
+    return assign(loc, BO->getLHS(), lhs, result);
   }
   case clang::BinaryOperator::Opcode::BO_SubAssign: {
-    assert(lhs.isReference);
     auto prev = lhs.getValue(loc, builder);
 
     mlir::Value result;
@@ -2901,15 +3304,14 @@ ValueCategory MLIRScanner::VisitBinaryOperator(clang::BinaryOperator *BO) {
         llvm::errs() << " p:" << prev << " r:" << right << "\n";
       }
       assert(right.getType() == prev.getType());
-      result = builder.create<SubFOp>(loc, prev, right);
+      result = fastMath(builder.create<SubFOp>(loc, prev, right), BO);
     } else {
-      result = builder.create<SubIOp>(loc, prev, rhs.getValue(loc, builder));
+      result = noSignedWrap(
+          builder.create<SubIOp>(loc, prev, rhs.getValue(loc, builder)), BO);
     }
-    lhs.store(loc, builder, result);
-    return lhs;
+    return assign(loc, BO->getLHS(), lhs, result);
   }
   case clang::BinaryOperator::Opcode::BO_MulAssign: {
-    assert(lhs.isReference);
     auto prev = lhs.getValue(loc, builder);
 
     mlir::Value result;
@@ -2930,15 +3332,14 @@ ValueCategory MLIRScanner::VisitBinaryOperator(clang::BinaryOperator *BO) {
         llvm::errs() << " p:" << prev << " r:" << right << "\n";
       }
       assert(right.getType() == prev.getType());
-      result = builder.create<MulFOp>(loc, prev, right);
+      result = fastMath(builder.create<MulFOp>(loc, prev, right), BO);
     } else {
-      result = builder.create<MulIOp>(loc, prev, rhs.getValue(loc, builder));
+      result = noSignedWrap(
+          builder.create<MulIOp>(loc, prev, rhs.getValue(loc, builder)), BO);
     }
-    lhs.store(loc, builder, result);
-    return lhs;
+    return assign(loc, BO->getLHS(), lhs, result);
   }
   case clang::BinaryOperator::Opcode::BO_DivAssign: {
-    assert(lhs.isReference);
     auto prev = lhs.getValue(loc, builder);
 
     mlir::Value result;
@@ -2952,7 +3353,7 @@ ValueCategory MLIRScanner::VisitBinaryOperator(clang::BinaryOperator *BO) {
       } else if (prevTy.getWidth() > postTy.getWidth()) {
         val = builder.create<arith::TruncFOp>(loc, postTy, val);
       }
-      result = builder.create<arith::DivFOp>(loc, prev, val);
+      result = fastMath(builder.create<arith::DivFOp>(loc, prev, val), BO);
     } else {
       if (signedType)
         result = builder.create<arith::DivSIOp>(loc, prev,
@@ -2961,11 +3362,9 @@ ValueCategory MLIRScanner::VisitBinaryOperator(clang::BinaryOperator *BO) {
         result = builder.create<arith::DivUIOp>(loc, prev,
                                                 rhs.getValue(loc, builder));
     }
-    lhs.store(loc, builder, result);
-    return lhs;
+    return assign(loc, BO->getLHS(), lhs, result);
   }
   case clang::BinaryOperator::Opcode::BO_ShrAssign: {
-    assert(lhs.isReference);
     auto prev = lhs.getValue(loc, builder);
 
     mlir::Value result;
@@ -2974,61 +3373,51 @@ ValueCategory MLIRScanner::VisitBinaryOperator(clang::BinaryOperator *BO) {
       result = builder.create<ShRSIOp>(loc, prev, rhs.getValue(loc, builder));
     else
       result = builder.create<ShRUIOp>(loc, prev, rhs.getValue(loc, builder));
-    lhs.store(loc, builder, result);
-    return lhs;
+    return assign(loc, BO->getLHS(), lhs, result);
   }
   case clang::BinaryOperator::Opcode::BO_ShlAssign: {
-    assert(lhs.isReference);
     auto prev = lhs.getValue(loc, builder);
 
     mlir::Value result =
         builder.create<ShLIOp>(loc, prev, rhs.getValue(loc, builder));
-    lhs.store(loc, builder, result);
-    return lhs;
+    return assign(loc, BO->getLHS(), lhs, result);
   }
   case clang::BinaryOperator::Opcode::BO_RemAssign: {
-    assert(lhs.isReference);
     auto prev = lhs.getValue(loc, builder);
 
     mlir::Value result;
 
     if (prev.getType().isa<mlir::FloatType>()) {
-      result = builder.create<RemFOp>(loc, prev, rhs.getValue(loc, builder));
+      result = fastMath(
+          builder.create<RemFOp>(loc, prev, rhs.getValue(loc, builder)), BO);
     } else {
       if (signedType)
         result = builder.create<RemSIOp>(loc, prev, rhs.getValue(loc, builder));
       else
         result = builder.create<RemUIOp>(loc, prev, rhs.getValue(loc, builder));
     }
-    lhs.store(loc, builder, result);
-    return lhs;
+    return assign(loc, BO->getLHS(), lhs, result);
   }
   case clang::BinaryOperator::Opcode::BO_AndAssign: {
-    assert(lhs.isReference);
     auto prev = lhs.getValue(loc, builder);
 
     mlir::Value result =
         builder.create<AndIOp>(loc, prev, rhs.getValue(loc, builder));
-    lhs.store(loc, builder, result);
-    return lhs;
+    return assign(loc, BO->getLHS(), lhs, result);
   }
   case clang::BinaryOperator::Opcode::BO_OrAssign: {
-    assert(lhs.isReference);
     auto prev = lhs.getValue(loc, builder);
 
     mlir::Value result =
         builder.create<OrIOp>(loc, prev, rhs.getValue(loc, builder));
-    lhs.store(loc, builder, result);
-    return lhs;
+    return assign(loc, BO->getLHS(), lhs, result);
   }
   case clang::BinaryOperator::Opcode::BO_XorAssign: {
-    assert(lhs.isReference);
     auto prev = lhs.getValue(loc, builder);
 
     mlir::Value result =
         builder.create<XOrIOp>(loc, prev, rhs.getValue(loc, builder));
-    lhs.store(loc, builder, result);
-    return lhs;
+    return assign(loc, BO->getLHS(), lhs, result);
   }
 
   default: {
@@ -3793,6 +4182,10 @@ ValueCategory MLIRScanner::VisitCastExpr(CastExpr *E) {
       */
     }
     auto prev = Visit(E->getSubExpr());
+    if (!prev.isReference)
+      if (auto dr = dyn_cast<DeclRefExpr>(E->getSubExpr()))
+        if (ssaLocals.count(dyn_cast<VarDecl>(dr->getDecl())))
+          return prev;
 
     bool isArray = false;
     Glob.getMLIRType(E->getType(), &isArray);
@@ -3805,6 +4198,8 @@ ValueCategory MLIRScanner::VisitCastExpr(CastExpr *E) {
       lres.dump();
     }
     assert(prev.isReference);
+    tagAccesses(std::prev(builder.getInsertionPoint()), prev.val,
+                E->getSubExpr());
     return ValueCategory(lres, /*isReference*/ false);
   }
   case clang::CastKind::CK_IntegralToFloating: {
@@ -4246,15 +4641,40 @@ mlir::LLVM::LLVMFuncOp MLIRASTConsumer::GetOrCreateFreeFunction() {
              module->getLoc(), name, llvmFnType, lnk);
 }
 
-mlir::LLVM::LLVMFuncOp
-MLIRASTConsumer::GetOrCreateLLVMFunction(const FunctionDecl *FD) {
-  std::string name;
+mlir::func::FuncOp
+MLIRASTConsumer::GetOrCreateRuntimeFunction(StringRef name,
+                                            mlir::FunctionType type) {
+  auto found = functions.find(name);
+  if (found != functions.end())
+    return found->second;
+  auto ctx = module->getContext();
+  mlir::OpBuilder builder(ctx);
+  builder.setInsertionPointToStart(module->getBody());
+  auto function =
+      builder.create<mlir::func::FuncOp>(module->getLoc(), name, type);
+  function.setPrivate();
+  function->setAttr("llvm.linkage",
+                    LLVM::LinkageAttr::get(ctx, LLVM::Linkage::External));
+  return functions[name] = function;
+}
+
+StringRef MLIRASTConsumer::getMangledFunctionName(const FunctionDecl *FD) {
+  StringRef &name = mangledNames[FD];
+  if (!name.empty())
+    return name;
+  // CodeGenModule keeps the mangled names alive for its own lifetime.
   if (auto CC = dyn_cast<CXXConstructorDecl>(FD))
-    name = CGM.getMangledName(GlobalDecl(CC, CXXCtorType::Ctor_Complete)).str();
+    name = CGM.getMangledName(GlobalDecl(CC, CXXCtorType::Ctor_Complete));
   else if (auto CC = dyn_cast<CXXDestructorDecl>(FD))
-    name = CGM.getMangledName(GlobalDecl(CC, CXXDtorType::Dtor_Complete)).str();
+    name = CGM.getMangledName(GlobalDecl(CC, CXXDtorType::Dtor_Complete));
   else
-    name = CGM.getMangledName(FD).str();
+    name = CGM.getMangledName(FD);
+  return name;
+}
+
+mlir::LLVM::LLVMFuncOp
+MLIRASTConsumer::GetOrCreateLLVMFunction(const FunctionDecl *FD) {
+  std::string name = getMangledFunctionName(FD).str();
 
   if (name != "malloc" && name != "free")
     name = (PrefixABI + name);
@@ -4597,12 +5017,13 @@ MLIRASTConsumer::GetOrCreateGlobal(const ValueDecl *FD, std::string prefix,
   return globals[name];
 }
 
-mlir::Value MLIRASTConsumer::GetOrCreateGlobalLLVMString(
-    mlir::Location loc, mlir::OpBuilder &builder, StringRef value) {
+mlir::LLVM::GlobalOp
+MLIRASTConsumer::GetOrCreateGlobalLLVMStringOp(mlir::Location loc,
+                                               StringRef value) {
   using namespace mlir;
   // Create the global at the entry of the module.
   if (llvmStringGlobals.find(value.str()) == llvmStringGlobals.end()) {
-    OpBuilder::InsertionGuard insertGuard(builder);
+    OpBuilder builder(module->getContext());
     builder.setInsertionPointToStart(module->getBody());
     auto type = LLVM::LLVMArrayType::get(
         mlir::IntegerType::get(builder.getContext(), 8), value.size() + 1);
@@ -4611,13 +5032,28 @@ mlir::Value MLIRASTConsumer::GetOrCreateGlobalLLVMString(
         "str" + std::to_string(llvmStringGlobals.size()),
         builder.getStringAttr(value.str() + '\0'));
   }
+  return llvmStringGlobals[value.str()];
+}
 
-  LLVM::GlobalOp global = llvmStringGlobals[value.str()];
+mlir::Value MLIRASTConsumer::GetOrCreateGlobalLLVMString(
+    mlir::Location loc, mlir::OpBuilder &builder, StringRef value) {
+  LLVM::GlobalOp global = GetOrCreateGlobalLLVMStringOp(loc, value);
   // Get the pointer to the first character in the global string.
   mlir::Value globalPtr = builder.create<mlir::LLVM::AddressOfOp>(loc, global);
   return globalPtr;
 }
 
+bool MLIRASTConsumer::isSkippedRoot(const FunctionDecl *fd) {
+  return EmitReachableOnly && SM.isInSystemHeader(fd->getLocation());
+}
+
+bool MLIRASTConsumer::isDiscardableCallee(StringRef name, LLVM::Linkage lnk) {
+  if (!EmitReachableOnly || emitIfFound.count(name))
+    return false;
+  return lnk == LLVM::Linkage::Linkonce || lnk == LLVM::Linkage::LinkonceODR ||
+         lnk == LLVM::Linkage::AvailableExternally;
+}
+
 mlir::func::FuncOp
 MLIRASTConsumer::GetOrCreateMLIRFunction(const FunctionDecl *FD,
                                          bool getDeviceStub) {
@@ -4630,12 +5066,8 @@ MLIRASTConsumer::GetOrCreateMLIRFunction(const FunctionDecl *FD,
   if (getDeviceStub)
     name =
         CGM.getMangledName(GlobalDecl(FD, KernelReferenceKind::Kernel)).str();
-  else if (auto CC = dyn_cast<CXXConstructorDecl>(FD))
-    name = CGM.getMangledName(GlobalDecl(CC, CXXCtorType::Ctor_Complete)).str();
-  else if (auto CC = dyn_cast<CXXDestructorDecl>(FD))
-    name = CGM.getMangledName(GlobalDecl(CC, CXXDtorType::Dtor_Complete)).str();
   else
-    name = CGM.getMangledName(FD).str();
+    name = getMangledFunctionName(FD).str();
 
   name = (PrefixABI + name);
 
@@ -4698,7 +5130,8 @@ MLIRASTConsumer::GetOrCreateMLIRFunction(const FunctionDecl *FD,
     if (Def->isThisDeclarationADefinition()) {
       if (LV == llvm::GlobalValue::InternalLinkage ||
           LV == llvm::GlobalValue::PrivateLinkage || !Def->isDefined() ||
-          Def->hasAttr<CUDAGlobalAttr>() || Def->hasAttr<CUDADeviceAttr>()) {
+          Def->hasAttr<CUDAGlobalAttr>() || Def->hasAttr<CUDADeviceAttr>() ||
+          isDiscardableCallee(name, lnk)) {
         SymbolTable::setSymbolVisibility(function,
                                          SymbolTable::Visibility::Private);
       } else {
@@ -4744,7 +5177,15 @@ MLIRASTConsumer::GetOrCreateMLIRFunction(const FunctionDecl *FD,
       names.push_back("this");
     }
   }
+  SmallVector<unsigned> noAliasArgs;
   for (auto parm : FD->parameters()) {
+    // As in clang's codegen, only the qualifiers of the definition count, so
+    // a function that is only declared gets no noalias arguments.
+    if (Def->isThisDeclarationADefinition() &&
+        Def->getParamDecl(parm->getFunctionScopeIndex())
+            ->getType()
+            .isRestrictQualified())
+      noAliasArgs.push_back(types.size());
     bool llvmType = name == "main" && types.size() == 1;
     if (auto ava = parm->getAttr<AlignValueAttr>()) {
       if (auto algn = dyn_cast<clang::ConstantExpr>(ava->getAlignment())) {
@@ -4799,10 +5240,14 @@ MLIRASTConsumer::GetOrCreateMLIRFunction(const FunctionDecl *FD,
 
   mlir::func::FuncOp function = mlir::func::FuncOp(mlir::func::FuncOp::create(
       getMLIRLocation(FD->getLocation()), name, funcType));
+  for (unsigned arg : noAliasArgs)
+    function.setArgAttr(arg, LLVM::LLVMDialect::getNoAliasAttrName(),
+                        builder.getUnitAttr());
 
   if (LV == llvm::GlobalValue::InternalLinkage ||
       LV == llvm::GlobalValue::PrivateLinkage || !FD->isDefined() ||
-      FD->hasAttr<CUDAGlobalAttr>() || FD->hasAttr<CUDADeviceAttr>()) {
+      FD->hasAttr<CUDAGlobalAttr>() || FD->hasAttr<CUDADeviceAttr>() ||
+      isDiscardableCallee(name, lnk)) {
     SymbolTable::setSymbolVisibility(function,
                                      SymbolTable::Visibility::Private);
   } else {
@@ -4838,22 +5283,218 @@ void MLIRASTConsumer::run() {
     assert(FD->getTemplatedKind() !=
            FunctionDecl::TemplatedKind::
                TK_DependentFunctionTemplateSpecialization);
-    std::string name;
-    if (auto CC = dyn_cast<CXXConstructorDecl>(FD))
-      name =
-          CGM.getMangledName(GlobalDecl(CC, CXXCtorType::Ctor_Complete)).str();
-    else if (auto CC = dyn_cast<CXXDestructorDecl>(FD))
-      name =
-          CGM.getMangledName(GlobalDecl(CC, CXXDtorType::Dtor_Complete)).str();
-    else
-      name = CGM.getMangledName(FD).str();
+    StringRef name = getMangledFunctionName(FD);
 
     if (done.count(name))
       continue;
     done.insert(name);
+    auto function = GetOrCreateMLIRFunction(FD);
+
+    // `#pragma lower_to` changes how calls are emitted without showing up in
+    // the AST, so the per-function cache is bypassed when it is in use.
+    std::string cacheKey;
+    FunctionCacheLocation cacheLocation;
+    if (FunctionLoweringCache && LTInfo.SymbolTable.empty()) {
+      SmallVector<const FunctionDecl *, 8> callees;
+      if (auto key = computeFunctionCacheKey(FD, SM,
+                                             FunctionLoweringCacheContext,
+                                             callees, cacheLocation)) {
+        cacheKey = *key;
+        if (lowerFromFunctionCache(function, cacheKey, callees, cacheLocation))
+          continue;
+      }
+    }
+
     MLIRScanner ms(*this, module, LTInfo);
-    ms.init(GetOrCreateMLIRFunction(FD), FD);
+    ms.init(function, FD);
+    if (!cacheKey.empty())
+      storeInFunctionCache(function, cacheKey, cacheLocation);
+  }
+}
+
+static constexpr StringLiteral FunctionCacheBeginLine = "cgeist.begin_line";
+static constexpr StringLiteral FunctionCacheEndLine = "cgeist.end_line";
+static constexpr StringLiteral FunctionCacheString = "cgeist.string";
+static constexpr StringLiteral FunctionCacheIsArray = "cgeist.is_array";
+
+/// Move locations within the original extent of a cached function to where
+/// the function is defined now.
+static void shiftFunctionCacheLocations(Operation *root, StringRef filename,
+                                        unsigned beginLine, unsigned endLine,
+                                        unsigned newBeginLine) {
+  if (beginLine == newBeginLine)
+    return;
+  auto shift = [&](Location loc) -> Location {
+    auto fileLoc = loc.dyn_cast<FileLineColLoc>();
+    if (!fileLoc || fileLoc.getFilename() != filename ||
+        fileLoc.getLine() < beginLine || fileLoc.getLine() > endLine)
+      return loc;
+    return FileLineColLoc::get(fileLoc.getFilename(),
+                               fileLoc.getLine() - beginLine + newBeginLine,
+                               fileLoc.getColumn());
+  };
+  root->walk([&](Operation *op) {
+    op->setLoc(shift(op->getLoc()));
+    for (Region &region : op->getRegions())
+      for (Block &block : region)
+        for (BlockArgument arg : block.getArguments())
+          arg.setLoc(shift(arg.getLoc()));
+  });
+}
+
+bool MLIRASTConsumer::lowerFromFunctionCache(
+    func::FuncOp function, StringRef key,
+    ArrayRef<const FunctionDecl *> callees,
+    const FunctionCacheLocation &location) {
+  if (!function.isExternal())
+    return false;
+  auto buffer = FunctionLoweringCache->lookup(key);
+  if (!buffer)
+    return false;
+
+  // A corrupt entry is treated like a miss.
+  MLIRContext *ctx = module->getContext();
+  ScopedDiagnosticHandler silence(ctx, [](Diagnostic &) { return success(); });
+  OwningOpRef<ModuleOp> cached = parseSourceString<ModuleOp>(
+      buffer->getBuffer(), ParserConfig(ctx, /*verifyAfterParse*/ false));
+  if (!cached)
+    return false;
+  auto cachedFn = cached->lookupSymbol<func::FuncOp>(function.getName());
+  auto beginLine =
+      (*cached)->getAttrOfType<IntegerAttr>(FunctionCacheBeginLine);
+  auto endLine = (*cached)->getAttrOfType<IntegerAttr>(FunctionCacheEndLine);
+  if (!cachedFn || cachedFn.isExternal() || !beginLine || !endLine)
+    return false;
+  for (Operation &op : *cached->getBody())
+    if (!isa<func::FuncOp, LLVM::LLVMFuncOp, LLVM::GlobalOp, memref::GlobalOp>(
+            op))
+      return false;
+
+  shiftFunctionCacheLocations(*cached, location.filename, beginLine.getInt(),
+                              endLine.getInt(), location.beginLine);
+
+  // Declare the callees the way lowering the body would have, which also
+  // queues their definitions for emission.
+  for (const FunctionDecl *callee : callees) {
+    std::string name = PrefixABI + CGM.getMangledName(callee).str();
+    if (isa_and_nonnull<func::FuncOp>(cached->lookupSymbol(name)))
+      GetOrCreateMLIRFunction(callee);
+  }
+
+  // String constants are numbered in order of creation, so they get their
+  // names from this module rather than the cached one.
+  SmallVector<std::pair<StringAttr, StringAttr>> renames;
+  for (auto global : cached->getOps<LLVM::GlobalOp>()) {
+    if (!global->hasAttr(FunctionCacheString))
+      continue;
+    auto value = global.getValueAttr().dyn_cast_or_null<StringAttr>();
+    if (!value)
+      return false;
+    auto live = GetOrCreateGlobalLLVMStringOp(
+        global.getLoc(), value.getValue().drop_back());
+    if (live.getSymNameAttr() != global.getSymNameAttr())
+      renames.emplace_back(global.getSymNameAttr(), live.getSymNameAttr());
+  }
+  // Go through temporary names so that swapped names do not collide.
+  for (size_t i = 0; i < renames.size(); i++) {
+    auto tmp = StringAttr::get(ctx, "cgeist.rename." + Twine(i));
+    if (failed(SymbolTable::replaceAllSymbolUses(renames[i].first, tmp,
+                                                 *cached)))
+      return false;
+    renames[i].first = tmp;
+  }
+  for (auto &rename : renames)
+    if (failed(SymbolTable::replaceAllSymbolUses(rename.first, rename.second,
+                                                 *cached)))
+      return false;
+
+  // Recreate whatever else the body refers to and is not in the module yet.
+  OpBuilder builder(ctx);
+  builder.setInsertionPointToStart(module->getBody());
+  for (Operation &op : *cached->getBody()) {
+    if (&op == cachedFn.getOperation() || op.hasAttr(FunctionCacheString))
+      continue;
+    StringRef name = SymbolTable::getSymbolName(&op).getValue();
+    if (module->lookupSymbol(name))
+      continue;
+    Operation *clone = builder.clone(op);
+    clone->removeAttr(FunctionCacheIsArray);
+    if (auto fn = dyn_cast<func::FuncOp>(clone))
+      functions[name.str()] = fn;
+    else if (auto fn = dyn_cast<LLVM::LLVMFuncOp>(clone))
+      llvmFunctions[name.str()] = fn;
+    else if (auto global = dyn_cast<LLVM::GlobalOp>(clone))
+      llvmGlobals[name.str()] = global;
+    else if (auto global = dyn_cast<memref::GlobalOp>(clone))
+      globals[name.str()] =
+          std::make_pair(global, op.hasAttr(FunctionCacheIsArray));
+  }
+
+  function.getBody().takeBody(cachedFn.getBody());
+  if (ShowAST)
+    llvm::errs() << "Reused cached lowering of " << function.getName() << "\n";
+  return true;
+}
+
+void MLIRASTConsumer::storeInFunctionCache(
+    func::FuncOp function, StringRef key,
+    const FunctionCacheLocation &location) {
+  // Collect the symbols the function refers to, following global
+  // initializers but not the bodies of other functions.
+  llvm::SetVector<Operation *> symbols;
+  SmallVector<Operation *, 8> worklist = {function.getOperation()};
+  while (!worklist.empty()) {
+    Operation *op = worklist.pop_back_val();
+    auto uses = SymbolTable::getSymbolUses(op);
+    if (!uses)
+      return;
+    for (const SymbolTable::SymbolUse &use : *uses) {
+      Operation *symbol =
+          module->lookupSymbol(use.getSymbolRef().getRootReference());
+      if (!symbol || !isa<func::FuncOp, LLVM::LLVMFuncOp, LLVM::GlobalOp,
+                          memref::GlobalOp>(symbol))
+        return;
+      if (symbol == function.getOperation() || !symbols.insert(symbol))
+        continue;
+      if (isa<LLVM::GlobalOp>(symbol))
+        worklist.push_back(symbol);
+    }
+  }
+
+  llvm::StringSet<> strings;
+  for (auto &it : llvmStringGlobals)
+    strings.insert(it.second.getSymName());
+
+  OpBuilder builder(module->getContext());
+  OwningOpRef<ModuleOp> entry = ModuleOp::create(function.getLoc());
+  (*entry)->setAttr(FunctionCacheBeginLine,
+                    builder.getI64IntegerAttr(location.beginLine));
+  (*entry)->setAttr(FunctionCacheEndLine,
+                    builder.getI64IntegerAttr(location.endLine));
+  builder.setInsertionPointToEnd(entry->getBody());
+  for (Operation *symbol : symbols) {
+    Operation *clone = builder.clone(*symbol);
+    if (auto fn = dyn_cast<FunctionOpInterface>(clone)) {
+      if (!fn.isExternal()) {
+        fn.eraseBody();
+        if (isa<func::FuncOp>(clone))
+          SymbolTable::setSymbolVisibility(clone,
+                                           SymbolTable::Visibility::Private);
+      }
+    } else if (auto global = dyn_cast<memref::GlobalOp>(clone)) {
+      auto it = globals.find(global.getSymName().str());
+      if (it != globals.end() && it->second.second)
+        clone->setAttr(FunctionCacheIsArray, builder.getUnitAttr());
+    } else if (strings.count(SymbolTable::getSymbolName(clone).getValue())) {
+      clone->setAttr(FunctionCacheString, builder.getUnitAttr());
+    }
   }
+  builder.clone(*function);
+
+  std::string data;
+  llvm::raw_string_ostream os(data);
+  writeBytecodeToFile(*entry, os);
+  FunctionLoweringCache->storeBuffer(key, os.str());
 }
 
 void MLIRASTConsumer::HandleDeclContext(DeclContext *DC) {
@@ -4897,15 +5538,7 @@ void MLIRASTConsumer::HandleDeclContext(DeclContext *DC) {
     if (!CGM.getContext().DeclMustBeEmitted(fd))
       externLinkage = false;
 
-    std::string name;
-    if (auto CC = dyn_cast<CXXConstructorDecl>(fd))
-      name =
-          CGM.getMangledName(GlobalDecl(CC, CXXCtorType::Ctor_Complete)).str();
-    else if (auto CC = dyn_cast<CXXDestructorDecl>(fd))
-      name =
-          CGM.getMangledName(GlobalDecl(CC, CXXDtorType::Dtor_Complete)).str();
-    else
-      name = CGM.getMangledName(fd).str();
+    StringRef name = getMangledFunctionName(fd);
 
     // Don't create std functions unless necessary
     if (StringRef(name).startswith("_ZNKSt"))
@@ -4920,7 +5553,7 @@ void MLIRASTConsumer::HandleDeclContext(DeclContext *DC) {
       continue;
 
     if ((emitIfFound.count("*") && name != "fpclassify" && !fd->isStatic() &&
-         externLinkage) ||
+         externLinkage && !isSkippedRoot(fd)) ||
         emitIfFound.count(name)) {
       functionsToEmit.push_back(fd);
     } else {
@@ -4972,15 +5605,7 @@ bool MLIRASTConsumer::HandleTopLevelDecl(DeclGroupRef dg) {
     if (!CGM.getContext().DeclMustBeEmitted(fd))
       externLinkage = false;
 
-    std::string name;
-    if (auto CC = dyn_cast<CXXConstructorDecl>(fd))
-      name =
-          CGM.getMangledName(GlobalDecl(CC, CXXCtorType::Ctor_Complete)).str();
-    else if (auto CC = dyn_cast<CXXDestructorDecl>(fd))
-      name =
-          CGM.getMangledName(GlobalDecl(CC, CXXDtorType::Dtor_Complete)).str();
-    else
-      name = CGM.getMangledName(fd).str();
+    StringRef name = getMangledFunctionName(fd);
 
     // Don't create std functions unless necessary
     if (StringRef(name).startswith("_ZNKSt"))
@@ -4995,7 +5620,7 @@ bool MLIRASTConsumer::HandleTopLevelDecl(DeclGroupRef dg) {
       continue;
 
     if ((emitIfFound.count("*") && name != "fpclassify" && !fd->isStatic() &&
-         externLinkage) ||
+         externLinkage && !isSkippedRoot(fd)) ||
         emitIfFound.count(name)) {
       functionsToEmit.push_back(fd);
     } else {
@@ -5007,16 +5632,29 @@ bool MLIRASTConsumer::HandleTopLevelDecl(DeclGroupRef dg) {
 
 // Wait until Sema has instantiated all the relevant code
 // before running codegen on the selected functions.
-void MLIRASTConsumer::HandleTranslationUnit(ASTContext &C) { run(); }
+void MLIRASTConsumer::HandleTranslationUnit(ASTContext &C) {
+  // Translation units may be lowered concurrently, so their emission is
+  // accumulated under the frontend stage rather than nested.
+  CompileReport::Scope stage(CompileTimeReport, "mlir-emission",
+                             /*nested*/ false);
+  run();
+}
 
 mlir::Location MLIRASTConsumer::getMLIRLocation(clang::SourceLocation loc) {
   auto spellingLoc = SM.getSpellingLoc(loc);
-  auto lineNumber = SM.getSpellingLineNumber(spellingLoc);
-  auto colNumber = SM.getSpellingColumnNumber(spellingLoc);
-  auto fileId = SM.getFilename(spellingLoc);
-
   auto ctx = module->getContext();
-  return FileLineColLoc::get(ctx, fileId, lineNumber, colNumber);
+  if (spellingLoc.isInvalid())
+    return FileLineColLoc::get(ctx, "", 0, 0);
+
+  // Intern the file name once per file rather than once per location.
+  std::pair<clang::FileID, unsigned> decomposed =
+      SM.getDecomposedLoc(spellingLoc);
+  mlir::StringAttr &fileName = fileNames[decomposed.first];
+  if (!fileName)
+    fileName = mlir::StringAttr::get(ctx, SM.getFilename(spellingLoc));
+  auto lineNumber = SM.getLineNumber(decomposed.first, decomposed.second);
+  auto colNumber = SM.getColumnNumber(decomposed.first, decomposed.second);
+  return FileLineColLoc::get(fileName, lineNumber, colNumber);
 }
 
 /// Iteratively get the size of each dim of the given ConstantArrayType inst.
@@ -5037,6 +5675,23 @@ static void getConstantArrayShapeAndElemType(const clang::QualType &ty,
 
 mlir::Type MLIRASTConsumer::getMLIRType(clang::QualType qt, bool *implicitRef,
                                         bool allowMerge) {
+  // Recursive records are identified structs and therefore compare equal
+  // whether they are converted before or after their body is set.
+  auto key = std::make_pair(qt.getAsOpaquePtr(), (unsigned)allowMerge);
+  auto found = convertedTypes.find(key);
+  if (found == convertedTypes.end()) {
+    bool isRef = false;
+    mlir::Type converted = convertMLIRType(qt, &isRef, allowMerge);
+    found = convertedTypes.try_emplace(key, converted, isRef).first;
+  }
+  if (implicitRef && found->second.second)
+    *implicitRef = true;
+  return found->second.first;
+}
+
+mlir::Type MLIRASTConsumer::convertMLIRType(clang::QualType qt,
+                                            bool *implicitRef,
+                                            bool allowMerge) {
   if (auto ET = dyn_cast<clang::ElaboratedType>(qt)) {
     return getMLIRType(ET->getNamedType(), implicitRef, allowMerge);
   }
@@ -5417,14 +6072,14 @@ llvm::Type *MLIRASTConsumer::getLLVMType(clang::QualType t) {
 #include "clang/Frontend/FrontendAction.h"
 class MLIRAction : public clang::ASTFrontendAction {
 public:
-  std::set<std::string> emitIfFound;
-  std::set<std::string> done;
+  llvm::StringSet<> emitIfFound;
+  llvm::StringSet<> done;
   mlir::OwningOpRef<mlir::ModuleOp> &module;
-  std::map<std::string, mlir::LLVM::GlobalOp> llvmStringGlobals;
-  std::map<std::string, std::pair<mlir::memref::GlobalOp, bool>> globals;
-  std::map<std::string, mlir::func::FuncOp> functions;
-  std::map<std::string, mlir::LLVM::GlobalOp> llvmGlobals;
-  std::map<std::string, mlir::LLVM::LLVMFuncOp> llvmFunctions;
+  llvm::StringMap<mlir::LLVM::GlobalOp> llvmStringGlobals;
+  llvm::StringMap<std::pair<mlir::memref::GlobalOp, bool>> globals;
+  llvm::StringMap<mlir::func::FuncOp> functions;
+  llvm::StringMap<mlir::LLVM::GlobalOp> llvmGlobals;
+  llvm::StringMap<mlir::LLVM::LLVMFuncOp> llvmFunctions;
   MLIRAction(std::string fn, mlir::OwningOpRef<mlir::ModuleOp> &module)
       : module(module) {
     emitIfFound.insert(fn);
@@ -5491,25 +6146,14 @@ mlir::Value MLIRScanner::getTypeAlign(mlir::Location loc, clang::QualType t) {
 }
 
 #include "clang/Frontend/TextDiagnosticBuffer.h"
-
-static bool parseMLIR(const char *Argv0, std::vector<std::string> filenames,
-                      std::string fn, std::vector<std::string> includeDirs,
-                      std::vector<std::string> defines,
-                      mlir::OwningOpRef<mlir::ModuleOp> &module,
-                      llvm::Triple &triple, llvm::DataLayout &DL) {
-
-  IntrusiveRefCntPtr<DiagnosticIDs> DiagID(new DiagnosticIDs());
-  // Buffer diagnostics from argument parsing so that we can output them using a
-  // well formed diagnostic object.
-  IntrusiveRefCntPtr<DiagnosticOptions> DiagOpts = new DiagnosticOptions();
-  TextDiagnosticBuffer *DiagsBuffer = new TextDiagnosticBuffer;
-  DiagnosticsEngine Diags(DiagID, &*DiagOpts, DiagsBuffer);
-
-  bool Success;
-  //{
-  const char *binary = Argv0; // CudaLower ? "clang++" : "clang";
-  const unique_ptr<Driver> driver(
-      new Driver(binary, llvm::sys::getDefaultTargetTriple(), Diags));
+#include "mlir/IR/Threading.h"
+
+/// Build the clang driver command line shared by all frontend invocations
+/// for `filenames`, without the action flag.
+static std::vector<const char *> getClangArgs(const char *binary,
+                                              ArrayRef<std::string> filenames,
+                                              ArrayRef<std::string> includeDirs,
+                                              ArrayRef<std::string> defines) {
   std::vector<const char *> Argv;
   Argv.push_back(binary);
   for (auto a : filenames) {
@@ -5520,6 +6164,15 @@ static bool parseMLIR(const char *Argv0, std::vector<std::string> filenames,
   }
   if (FOpenMP)
     Argv.push_back("-fopenmp");
+  if (FastMath)
+    Argv.push_back("-ffast-math");
+  if (FPContract != "") {
+    auto a = "-ffp-contract=" + FPContract;
+    char *chars = (char *)malloc(a.length() + 1);
+    memcpy(chars, a.data(), a.length());
+    chars[a.length()] = 0;
+    Argv.push_back(chars);
+  }
   if (TargetTripleOpt != "") {
     char *chars = (char *)malloc(TargetTripleOpt.length() + 1);
     memcpy(chars, TargetTripleOpt.data(), TargetTripleOpt.length());
@@ -5607,7 +6260,50 @@ static bool parseMLIR(const char *Argv0, std::vector<std::string> filenames,
     Argv.push_back("-include");
     Argv.push_back(chars);
   }
+  if (IncludePCH != "") {
+    char *chars = (char *)malloc(IncludePCH.length() + 1);
+    memcpy(chars, IncludePCH.data(), IncludePCH.length());
+    chars[IncludePCH.length()] = 0;
+    Argv.push_back("-include-pch");
+    Argv.push_back(chars);
+  }
+  if (FModules) {
+    Argv.push_back("-fmodules");
+  }
+  if (ModulesCachePath != "") {
+    auto a = "-fmodules-cache-path=" + ModulesCachePath;
+    char *chars = (char *)malloc(a.length() + 1);
+    memcpy(chars, a.data(), a.length());
+    chars[a.length()] = 0;
+    Argv.push_back(chars);
+  }
+
+  return Argv;
+}
 
+/// Run the clang driver over `filenames` and lower every resulting job into
+/// `module` through `Act`.
+static bool parseMLIRInputs(MLIRAction &Act, const char *Argv0,
+                            ArrayRef<std::string> filenames,
+                            ArrayRef<std::string> includeDirs,
+                            ArrayRef<std::string> defines,
+                            mlir::OwningOpRef<mlir::ModuleOp> &module,
+                            llvm::Triple &triple, llvm::DataLayout &DL) {
+
+  IntrusiveRefCntPtr<DiagnosticIDs> DiagID(new DiagnosticIDs());
+  // Buffer diagnostics from argument parsing so that we can output them using a
+  // well formed diagnostic object.
+  IntrusiveRefCntPtr<DiagnosticOptions> DiagOpts = new DiagnosticOptions();
+  TextDiagnosticBuffer *DiagsBuffer = new TextDiagnosticBuffer;
+  DiagnosticsEngine Diags(DiagID, &*DiagOpts, DiagsBuffer);
+
+  bool Success;
+  //{
+  const char *binary = Argv0; // CudaLower ? "clang++" : "clang";
+  const unique_ptr<Driver> driver(
+      new Driver(binary, llvm::sys::getDefaultTargetTriple(), Diags));
+  std::vector<const char *> Argv =
+      getClangArgs(binary, filenames, includeDirs, defines);
   Argv.push_back("-emit-ast");
 
   const unique_ptr<Compilation> compilation(
@@ -5616,8 +6312,6 @@ static bool parseMLIR(const char *Argv0, std::vector<std::string> filenames,
   if (Jobs.size() < 1)
     return false;
 
-  MLIRAction Act(fn, module);
-
   for (auto &job : Jobs) {
     std::unique_ptr<CompilerInstance> Clang(new CompilerInstance());
 
@@ -5630,6 +6324,11 @@ static bool parseMLIR(const char *Argv0, std::vector<std::string> filenames,
     Clang->getInvocation().getCodeGenOpts().OpaquePointers = false;
     Success = CompilerInvocation::CreateFromArgs(Clang->getInvocation(), *args,
                                                  Diags);
+    // The optimization level decides which semantic guarantees of the
+    // source, such as strict aliasing, the frontend records. Unlike -O, it
+    // leaves preprocessing alone, e.g. __OPTIMIZE__ stays undefined.
+    Clang->getInvocation().getCodeGenOpts().OptimizationLevel =
+        Opt3 ? 3 : Opt2 ? 2 : Opt1 ? 1 : 0;
     Clang->getInvocation().getFrontendOpts().DisableFree = false;
 
     void *GetExecutablePathVP = (void *)(intptr_t)GetExecutablePath;
@@ -5717,6 +6416,41 @@ static bool parseMLIR(const char *Argv0, std::vector<std::string> filenames,
             "polygeist.target-features",
             StringAttr::get(module->getContext(), llvm::join(Features, ",")));
       }
+
+      // Record the code generation options that shape the object code, so
+      // that the backend can configure its target machine like clang does.
+      const auto &CGOpts = Clang->getCodeGenOpts();
+      llvm::FPOpFusion::FPOpFusionMode FPFusion = llvm::FPOpFusion::Standard;
+      switch (Clang->getLangOpts().getDefaultFPContractMode()) {
+      case LangOptions::FPM_Off:
+        FPFusion = llvm::FPOpFusion::Strict;
+        break;
+      case LangOptions::FPM_On:
+      case LangOptions::FPM_FastHonorPragmas:
+        FPFusion = llvm::FPOpFusion::Standard;
+        break;
+      case LangOptions::FPM_Fast:
+        FPFusion = llvm::FPOpFusion::Fast;
+        break;
+      }
+      mlir::Builder B(module->getContext());
+      module.get()->setAttr(
+          "polygeist.target-options",
+          B.getDictionaryAttr({
+              B.getNamedAttr("float-abi", B.getStringAttr(CGOpts.FloatABI)),
+              B.getNamedAttr("reloc-model",
+                             B.getI32IntegerAttr(CGOpts.RelocationModel)),
+              B.getNamedAttr("code-model", B.getStringAttr(CGOpts.CodeModel)),
+              B.getNamedAttr("fp-contract", B.getI32IntegerAttr(FPFusion)),
+              B.getNamedAttr("use-init-array",
+                             B.getBoolAttr(CGOpts.UseInitArray)),
+              B.getNamedAttr("function-sections",
+                             B.getBoolAttr(CGOpts.FunctionSections)),
+              B.getNamedAttr("data-sections",
+                             B.getBoolAttr(CGOpts.DataSections)),
+              B.getNamedAttr("unique-section-names",
+                             B.getBoolAttr(CGOpts.UniqueSectionNames)),
+          }));
     }
 
     for (const auto &FIF : Clang->getFrontendOpts().Inputs) {
@@ -5734,8 +6468,326 @@ static bool parseMLIR(const char *Argv0, std::vector<std::string> filenames,
         assert(Clang->hasSourceManager());
 
         Act.EndSourceFile();
+        if (Clang->getDiagnostics().hasErrorOccurred())
+          return false;
       }
     }
   }
   return true;
 }
+
+/// Preprocess `filename` with the flags used for lowering and append the
+/// result to `out`. Fails if clang does not produce exactly one preprocessed
+/// output, e.g. for CUDA inputs with separate host and device passes.
+static bool preprocessInput(const char *Argv0, StringRef filename,
+                            ArrayRef<std::string> includeDirs,
+                            ArrayRef<std::string> defines, std::string &out) {
+  IntrusiveRefCntPtr<DiagnosticIDs> DiagID(new DiagnosticIDs());
+  IntrusiveRefCntPtr<DiagnosticOptions> DiagOpts = new DiagnosticOptions();
+  TextDiagnosticBuffer *DiagsBuffer = new TextDiagnosticBuffer;
+  DiagnosticsEngine Diags(DiagID, &*DiagOpts, DiagsBuffer);
+
+  // The cc1 job runs as a subprocess: running it in-process would reset the
+  // cgeist options that are still needed for this compilation.
+  std::string binary = GetExecutablePath(Argv0, /*CanonicalPrefixes*/ true);
+  Driver driver(binary, llvm::sys::getDefaultTargetTriple(), Diags);
+
+  auto tmpFile = llvm::sys::fs::TempFile::create("/tmp/preprocessed%%%%%%%.i");
+  if (!tmpFile) {
+    llvm::consumeError(tmpFile.takeError());
+    return false;
+  }
+  std::vector<const char *> Argv =
+      getClangArgs(binary.c_str(), filename.str(), includeDirs, defines);
+  Argv.push_back("-E");
+  Argv.push_back("-o");
+  Argv.push_back(tmpFile->TmpName.c_str());
+
+  bool success = false;
+  {
+    const unique_ptr<Compilation> compilation(
+        driver.BuildCompilation(llvm::ArrayRef<const char *>(Argv)));
+    SmallVector<std::pair<int, const Command *>, 4> FailingCommands;
+    if (compilation && !Diags.hasErrorOccurred() &&
+        compilation->getJobs().size() == 1 &&
+        !driver.ExecuteCompilation(*compilation, FailingCommands) &&
+        FailingCommands.empty()) {
+      if (auto buffer = llvm::MemoryBuffer::getFile(tmpFile->TmpName)) {
+        out += (*buffer)->getBuffer();
+        success = true;
+      }
+    }
+  }
+  if (tmpFile->discard())
+    return false;
+  return success;
+}
+
+/// Write a precompiled header for the headers in `filenames` to `output`,
+/// using the flags used for lowering so that -include-pch accepts it.
+static int emitPrecompiledHeader(const char *Argv0,
+                                 ArrayRef<std::string> filenames,
+                                 ArrayRef<std::string> includeDirs,
+                                 ArrayRef<std::string> defines,
+                                 const std::string &output) {
+  IntrusiveRefCntPtr<DiagnosticIDs> DiagID(new DiagnosticIDs());
+  IntrusiveRefCntPtr<DiagnosticOptions> DiagOpts = new DiagnosticOptions();
+  TextDiagnosticPrinter *DiagPrinter =
+      new TextDiagnosticPrinter(llvm::errs(), &*DiagOpts);
+  DiagnosticsEngine Diags(DiagID, &*DiagOpts, DiagPrinter);
+
+  // As for preprocessing, the cc1 job has to run as a subprocess.
+  std::string binary = GetExecutablePath(Argv0, /*CanonicalPrefixes*/ true);
+  Driver driver(binary, llvm::sys::getDefaultTargetTriple(), Diags);
+
+  std::vector<const char *> Argv =
+      getClangArgs(binary.c_str(), filenames, includeDirs, defines);
+  Argv.push_back("-o");
+  Argv.push_back(output.c_str());
+
+  int res = 1;
+  const unique_ptr<Compilation> compilation(
+      driver.BuildCompilation(llvm::ArrayRef<const char *>(Argv)));
+  SmallVector<std::pair<int, const Command *>, 4> FailingCommands;
+  if (compilation && !Diags.hasErrorOccurred())
+    res = driver.ExecuteCompilation(*compilation, FailingCommands);
+  Diags.getClient()->finish();
+  return res;
+}
+
+/// The keys of `map` in sorted order. Merging visits symbols in this order so
+/// that colliding symbols are renamed the same way on every run.
+template <typename T>
+static std::vector<StringRef> sortedKeys(const llvm::StringMap<T> &map) {
+  std::vector<StringRef> keys;
+  keys.reserve(map.size());
+  for (auto &entry : map)
+    keys.push_back(entry.getKey());
+  llvm::sort(keys);
+  return keys;
+}
+
+/// Fold the module of a separately lowered translation unit into `dest`,
+/// resolving duplicates through the symbol maps of both actions. A definition
+/// replaces a declaration; otherwise the symbol already in `dest` wins, as it
+/// would have when all inputs shared one action. Internal definitions never
+/// resolve references of another unit, so when one collides, the internal one
+/// is renamed instead.
+static void mergeTranslationUnit(MLIRAction &destAct, ModuleOp dest,
+                                 MLIRAction &srcAct, ModuleOp src,
+                                 unsigned unitIdx) {
+  SymbolTable destSymbols(dest);
+  SymbolTable srcSymbols(src);
+
+  auto isDeclaration = [](Operation *op) {
+    if (auto F = dyn_cast<mlir::func::FuncOp>(op))
+      return F.isExternal();
+    if (auto F = dyn_cast<LLVM::LLVMFuncOp>(op))
+      return F.isExternal();
+    if (auto G = dyn_cast<memref::GlobalOp>(op))
+      return G.isExternal();
+    if (auto G = dyn_cast<LLVM::GlobalOp>(op))
+      return !G.getValueOrNull() && G.getInitializerRegion().empty();
+    return false;
+  };
+
+  // Whether `op` defines a symbol with internal linkage, e.g. a `static`
+  // function or variable. Private declarations refer to external symbols.
+  auto isInternal = [&](Operation *op) {
+    if (isDeclaration(op))
+      return false;
+    auto isLocal = [](LLVM::Linkage linkage) {
+      return linkage == LLVM::Linkage::Internal ||
+             linkage == LLVM::Linkage::Private;
+    };
+    if (auto F = dyn_cast<LLVM::LLVMFuncOp>(op))
+      return isLocal(F.getLinkage());
+    if (auto G = dyn_cast<LLVM::GlobalOp>(op))
+      return isLocal(G.getLinkage());
+    return SymbolTable::getSymbolVisibility(op) ==
+           SymbolTable::Visibility::Private;
+  };
+
+  // Renames `op`, a symbol of `within`, along with its uses there.
+  auto renameUnique = [&](Operation *op, ModuleOp within) {
+    StringRef name = SymbolTable::getSymbolName(op).getValue();
+    std::string newName;
+    unsigned suffix = unitIdx;
+    do {
+      newName = (name + "." + Twine(suffix++)).str();
+    } while (dest.lookupSymbol(newName) || src.lookupSymbol(newName));
+    auto newAttr = StringAttr::get(src.getContext(), newName);
+    if (failed(SymbolTable::replaceAllSymbolUses(op, newAttr, within)))
+      llvm::errs() << "warning: could not rename uses of " << name << "\n";
+    SymbolTable::setSymbolName(op, newAttr);
+  };
+
+  // Returns the op that now represents the symbol in the merged module.
+  auto resolve = [&](Operation *existing, Operation *incoming) -> Operation * {
+    if (!existing)
+      return incoming;
+    // Two internal definitions, or an internal and an external symbol, are
+    // distinct entities, e.g. `static` functions of the same name in
+    // different files.
+    if (isInternal(incoming)) {
+      renameUnique(incoming, src);
+      return existing;
+    }
+    if (isInternal(existing)) {
+      destSymbols.remove(existing);
+      renameUnique(existing, dest);
+      return incoming;
+    }
+    if (isDeclaration(existing) && !isDeclaration(incoming)) {
+      destSymbols.erase(existing);
+      return incoming;
+    }
+    srcSymbols.erase(incoming);
+    return existing;
+  };
+
+  // Distinct string constants may reuse the same "strN" name in different
+  // units and have to be renamed before identical ones are redirected.
+  for (StringRef key : sortedKeys(srcAct.llvmStringGlobals)) {
+    LLVM::GlobalOp incoming = srcAct.llvmStringGlobals[key];
+    if (destAct.llvmStringGlobals.count(key))
+      continue;
+    if (destSymbols.lookup(incoming.getSymName()))
+      renameUnique(incoming, src);
+  }
+  for (StringRef key : sortedKeys(srcAct.llvmStringGlobals)) {
+    LLVM::GlobalOp incoming = srcAct.llvmStringGlobals[key];
+    auto found = destAct.llvmStringGlobals.find(key);
+    if (found == destAct.llvmStringGlobals.end()) {
+      destAct.llvmStringGlobals[key] = incoming;
+      continue;
+    }
+    if (failed(SymbolTable::replaceAllSymbolUses(
+            incoming, found->second.getSymNameAttr(), src)))
+      llvm::errs() << "warning: could not merge string global "
+                   << incoming.getSymName() << "\n";
+    srcSymbols.erase(incoming);
+  }
+
+  for (StringRef key : sortedKeys(srcAct.functions)) {
+    auto &slot = destAct.functions[key];
+    slot = cast<mlir::func::FuncOp>(resolve(slot, srcAct.functions[key]));
+  }
+  for (StringRef key : sortedKeys(srcAct.llvmFunctions)) {
+    auto &slot = destAct.llvmFunctions[key];
+    slot = cast<LLVM::LLVMFuncOp>(resolve(slot, srcAct.llvmFunctions[key]));
+  }
+  for (StringRef key : sortedKeys(srcAct.llvmGlobals)) {
+    auto &slot = destAct.llvmGlobals[key];
+    slot = cast<LLVM::GlobalOp>(resolve(slot, srcAct.llvmGlobals[key]));
+  }
+  for (StringRef key : sortedKeys(srcAct.globals)) {
+    auto incoming = srcAct.globals[key];
+    auto found = destAct.globals.find(key);
+    if (found == destAct.globals.end()) {
+      destAct.globals[key] = incoming;
+      continue;
+    }
+    found->second.first = cast<memref::GlobalOp>(
+        resolve(found->second.first, incoming.first));
+  }
+
+  // Whatever is left was created outside the maps (e.g. global initializer
+  // functions or runtime declarations).
+  LLVM::GlobalCtorsOp destCtors;
+  for (auto C : dest.getOps<LLVM::GlobalCtorsOp>())
+    destCtors = C;
+  for (Operation &op : llvm::make_early_inc_range(*src.getBody())) {
+    if (auto C = dyn_cast<LLVM::GlobalCtorsOp>(op)) {
+      if (!destCtors)
+        continue;
+      SmallVector<mlir::Attribute> funcs(destCtors.getCtors().begin(),
+                                         destCtors.getCtors().end());
+      SmallVector<mlir::Attribute> idxs(destCtors.getPriorities().begin(),
+                                        destCtors.getPriorities().end());
+      funcs.append(C.getCtors().begin(), C.getCtors().end());
+      idxs.append(C.getPriorities().begin(), C.getPriorities().end());
+      mlir::OpBuilder builder(C);
+      destCtors.setCtorsAttr(builder.getArrayAttr(funcs));
+      destCtors.setPrioritiesAttr(builder.getArrayAttr(idxs));
+      C->erase();
+      continue;
+    }
+    auto nameAttr =
+        op.getAttrOfType<StringAttr>(SymbolTable::getSymbolAttrName());
+    if (!nameAttr)
+      continue;
+    Operation *existing = destSymbols.lookup(nameAttr.getValue());
+    if (!existing)
+      continue;
+    resolve(existing, &op);
+  }
+
+  dest.getBody()->getOperations().splice(dest.getBody()->end(),
+                                         src.getBody()->getOperations());
+}
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+/// Hand the memory freed by the frontend back to the operating system. Each
+/// input's compiler instance, AST and CodeGenModule are destroyed once it is
+/// lowered, and returning their pages shrinks the resident set of the rest of
+/// the compilation, e.g. for a compile server or concurrent builds. It cannot
+/// lower the peak, which the frontend has usually reached by then.
+static void releaseFrontendMemory() {
+#ifdef __GLIBC__
+  malloc_trim(0);
+#endif
+}
+
+static bool parseMLIR(const char *Argv0, std::vector<std::string> filenames,
+                      std::string fn, std::vector<std::string> includeDirs,
+                      std::vector<std::string> defines,
+                      mlir::OwningOpRef<mlir::ModuleOp> &module,
+                      llvm::Triple &triple, llvm::DataLayout &DL) {
+  MLIRAction Act(fn, module);
+  MLIRContext *ctx = module->getContext();
+  if (filenames.size() < 2 || !ctx->isMultithreadingEnabled())
+    return parseMLIRInputs(Act, Argv0, filenames, includeDirs, defines, module,
+                           triple, DL);
+
+  // Each input is lowered by its own compiler instance into its own module.
+  // The context is shared, which is safe since multithreading is enabled.
+  struct TranslationUnit {
+    mlir::OwningOpRef<mlir::ModuleOp> module;
+    std::unique_ptr<MLIRAction> Act;
+    llvm::Triple triple;
+    llvm::DataLayout DL{""};
+    bool success = false;
+  };
+  std::vector<TranslationUnit> units(filenames.size());
+  for (auto &TU : units) {
+    TU.module = mlir::ModuleOp::create(mlir::OpBuilder(ctx).getUnknownLoc());
+    TU.Act = std::make_unique<MLIRAction>(fn, TU.module);
+  }
+  mlir::parallelForEachN(ctx, 0, units.size(), [&](size_t i) {
+    auto &TU = units[i];
+    TU.success = parseMLIRInputs(*TU.Act, Argv0, filenames[i], includeDirs,
+                                 defines, TU.module, TU.triple, TU.DL);
+  });
+
+  // Merge in command-line order so the result does not depend on scheduling.
+  bool success = true;
+  for (auto en : llvm::enumerate(units)) {
+    auto &TU = en.value();
+    success &= TU.success;
+    if (!TU.success)
+      continue;
+    if (triple.str() == "" || !TU.triple.isNVPTX()) {
+      triple = TU.triple;
+      DL = TU.DL;
+      for (auto attr : TU.module->getOperation()->getAttrs())
+        module->getOperation()->setAttr(attr.getName(), attr.getValue());
+    }
+    mergeTranslationUnit(Act, module.get(), *TU.Act, TU.module.get(),
+                         en.index());
+  }
+  return success;
+}
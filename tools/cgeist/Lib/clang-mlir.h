@@ -10,6 +10,8 @@
 #define CLANG_MLIR_H
 
 #include "AffineUtils.h"
+#include "FunctionCache.h"
+#include "LocalAnalysis.h"
 #include "ValueCategory.h"
 #include "mlir/Dialect/Affine/IR/AffineOps.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"
@@ -18,6 +20,7 @@
 #include "mlir/Dialect/LLVMIR/NVVMDialect.h"
 #include "mlir/Dialect/Math/IR/Math.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
+#include "mlir/Dialect/OpenMP/OpenMPDialect.h"
 #include "mlir/IR/Builders.h"
 #include "mlir/IR/MLIRContext.h"
 #include "mlir/IR/OpDefinition.h"
@@ -32,6 +35,9 @@
 #include "clang/Lex/HeaderSearchOptions.h"
 #include "clang/Lex/Preprocessor.h"
 #include "clang/Lex/PreprocessorOptions.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/Support/CommandLine.h"
 
@@ -43,20 +49,32 @@ using namespace clang;
 using namespace mlir;
 
 extern llvm::cl::opt<std::string> PrefixABI;
+extern llvm::cl::opt<bool> DirectSSA;
 
 struct LoopContext {
   mlir::Value keepRunning;
   mlir::Value noBreak;
 };
 
+/// A variable of an OpenMP reduction clause, privatized for the construct.
+struct OMPReduction {
+  enum Kind { Add, Mul, And, Or, Xor, Min, Max };
+  Kind kind;
+  clang::VarDecl *var;
+  /// The variable the private copies are combined into.
+  ValueCategory shared;
+  /// Whether min and max compare as signed integers.
+  bool isSigned;
+};
+
 struct MLIRASTConsumer : public ASTConsumer {
-  std::set<std::string> &emitIfFound;
-  std::set<std::string> &done;
-  std::map<std::string, mlir::LLVM::GlobalOp> &llvmStringGlobals;
-  std::map<std::string, std::pair<mlir::memref::GlobalOp, bool>> &globals;
-  std::map<std::string, mlir::func::FuncOp> &functions;
-  std::map<std::string, mlir::LLVM::GlobalOp> &llvmGlobals;
-  std::map<std::string, mlir::LLVM::LLVMFuncOp> &llvmFunctions;
+  llvm::StringSet<> &emitIfFound;
+  llvm::StringSet<> &done;
+  llvm::StringMap<mlir::LLVM::GlobalOp> &llvmStringGlobals;
+  llvm::StringMap<std::pair<mlir::memref::GlobalOp, bool>> &globals;
+  llvm::StringMap<mlir::func::FuncOp> &functions;
+  llvm::StringMap<mlir::LLVM::GlobalOp> &llvmGlobals;
+  llvm::StringMap<mlir::LLVM::LLVMFuncOp> &llvmFunctions;
   Preprocessor &PP;
   ASTContext &astContext;
   mlir::OwningOpRef<mlir::ModuleOp> &module;
@@ -67,6 +85,7 @@ struct MLIRASTConsumer : public ASTConsumer {
   CodeGen::CodeGenModule CGM;
   bool error;
   ScopLocList scopLocList;
+  IvdepLocList ivdepLocList;
   LowerToInfo LTInfo;
 
   /// The stateful type translator (contains named structs).
@@ -74,12 +93,12 @@ struct MLIRASTConsumer : public ASTConsumer {
   LLVM::TypeToLLVMIRTranslator reverseTypeTranslator;
 
   MLIRASTConsumer(
-      std::set<std::string> &emitIfFound, std::set<std::string> &done,
-      std::map<std::string, mlir::LLVM::GlobalOp> &llvmStringGlobals,
-      std::map<std::string, std::pair<mlir::memref::GlobalOp, bool>> &globals,
-      std::map<std::string, mlir::func::FuncOp> &functions,
-      std::map<std::string, mlir::LLVM::GlobalOp> &llvmGlobals,
-      std::map<std::string, mlir::LLVM::LLVMFuncOp> &llvmFunctions,
+      llvm::StringSet<> &emitIfFound, llvm::StringSet<> &done,
+      llvm::StringMap<mlir::LLVM::GlobalOp> &llvmStringGlobals,
+      llvm::StringMap<std::pair<mlir::memref::GlobalOp, bool>> &globals,
+      llvm::StringMap<mlir::func::FuncOp> &functions,
+      llvm::StringMap<mlir::LLVM::GlobalOp> &llvmGlobals,
+      llvm::StringMap<mlir::LLVM::LLVMFuncOp> &llvmFunctions,
       Preprocessor &PP, ASTContext &astContext,
       mlir::OwningOpRef<mlir::ModuleOp> &module, clang::SourceManager &SM,
       CodeGenOptions &codegenops)
@@ -96,6 +115,7 @@ struct MLIRASTConsumer : public ASTConsumer {
     addPragmaScopHandlers(PP, scopLocList);
     addPragmaEndScopHandlers(PP, scopLocList);
     addPragmaLowerToHandlers(PP, LTInfo);
+    addPragmaIvdepHandlers(PP, ivdepLocList);
   }
 
   ~MLIRASTConsumer() {}
@@ -104,7 +124,27 @@ struct MLIRASTConsumer : public ASTConsumer {
                                              bool getDeviceStub = false);
 
   mlir::LLVM::LLVMFuncOp GetOrCreateLLVMFunction(const FunctionDecl *FD);
+
+  /// The symbol name of `FD`, naming constructors and destructors after
+  /// their complete-object variant. Names are mangled once per declaration.
+  StringRef getMangledFunctionName(const FunctionDecl *FD);
+  llvm::DenseMap<const FunctionDecl *, StringRef> mangledNames;
+
+  /// Whether -emit-reachable-only keeps `-function=*` from treating the
+  /// definition `fd` as a root.
+  bool isSkippedRoot(const FunctionDecl *fd);
+
+  /// Whether -emit-reachable-only makes the function `name` private so that
+  /// it can be dropped once no caller refers to it. Only definitions that
+  /// other translation units do not rely on qualify.
+  bool isDiscardableCallee(StringRef name, mlir::LLVM::Linkage lnk);
+
   mlir::LLVM::LLVMFuncOp GetOrCreateFreeFunction();
+
+  /// Declare the external runtime function `name` of type `type`, unless the
+  /// translation unit already declares it.
+  mlir::func::FuncOp GetOrCreateRuntimeFunction(StringRef name,
+                                                mlir::FunctionType type);
   mlir::Value CallMalloc(mlir::OpBuilder &builder, mlir::Location loc,
                          mlir::Value arg);
 
@@ -116,6 +156,8 @@ struct MLIRASTConsumer : public ASTConsumer {
   mlir::Value GetOrCreateGlobalLLVMString(mlir::Location loc,
                                           mlir::OpBuilder &builder,
                                           StringRef value);
+  mlir::LLVM::GlobalOp GetOrCreateGlobalLLVMStringOp(mlir::Location loc,
+                                                     StringRef value);
 
   std::pair<mlir::memref::GlobalOp, bool>
   GetOrCreateGlobal(const ValueDecl *VD, std::string prefix,
@@ -125,6 +167,17 @@ struct MLIRASTConsumer : public ASTConsumer {
 
   void run();
 
+  /// Fill in the body of `function` from the per-function lowering cache,
+  /// recreating the symbols it refers to. Returns false on a miss.
+  bool lowerFromFunctionCache(mlir::func::FuncOp function, StringRef key,
+                              ArrayRef<const FunctionDecl *> callees,
+                              const mlirclang::FunctionCacheLocation &location);
+
+  /// Store the lowering of `function` together with declarations of the
+  /// symbols it refers to.
+  void storeInFunctionCache(mlir::func::FuncOp function, StringRef key,
+                            const mlirclang::FunctionCacheLocation &location);
+
   void HandleTranslationUnit(clang::ASTContext &Context) override;
 
   bool HandleTopLevelDecl(DeclGroupRef dg) override;
@@ -135,9 +188,19 @@ struct MLIRASTConsumer : public ASTConsumer {
   mlir::Type getMLIRType(clang::QualType t, bool *implicitRef = nullptr,
                          bool allowMerge = true);
 
+  /// Types already converted by getMLIRType, keyed by the qualified type and
+  /// `allowMerge`, along with whether they are implicit references.
+  llvm::DenseMap<std::pair<void *, unsigned>, std::pair<mlir::Type, bool>>
+      convertedTypes;
+  mlir::Type convertMLIRType(clang::QualType t, bool *implicitRef,
+                             bool allowMerge);
+
   llvm::Type *getLLVMType(clang::QualType t);
 
   mlir::Location getMLIRLocation(clang::SourceLocation loc);
+
+  /// File name attributes of the files locations were created in.
+  llvm::DenseMap<clang::FileID, mlir::StringAttr> fileNames;
 };
 
 class MLIRScanner : public StmtVisitor<MLIRScanner, ValueCategory> {
@@ -151,6 +214,77 @@ private:
   std::vector<LoopContext> loops;
   mlir::Block *allocationScope;
 
+  /// Parameters and locals bound to the SSA value of their argument or
+  /// initializer instead of a stack slot, see mlirclang::findSSALocals.
+  llvm::SmallPtrSet<const VarDecl *, 8> ssaLocals;
+
+  /// Store `val` to `lhs`, the lvalue of the assigned expression `E`, and
+  /// return the result of the assignment. A local bound to an SSA value is
+  /// rebound to `val` instead.
+  ValueCategory assign(mlir::Location loc, clang::Expr *E, ValueCategory lhs,
+                       mlir::Value val);
+
+  /// The locals bound to SSA values that `loop` reassigns, in a fixed order.
+  /// Its header block takes them as arguments.
+  llvm::SmallVector<const VarDecl *> getLoopCarriedLocals(clang::Stmt *loop);
+
+  /// The current values of `locals`.
+  llvm::SmallVector<mlir::Value>
+  getLocalValues(llvm::ArrayRef<const VarDecl *> locals);
+
+  /// Bind each of `locals` to the corresponding value of `values`.
+  void rebindLocals(llvm::ArrayRef<const VarDecl *> locals,
+                    mlir::ValueRange values);
+
+  /// Add an argument to `header` for each of `locals` and rebind them to it.
+  /// Returns the new arguments.
+  llvm::SmallVector<mlir::Value>
+  bindBlockArguments(mlir::Block *header,
+                     llvm::ArrayRef<const VarDecl *> locals,
+                     mlir::Location loc);
+
+  /// Create the flags tracking breaks and continues of a loop with body
+  /// `body`, or an empty context if the body cannot leave the loop early.
+  LoopContext createLoopContext(mlir::Location loc, clang::Stmt *body);
+
+  /// Attributes of the statement being visited, consumed by the loop they
+  /// annotate.
+  llvm::ArrayRef<const clang::Attr *> loopAttrs;
+
+  /// The hints of the loop starting at `loc` given by its loop attributes and
+  /// the ivdep pragmas preceding it, or null if there are none.
+  mlir::DictionaryAttr getLoopHints(clang::SourceLocation loc);
+
+  /// Number of constant tables created for array initializers of this
+  /// function, used to name them.
+  unsigned numConstantInits = 0;
+
+  /// Initialize the local array `toInit` from `expr` with a single memset if
+  /// all of it is zero or a copy from a constant table if all of it is
+  /// constant, returning the constant. Otherwise `toInit` is zeroed if the
+  /// array filler of `expr` is zero, recorded in `zeroFilled`, so that only
+  /// the explicit elements remain to be stored.
+  mlir::DenseElementsAttr initializeInBulk(mlir::Value toInit,
+                                           clang::InitListExpr *expr,
+                                           bool &zeroFilled);
+
+  /// The strict-aliasing type class of accesses through `lvalue`, or null if
+  /// they may alias objects of any type.
+  mlir::StringAttr getTypeTag(const clang::Expr *lvalue);
+
+  /// Tag the loads and stores of `addr` from `begin` up to the insertion
+  /// point with the type class of `lvalue`.
+  void tagAccesses(mlir::Block::iterator begin, mlir::Value addr,
+                   const clang::Expr *lvalue);
+
+  /// Mark the integer arithmetic producing `res`, the value of `E`, as free
+  /// of signed overflow if C leaves that overflow undefined. Returns `res`.
+  mlir::Value noSignedWrap(mlir::Value res, const clang::Expr *E);
+
+  /// Attach the fast-math flags that the floating-point options in effect
+  /// for `E` allow to the operation producing `res`. Returns `res`.
+  mlir::Value fastMath(mlir::Value res, const clang::Expr *E);
+
   std::map<const void *, std::vector<mlir::LLVM::AllocaOp>> bufs;
   mlir::LLVM::AllocaOp allocateBuffer(size_t i, mlir::LLVM::LLVMPointerType t) {
     auto &vec = bufs[t.getAsOpaquePointer()];
@@ -198,12 +332,82 @@ private:
   bool getConstantStep(clang::ForStmt *fors,
                        mlirclang::AffineLoopDescriptor &descr);
 
-  void buildAffineLoop(clang::ForStmt *fors, mlir::Location loc,
-                       const mlirclang::AffineLoopDescriptor &descr);
-
-  void buildAffineLoopImpl(clang::ForStmt *fors, mlir::Location loc,
-                           mlir::Value lb, mlir::Value ub,
-                           const mlirclang::AffineLoopDescriptor &descr);
+  mlir::AffineForOp
+  buildAffineLoop(clang::ForStmt *fors, mlir::Location loc,
+                  const mlirclang::AffineLoopDescriptor &descr);
+
+  mlir::AffineForOp
+  buildAffineLoopImpl(clang::ForStmt *fors, mlir::Location loc,
+                      mlir::Value lb, mlir::Value ub,
+                      const mlirclang::AffineLoopDescriptor &descr);
+
+  /// Emit `body` in an OpenMP parallel region, with the number of threads
+  /// and their affinity given by the clauses of `dir`.
+  void buildOMPParallel(clang::OMPExecutableDirective *dir,
+                        llvm::function_ref<void()> body);
+
+  /// Emit `body` in an OpenMP task, with the variables of the private and
+  /// firstprivate clauses of `dir` bound to copies local to the task.
+  void buildOMPTask(clang::OMPExecutableDirective *dir,
+                    llvm::function_ref<void()> body);
+
+  /// Emit the pre-initializations of `fors` and compute the lower and upper
+  /// bounds and the steps of its loops as indices.
+  void buildOMPLoopBounds(clang::OMPLoopDirective *fors,
+                          llvm::SmallVectorImpl<mlir::Value> &inits,
+                          llvm::SmallVectorImpl<mlir::Value> &finals,
+                          llvm::SmallVectorImpl<mlir::Value> &incs);
+
+  /// Bind the loop counters of `fors` to locals holding the induction
+  /// variables `inds`, saving their previous bindings in `prev`.
+  void privatizeCounters(clang::OMPLoopDirective *fors, mlir::ValueRange inds,
+                         std::map<const ValueDecl *, ValueCategory> &prev);
+
+  /// The chunk size of the schedule clause of `fors` as an index, or null.
+  mlir::Value buildScheduleChunk(clang::OMPLoopDirective *fors);
+
+  /// Set the schedule of `loop` from the schedule clause of `fors`, with
+  /// chunks of `chunk` iterations if not null.
+  void setScheduleClause(mlir::omp::WsLoopOp loop,
+                         clang::OMPLoopDirective *fors, mlir::Value chunk);
+
+  /// Emit the body of `fors` for the counters `outerInds` of its outer loops
+  /// and the sequential loops with bounds `lbs`, `ubs` and `incs` over the
+  /// remaining ones. The innermost of these carries the loop hints `hints`.
+  void buildOMPLoopBody(clang::OMPLoopDirective *fors,
+                        llvm::ArrayRef<mlir::Value> outerInds,
+                        mlir::ValueRange lbs, mlir::ValueRange ubs,
+                        mlir::ValueRange incs, mlir::DictionaryAttr hints);
+
+  /// Emit the worksharing loop of `fors` with its schedule, without its
+  /// data-sharing clauses.
+  void buildOMPWsLoop(clang::OMPLoopDirective *fors);
+
+  /// Emit the worksharing loop `fors` with its reductions.
+  void buildOMPFor(clang::OMPLoopDirective *fors);
+
+  /// Emit the combined parallel worksharing loop `fors`.
+  void buildOMPParallelFor(clang::OMPLoopDirective *fors);
+
+  /// Emit the alignment assumptions of the aligned clauses of `fors` and
+  /// return the loop hints asking to vectorize it as its simd clauses allow.
+  mlir::DictionaryAttr buildOMPSimdClauses(clang::OMPLoopDirective *fors);
+
+  /// Report a reduction clause the lowering does not handle as an error,
+  /// which fails the compilation once the translation unit is lowered.
+  void reportUnsupportedReduction(clang::SourceLocation loc,
+                                  const llvm::Twine &what);
+
+  /// Bind the variables of the reduction clauses of `dir` to private copies
+  /// initialized to the identity of their reduction, saving their previous
+  /// bindings in `prev`.
+  llvm::SmallVector<OMPReduction>
+  privatizeReductions(clang::OMPExecutableDirective *dir,
+                      std::map<const ValueDecl *, ValueCategory> &prev);
+
+  /// Atomically combine the private copies of `reductions` into their shared
+  /// variables and drop the private bindings.
+  void combineReductions(llvm::ArrayRef<OMPReduction> reductions);
 
 public:
   const FunctionDecl *EmittingFunctionDecl;
@@ -271,11 +475,24 @@ public:
 
   ValueCategory VisitOMPForDirective(clang::OMPForDirective *);
 
+  ValueCategory VisitOMPForSimdDirective(clang::OMPForSimdDirective *fors);
+
+  ValueCategory VisitOMPSimdDirective(clang::OMPSimdDirective *fors);
+
   ValueCategory VisitOMPParallelDirective(clang::OMPParallelDirective *);
 
   ValueCategory
   VisitOMPParallelForDirective(clang::OMPParallelForDirective *fors);
 
+  ValueCategory
+  VisitOMPParallelForSimdDirective(clang::OMPParallelForSimdDirective *fors);
+
+  ValueCategory VisitOMPTaskDirective(clang::OMPTaskDirective *task);
+
+  ValueCategory VisitOMPTaskwaitDirective(clang::OMPTaskwaitDirective *wait);
+
+  ValueCategory VisitOMPTaskLoopDirective(clang::OMPTaskLoopDirective *fors);
+
   ValueCategory VisitWhileStmt(clang::WhileStmt *fors);
 
   ValueCategory VisitDoStmt(clang::DoStmt *fors);
@@ -323,6 +540,9 @@ public:
 
   ValueCategory VisitBinaryOperator(clang::BinaryOperator *BO);
 
+  ValueCategory
+  VisitCompoundAssignOperator(clang::CompoundAssignOperator *CAO);
+
   ValueCategory VisitCXXNoexceptExpr(clang::CXXNoexceptExpr *AS);
 
   ValueCategory VisitAttributedStmt(clang::AttributedStmt *AS);
@@ -233,6 +233,19 @@ struct PragmaEndScopHandler : public PragmaHandler {
   }
 };
 
+/// Handles the #pragma GCC ivdep directive.
+struct PragmaIvdepHandler : public PragmaHandler {
+  IvdepLocList &ivdeps;
+
+  PragmaIvdepHandler(IvdepLocList &ivdeps)
+      : PragmaHandler("ivdep"), ivdeps(ivdeps) {}
+
+  void HandlePragma(Preprocessor &PP, PragmaIntroducer introducer,
+                    Token &ivdepTok) override {
+    ivdeps.add(PP.getSourceManager(), ivdepTok.getLocation());
+  }
+};
+
 } // namespace
 
 void addPragmaLowerToHandlers(Preprocessor &PP, LowerToInfo &LTInfo) {
@@ -246,3 +259,7 @@ void addPragmaScopHandlers(Preprocessor &PP, ScopLocList &scopLocList) {
 void addPragmaEndScopHandlers(Preprocessor &PP, ScopLocList &scopLocList) {
   PP.AddPragmaHandler(new PragmaEndScopHandler(scopLocList));
 }
+
+void addPragmaIvdepHandlers(Preprocessor &PP, IvdepLocList &ivdepLocList) {
+  PP.AddPragmaHandler("GCC", new PragmaIvdepHandler(ivdepLocList));
+}
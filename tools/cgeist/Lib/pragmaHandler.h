@@ -88,9 +88,45 @@ struct ScopLocList {
   }
 };
 
+/// Locations of the "#pragma GCC ivdep" directives, each of which asserts
+/// that the loop that follows it has no loop-carried memory dependences.
+struct IvdepLocList {
+  std::vector<std::pair<clang::FileID, unsigned>> list;
+
+  void add(clang::SourceManager &SM, clang::SourceLocation ivdep) {
+    ivdep = SM.getExpansionLoc(ivdep);
+    list.emplace_back(SM.getFileID(ivdep), SM.getExpansionLineNumber(ivdep));
+  }
+
+  // Check if an ivdep pragma precedes the loop starting at "loop", separated
+  // from it by nothing but other pragmas.
+  bool appliesTo(clang::SourceManager &SM, clang::SourceLocation loop) {
+    loop = SM.getExpansionLoc(loop);
+    clang::FileID file = SM.getFileID(loop);
+    unsigned line = SM.getExpansionLineNumber(loop);
+    for (auto &ivdep : list) {
+      if (ivdep.first != file || ivdep.second >= line)
+        continue;
+      bool adjacent = true;
+      for (unsigned l = ivdep.second + 1; adjacent && l < line; ++l) {
+        const char *text =
+            SM.getCharacterData(SM.translateLineCol(file, l, 1));
+        while (*text == ' ' || *text == '\t')
+          ++text;
+        adjacent = *text == '#';
+      }
+      if (adjacent)
+        return true;
+    }
+    return false;
+  }
+};
+
 void addPragmaLowerToHandlers(clang::Preprocessor &PP, LowerToInfo &LTInfo);
 void addPragmaScopHandlers(clang::Preprocessor &PP, ScopLocList &scopLocList);
 void addPragmaEndScopHandlers(clang::Preprocessor &PP,
                               ScopLocList &scopLocList);
+void addPragmaIvdepHandlers(clang::Preprocessor &PP,
+                            IvdepLocList &ivdepLocList);
 
 #endif
@@ -0,0 +1,47 @@
+// RUN: cgeist %s --function=* -S -pass-pipeline="func.func(canonicalize)" | FileCheck %s
+
+int zeros(int i) {
+  int table[256] = {0};
+  return table[i];
+}
+
+int lookup(int i) {
+  int table[32] = {1,  2,  3,  4,  5,  6,  7,  8,  9,  10, 11,
+                   12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22,
+                   23, 24, 25, 26, 27, 28, 29, 30, 31, 32};
+  return table[i];
+}
+
+int partial(int x, int i) {
+  int table[64] = {x, x + 1};
+  return table[i];
+}
+
+// CHECK: memref.global "private" constant @"lookup@const@0" : memref<32xi32> = dense<[1, 2, 3,
+
+// A zero-filled table is cleared by a single loop.
+// CHECK-LABEL: func.func @zeros(
+// CHECK:         memref.alloca() : memref<256xi32>
+// CHECK:         scf.for
+// CHECK:           memref.store
+// CHECK-NOT:     memref.store
+// CHECK:         return
+
+// A constant table is copied from a private global.
+// CHECK-LABEL: func.func @lookup(
+// CHECK:         memref.get_global @"lookup@const@0" : memref<32xi32>
+// CHECK:         scf.for
+// CHECK:           memref.load
+// CHECK:           memref.store
+// CHECK-NOT:     memref.store
+// CHECK:         return
+
+// Only the explicit elements are stored after clearing the table.
+// CHECK-LABEL: func.func @partial(
+// CHECK:         scf.for
+// CHECK:           memref.store
+// CHECK:         memref.store %arg0,
+// CHECK:         arith.addi %arg0
+// CHECK:         memref.store
+// CHECK-NOT:     memref.store
+// CHECK:         return
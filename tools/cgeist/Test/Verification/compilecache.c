@@ -0,0 +1,16 @@
+// RUN: rm -rf %t.cache
+// RUN: cgeist %s -O2 -S -cache-dir=%t.cache -o %t.first.mlir
+// RUN: cgeist %s -O2 -S -cache-dir=%t.cache -o %t.second.mlir -print-cache-stats 2> %t.stats
+// RUN: diff %t.first.mlir %t.second.mlir
+// RUN: FileCheck %s --check-prefix=STATS < %t.stats
+// RUN: cgeist %s -O0 -S -cache-dir=%t.cache -print-cache-stats 2>&1 >/dev/null | FileCheck %s --check-prefix=MISS
+
+// STATS: hits 1
+// STATS-NEXT: misses 1
+// STATS-NEXT: entries 1
+
+// MISS: hits 1
+// MISS-NEXT: misses 2
+// MISS-NEXT: entries 2
+
+int square(int x) { return x * x; }
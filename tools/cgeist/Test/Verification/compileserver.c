@@ -0,0 +1,29 @@
+// Without a server listening on the socket cgeist compiles in-process.
+// RUN: cgeist %s -O2 -S -o %t.local.mlir
+// RUN: env CGEIST_SERVER=%t.nonexistent.sock cgeist %s -O2 -S -o %t.fallback.mlir
+// RUN: diff %t.local.mlir %t.fallback.mlir
+// RUN: env CGEIST_SERVER=%t.nonexistent.sock cgeist %s -O2 -S | FileCheck %s
+
+// A warm server produces the same output through the client's descriptors,
+// and relays the exit status. The socket path is relative to stay short.
+// RUN: rm -rf %t.dir && mkdir %t.dir && cd %t.dir
+// RUN: (timeout 120 cgeist -serve=server.sock < /dev/null > /dev/null 2> server.log & echo $! > server.pid)
+// RUN: for i in $(seq 100); do test -S server.sock && break; sleep 0.1; done
+// RUN: env CGEIST_SERVER=server.sock cgeist %s -O2 -S -o served.mlir
+// RUN: diff %t.local.mlir served.mlir
+// RUN: env CGEIST_SERVER=server.sock cgeist %s -O2 -S > served.stdout.mlir
+// RUN: diff %t.local.mlir served.stdout.mlir
+// RUN: not env CGEIST_SERVER=server.sock cgeist missing.c -O2 -S -o /dev/null
+// RUN: kill $(cat server.pid)
+// RUN: FileCheck %s --check-prefix=SERVER < server.log
+
+// -serve is only recognized as the first argument.
+// RUN: not cgeist %s -O2 -S -serve=server.sock -o /dev/null 2>&1 | FileCheck %s --check-prefix=MISPLACED
+// MISPLACED: error: -serve must be the first argument
+
+// CHECK: func.func @square(%arg0: i32) -> i32
+int square(int x) { return x * x; }
+
+// SERVER: served {{.*}}cgeist {{.*}}compileserver.c -O2 -S -o served.mlir: exit status 0
+// SERVER: served {{.*}}cgeist {{.*}}compileserver.c -O2 -S: exit status 0
+// SERVER: served {{.*}}cgeist missing.c -O2 -S -o /dev/null: exit status {{[1-9][0-9]*}}
@@ -0,0 +1,55 @@
+// RUN: cgeist %s --function=* -S -pass-pipeline="func.func(canonicalize)" | FileCheck %s
+// RUN: cgeist %s --function=* -S -pass-pipeline="func.func(canonicalize)" -direct-ssa=0 | FileCheck %s --check-prefix=ALLOCA
+
+void scale(int n, int *a) {
+  int factor = 2 * n;
+  for (int i = 0; i < n; i++)
+    a[i] = factor * a[i];
+}
+
+int sum(int n, int *a) {
+  int s = 0;
+  int i = 0;
+  do
+    s += a[i];
+  while (++i < n);
+  for (int j = 0; j < n; j++)
+    s -= j;
+  return s;
+}
+
+int find(int n, int *a, int v) {
+  int r = -1;
+  for (int i = 0; i < n; i++)
+    if (a[i] == v) {
+      r = i;
+      break;
+    }
+  return r;
+}
+
+// The induction variable is carried around the loop as a block argument.
+// CHECK-LABEL: func.func @scale(%arg0: i32, %arg1: memref<?xi32>)
+// CHECK-NOT:     memref.alloca
+// CHECK:         arith.muli %arg0
+// CHECK:       ^bb1(%[[I:.+]]: i32):
+// CHECK-NOT:     memref.alloca
+// CHECK:         return
+
+// Reassigned locals live in block arguments of the loop headers.
+// CHECK-LABEL: func.func @sum(%arg0: i32, %arg1: memref<?xi32>) -> i32
+// CHECK-NOT:     memref<1xi32>
+// CHECK:       ^bb{{[0-9]+}}(%[[S:.+]]: i32, %[[I:.+]]: i32):
+// CHECK:         %[[ADD:.+]] = arith.addi %[[S]], %{{.*}} : i32
+// CHECK:       ^bb{{[0-9]+}}(%[[J:.+]]: i32, %[[S2:.+]]: i32):
+// CHECK:         arith.subi %[[S2]], %[[J]]
+// CHECK-NOT:     memref<1xi32>
+// CHECK:         return
+
+// A loop with a break keeps its exit flags.
+// CHECK-LABEL: func.func @find(
+// CHECK:         memref.alloca() : memref<i1>
+
+// ALLOCA-LABEL: func.func @scale(
+// ALLOCA-DAG:     memref.alloca() : memref<i1>
+// ALLOCA-DAG:     memref.alloca() : memref<1xmemref<?xi32>>
@@ -0,0 +1,19 @@
+// RUN: cgeist %s --function=* -S -ffast-math | FileCheck %s
+// RUN: cgeist %s --function=* -S -ffp-contract=fast | FileCheck %s --check-prefix=CONTRACT
+// RUN: cgeist %s --function=* -S | FileCheck %s --check-prefix=STRICT
+// RUN: cgeist %s --function=* -S -ffast-math -emit-llvm | FileCheck %s --check-prefix=LLVM
+
+float axpy(float a, float x, float y) { return a * x + y; }
+
+// CHECK-LABEL: func @axpy
+// CHECK: arith.mulf %arg0, %arg1 fastmath<fast> : f32
+// CHECK: arith.addf %{{.*}}, %arg2 fastmath<fast> : f32
+
+// CONTRACT-LABEL: func @axpy
+// CONTRACT: arith.mulf %arg0, %arg1 fastmath<contract> : f32
+// CONTRACT: arith.addf %{{.*}}, %arg2 fastmath<contract> : f32
+
+// STRICT-NOT: fastmath
+
+// LLVM: fmul fast float
+// LLVM: fadd fast float
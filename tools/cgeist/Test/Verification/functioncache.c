@@ -0,0 +1,35 @@
+// RUN: rm -rf %t && split-file %s %t
+// RUN: cp %t/v1.c %t/test.c
+// RUN: cgeist %t/test.c -O0 -S -function-cache -cache-dir=%t/cache -o /dev/null
+// RUN: cp %t/v2.c %t/test.c
+// RUN: cgeist %t/test.c -O0 -S -function-cache -cache-dir=%t/cache -print-cache-stats -o %t/cached.mlir 2> %t/stats
+// RUN: cgeist %t/test.c -O0 -S -o %t/fresh.mlir
+// RUN: diff %t/cached.mlir %t/fresh.mlir
+// RUN: FileCheck %s < %t/stats
+
+// Only sum changed; square and cube are reused even though they moved.
+// CHECK: cgeist cache: {{.*}}functions
+// CHECK-NEXT: hits 2
+// CHECK-NEXT: misses 4
+// CHECK-NEXT: entries 4
+
+//--- v1.c
+int square(int x) { return x * x; }
+int cube(int x) { return x * square(x); }
+int sum(int n) {
+  int s = 0;
+  for (int i = 0; i < n; i++)
+    s += cube(i);
+  return s;
+}
+
+//--- v2.c
+// Sum of cubes.
+int square(int x) { return x * x; }
+int cube(int x) { return x * square(x); }
+int sum(int n) {
+  int s = 0;
+  for (int i = 1; i <= n; i++)
+    s += cube(i);
+  return s;
+}
@@ -0,0 +1,31 @@
+// RUN: rm -rf %t && split-file %s %t
+// RUN: cp %t/v1.c %t/test.c
+// RUN: cgeist %t/test.c --function=* -O2 -S -function-cache -cache-dir=%t/cache -o /dev/null
+// RUN: cp %t/v2.c %t/test.c
+// RUN: cgeist %t/test.c --function=* -O2 -S -function-cache -cache-dir=%t/cache -print-cache-stats -o %t/cached.mlir 2> %t/stats
+// RUN: cgeist %t/test.c --function=* -O2 -S -o %t/fresh.mlir
+// RUN: diff %t/cached.mlir %t/fresh.mlir
+// RUN: FileCheck %s --check-prefix=STATS < %t/stats
+// RUN: FileCheck %s < %t/cached.mlir
+
+// The cache holds the bodies from before the optimization pipeline. apply
+// is reused unchanged, yet its optimized body must reflect the new scale
+// inlined into it, which a cached optimized body would not.
+// STATS: cgeist cache: {{.*}}functions
+// STATS-NEXT: hits 1
+// STATS-NEXT: misses 3
+// STATS-NEXT: entries 3
+
+// CHECK-LABEL: func @apply(
+// CHECK-NOT:     call @scale
+// CHECK:         arith.constant 5 : i32
+// CHECK-NOT:     arith.constant 3 : i32
+// CHECK:         return
+
+//--- v1.c
+int scale(int x) { return x * 3; }
+int apply(int x) { return scale(x) + 1; }
+
+//--- v2.c
+int scale(int x) { return x * 5; }
+int apply(int x) { return scale(x) + 1; }
@@ -0,0 +1,48 @@
+// RUN: cgeist %s --function=* -S | FileCheck %s
+// RUN: cgeist %s --function=* -S -emit-llvm | FileCheck %s --check-prefix=LLVM
+
+void scale(float *a, int n) {
+#pragma unroll 4
+  for (int i = 0; i < n; i++)
+    a[i] *= 2;
+}
+
+void copy(float *a, float *b, int n) {
+#pragma clang loop vectorize(enable) vectorize_width(8)
+  for (int i = 0; i < n; i++)
+    a[i] = b[i];
+}
+
+void shift(float *a, int n) {
+#pragma GCC ivdep
+  for (int i = 0; i < n; i++)
+    a[i] = a[i + 1];
+}
+
+void gather(float *a, int *idx, int n) {
+#pragma clang loop vectorize(assume_safety)
+  for (int i = 0; i < n; i++)
+    a[idx[i]] += 1;
+}
+
+// CHECK-LABEL: func @scale
+// CHECK: scf.for
+// CHECK: } {polygeist.loop_hints = {unroll_count = 4 : i64}}
+
+// CHECK-LABEL: func @copy
+// CHECK: scf.for
+// CHECK: } {polygeist.loop_hints = {vectorize = true, vectorize_width = 8 : i64}}
+
+// CHECK-LABEL: func @shift
+// CHECK: scf.for
+// CHECK: } {polygeist.loop_hints = {parallel, vectorize = true}}
+
+// CHECK-LABEL: func @gather
+// CHECK: scf.for
+// CHECK: } {polygeist.loop_hints = {parallel, vectorize = true}}
+
+// LLVM-DAG: !{!"llvm.loop.unroll.count", i32 4}
+// LLVM-DAG: !{!"llvm.loop.vectorize.enable", i1 true}
+// LLVM-DAG: !{!"llvm.loop.vectorize.width", i32 8}
+// LLVM-DAG: !{!"llvm.loop.parallel_accesses", ![[group:[0-9]+]]}
+// LLVM-DAG: store float {{.*}} !llvm.access.group ![[group]]
@@ -0,0 +1,47 @@
+// RUN: split-file %s %t
+// RUN: cgeist %t/first.c %t/second.c --function=* -S -O0 -j 2 | FileCheck %s
+
+//--- first.c
+int printf(const char *, ...);
+
+static int helper(int x) { return x + 1; }
+
+static int scale(int x) { return x * 3; }
+
+int offset(int x) { return x + 4; }
+
+int first(int x) {
+  printf("first\n");
+  return offset(scale(helper(x)));
+}
+
+//--- second.c
+int printf(const char *, ...);
+int first(int x);
+
+static int helper(int x) { return x * 2; }
+
+int scale(int x) { return x - 1; }
+
+static int offset(int x) { return x - 5; }
+
+int second(int x) {
+  printf("second\n");
+  return offset(scale(helper(first(x))));
+}
+
+// CHECK-DAG: llvm.mlir.global internal constant @str0("first\0A\00")
+// CHECK-DAG: llvm.mlir.global internal constant @str0.1("second\0A\00")
+// CHECK-DAG: func @first(
+// CHECK-DAG: func private @helper(
+// CHECK-DAG: func @second(
+// CHECK-DAG: func private @helper.1(
+// CHECK-DAG: call @helper.1(
+// CHECK-DAG: func private @scale.1(
+// CHECK-DAG: call @scale.1(
+// CHECK-DAG: func @scale(
+// CHECK-DAG: call @scale(
+// CHECK-DAG: func @offset(
+// CHECK-DAG: call @offset(
+// CHECK-DAG: func private @offset.1(
+// CHECK-DAG: call @offset.1(
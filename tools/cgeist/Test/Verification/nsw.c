@@ -0,0 +1,24 @@
+// RUN: cgeist %s --function=* -O2 -S | FileCheck %s
+// RUN: cgeist %s --function=* -O2 -S -emit-llvm | FileCheck %s --check-prefix=LLVM
+// RUN: cgeist %s --function=* -O0 -S | FileCheck %s --check-prefix=NOFLAGS
+
+int mad(int a, int b, int c) { return a * b + c; }
+
+unsigned umad(unsigned a, unsigned b, unsigned c) { return a * b + c; }
+
+long diff(int *p, int *q) { return p - q; }
+
+// CHECK-LABEL: func @mad
+// CHECK: arith.muli %arg0, %arg1 {polygeist.nsw} : i32
+// CHECK: arith.addi %{{.*}}, %arg2 {polygeist.nsw} : i32
+// CHECK-LABEL: func @umad
+// CHECK-NOT: polygeist.nsw
+// CHECK-LABEL: func @diff
+// CHECK: arith.divsi %{{.*}}, %{{.*}} {polygeist.exact} : i64
+
+// LLVM: mul nsw i32
+// LLVM: add nsw i32
+// LLVM: sdiv exact i64
+
+// NOFLAGS-NOT: polygeist.nsw
+// NOFLAGS-NOT: polygeist.exact
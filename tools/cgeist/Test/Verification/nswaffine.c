@@ -0,0 +1,21 @@
+// RUN: cgeist %s --function=* -O2 -S | FileCheck %s
+
+// Polybench-style kernel over a flattened array. The subscript is computed
+// in int, so it only becomes an affine expression of the induction variables
+// because polygeist.nsw lets the index_cast distribute over the arithmetic.
+
+#define N 64
+
+void scale(int *A, int *B, int alpha) {
+  for (int i = 0; i < N; i++)
+    for (int j = 0; j < N; j++)
+      B[i * N + j] = alpha * A[i * N + j];
+}
+
+// CHECK-LABEL: func @scale(
+// CHECK:   affine.for %[[I:.+]] = 0 to 64 {
+// CHECK-NEXT:     affine.for %[[J:.+]] = 0 to 64 {
+// CHECK-NEXT:       %[[V:.+]] = affine.load %arg0[%[[I]] * 64 + %[[J]]] : memref<?xi32>
+// CHECK-NEXT:       %[[M:.+]] = arith.muli %arg2, %[[V]] {polygeist.nsw} : i32
+// CHECK-NEXT:       affine.store %[[M]], %arg1[%[[I]] * 64 + %[[J]]] : memref<?xi32>
+// CHECK-NOT:   memref.load
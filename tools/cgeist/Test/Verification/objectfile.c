@@ -0,0 +1,19 @@
+// RUN: cgeist %s -O2 -c -o %t.o
+// RUN: clang %t.o -o %t.exe && %t.exe | FileCheck %s
+// RUN: cgeist %s -O2 -o %t.linked.exe && %t.linked.exe | FileCheck %s
+// RUN: cgeist %s -O2 -in-process-backend=0 -o %t.driver.exe && %t.driver.exe | FileCheck %s
+
+int printf(const char *, ...);
+
+int sum(int n) {
+  int s = 0;
+  for (int i = 0; i < n; i++)
+    s += i;
+  return s;
+}
+
+// CHECK: sum=45
+int main() {
+  printf("sum=%d\n", sum(10));
+  return 0;
+}
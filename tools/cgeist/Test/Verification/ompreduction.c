@@ -0,0 +1,105 @@
+// RUN: cgeist %s --function=* -fopenmp -S | FileCheck %s
+// RUN: cgeist %s --function=* -fopenmp -S -emit-llvm | FileCheck %s --check-prefix=LLVM
+
+int sum(int *x, int n) {
+  int s = 0;
+  #pragma omp parallel for reduction(+:s)
+  for (int i = 0; i < n; i++)
+    s += x[i];
+  return s;
+}
+
+double prod(double *x, int n) {
+  double p = 1;
+  #pragma omp parallel
+  {
+    #pragma omp for reduction(*:p)
+    for (int i = 0; i < n; i++)
+      p *= x[i];
+  }
+  return p;
+}
+
+float smallest(float *x, int n) {
+  float m = x[0];
+  #pragma omp parallel for reduction(min:m)
+  for (int i = 1; i < n; i++)
+    m = x[i] < m ? x[i] : m;
+  return m;
+}
+
+int largest(int *x, int n) {
+  int m = x[0];
+  #pragma omp parallel for reduction(max:m)
+  for (int i = 1; i < n; i++)
+    m = x[i] > m ? x[i] : m;
+  return m;
+}
+
+unsigned bits(unsigned *x, int n) {
+  unsigned a = ~0u, b = 0;
+  #pragma omp parallel reduction(&:a) reduction(^:b)
+  {
+    a &= x[0];
+    b ^= x[n];
+  }
+  return a ^ b;
+}
+
+// CHECK-LABEL:   func @sum(
+// CHECK:     omp.parallel {
+// CHECK:       arith.constant 0 : i32
+// CHECK:       omp.wsloop for
+// CHECK:       omp.atomic.update %{{.*}} : !llvm.ptr<i32> {
+// CHECK-NEXT:       ^bb0(%[[old:.+]]: i32):
+// CHECK-NEXT:         %[[new:.+]] = arith.addi %[[old]], %{{.*}} : i32
+// CHECK-NEXT:         omp.yield(%[[new]] : i32)
+// CHECK-NEXT:       }
+// CHECK:       omp.terminator
+
+// CHECK-LABEL:   func @prod(
+// CHECK:     omp.parallel {
+// CHECK:       arith.constant 1.000000e+00 : f64
+// CHECK:       omp.wsloop for
+// CHECK:       omp.atomic.update %{{.*}} : !llvm.ptr<f64> {
+// CHECK-NEXT:       ^bb0(%[[old:.+]]: f64):
+// CHECK-NEXT:         %[[new:.+]] = arith.mulf %[[old]], %{{.*}} : f64
+// CHECK-NEXT:         omp.yield(%[[new]] : f64)
+// CHECK-NEXT:       }
+// CHECK-NEXT:       omp.barrier
+
+// CHECK-LABEL:   func @smallest(
+// CHECK:       arith.constant 0x7F800000 : f32
+// CHECK:       %[[ptr:.+]] = llvm.bitcast %{{.*}} : !llvm.ptr<f32> to !llvm.ptr<i32>
+// CHECK:       %[[init:.+]] = llvm.load %[[ptr]] : !llvm.ptr<i32>
+// CHECK-NEXT:  scf.while (%[[old:.+]] = %[[init]]) : (i32) -> i32 {
+// CHECK-NEXT:    %[[oldf:.+]] = arith.bitcast %[[old]] : i32 to f32
+// CHECK-NEXT:    %[[lt:.+]] = arith.cmpf olt, %[[oldf]], %[[priv:.+]] : f32
+// CHECK-NEXT:    %[[new:.+]] = arith.select %[[lt]], %[[oldf]], %[[priv]] : f32
+// CHECK-NEXT:    %[[newi:.+]] = arith.bitcast %[[new]] : f32 to i32
+// CHECK-NEXT:    %[[pair:.+]] = llvm.cmpxchg %[[ptr]], %[[old]], %[[newi]] monotonic monotonic : i32
+// CHECK-NOT:   omp.atomic.update
+
+// CHECK-LABEL:   func @largest(
+// CHECK:       arith.constant -2147483648 : i32
+// CHECK:       llvm.atomicrmw max %{{.*}}, %{{.*}} monotonic : i32
+// CHECK-NOT:   omp.atomic.update
+
+// CHECK-LABEL:   func @bits(
+// CHECK:     omp.parallel {
+// CHECK-DAG:       arith.constant -1 : i32
+// CHECK-DAG:       arith.constant 0 : i32
+// CHECK:       omp.atomic.update %{{.*}} : !llvm.ptr<i32> {
+// CHECK-NEXT:       ^bb0(%[[old:.+]]: i32):
+// CHECK-NEXT:         %[[new:.+]] = arith.andi %[[old]], %{{.*}} : i32
+// CHECK-NEXT:         omp.yield(%[[new]] : i32)
+// CHECK-NEXT:       }
+// CHECK-NEXT:       omp.atomic.update %{{.*}} : !llvm.ptr<i32> {
+// CHECK-NEXT:       ^bb0(%[[old2:.+]]: i32):
+// CHECK-NEXT:         %[[new2:.+]] = arith.xori %[[old2]], %{{.*}} : i32
+// CHECK-NEXT:         omp.yield(%[[new2]] : i32)
+
+// LLVM-LABEL: define {{.*}}@smallest(
+// LLVM:         cmpxchg i32* %{{.*}}, i32 %{{.*}}, i32 %{{.*}} monotonic monotonic
+// LLVM-LABEL: define {{.*}}@largest(
+// LLVM:         atomicrmw max i32* %{{.*}}, i32 %{{.*}} monotonic
@@ -0,0 +1,21 @@
+// RUN: not cgeist %s --function=* -fopenmp -S 2>&1 | FileCheck %s
+
+int all(int *x, int n) {
+  int r = 1;
+  #pragma omp parallel for reduction(&&:r)
+  for (int i = 0; i < n; i++)
+    r = r && x[i];
+  return r;
+}
+
+_Complex float csum(_Complex float *x, int n) {
+  _Complex float s = 0;
+  #pragma omp parallel for reduction(+:s)
+  for (int i = 0; i < n; i++)
+    s += x[i];
+  return s;
+}
+
+// CHECK-DAG: error: unsupported OpenMP reduction 'operator&&'
+// CHECK-DAG: error: unsupported OpenMP reduction of type '_Complex float'
+// CHECK-NOT: func.func
@@ -0,0 +1,36 @@
+// RUN: cgeist %s --function=* -fopenmp -S | FileCheck %s
+
+void solve(double *x, double **a, int n) {
+  #pragma omp parallel for schedule(dynamic, 4)
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < i; j++)
+      x[i] -= a[i][j] * x[j];
+}
+
+void blur(float **out, float **in, int h, int w, int t) {
+  #pragma omp parallel for collapse(2) num_threads(t) proc_bind(close)
+  for (int i = 1; i < h; i++)
+    for (int j = 1; j < w; j++)
+      out[i][j] = in[i - 1][j] + in[i][j - 1];
+}
+
+void scale(double *x, int n) {
+  #pragma omp parallel
+  {
+    #pragma omp for schedule(nonmonotonic: guided) nowait
+    for (int i = 0; i < n; i++)
+      x[i] *= 2;
+  }
+}
+
+// CHECK-LABEL:   func @solve(
+// CHECK:     omp.parallel {
+// CHECK:       omp.wsloop schedule(dynamic = %{{.*}} : index) for (%{{.*}}) : index = (%{{.*}}) to (%{{.*}}) step (%{{.*}}) {
+
+// CHECK-LABEL:   func @blur(
+// CHECK:     omp.parallel num_threads(%arg4 : i32) proc_bind(close) {
+// CHECK:       omp.wsloop for (%{{.*}}, %{{.*}}) : index = (%{{.*}}, %{{.*}}) to (%{{.*}}, %{{.*}}) step (%{{.*}}, %{{.*}}) {
+
+// CHECK-LABEL:   func @scale(
+// CHECK:     omp.parallel {
+// CHECK:       omp.wsloop schedule(guided, nonmonotonic) nowait for
@@ -0,0 +1,42 @@
+// RUN: cgeist %s --function=* -fopenmp -S | FileCheck %s
+// RUN: cgeist %s --function=* -fopenmp -S -emit-llvm | FileCheck %s --check-prefix=LLVM
+
+void axpy(float *restrict y, float *x, float a, int n) {
+  #pragma omp simd aligned(x, y : 32)
+  for (int i = 0; i < n; i++)
+    y[i] += a * x[i];
+}
+
+void shift(float *x, int n) {
+  #pragma omp simd safelen(8) simdlen(4)
+  for (int i = 8; i < n; i++)
+    x[i] = x[i - 8] + 1;
+}
+
+void scale(double *x, int n) {
+  #pragma omp parallel for simd
+  for (int i = 0; i < n; i++)
+    x[i] *= 2;
+}
+
+// CHECK-LABEL:   func @axpy(
+// CHECK:     "llvm.intr.assume"
+// CHECK:     "llvm.intr.assume"
+// CHECK:     scf.for
+// CHECK:     } {polygeist.loop_hints = {parallel, vectorize = true}}
+
+// CHECK-LABEL:   func @shift(
+// CHECK:     scf.for
+// CHECK:     } {polygeist.loop_hints = {vectorize = true, vectorize_width = 4 : i64}}
+
+// CHECK-LABEL:   func @scale(
+// CHECK:     omp.parallel {
+// CHECK:       omp.wsloop for (%[[block:.+]]) : index =
+// CHECK:         %[[end:.+]] = arith.minsi
+// CHECK:         scf.for %{{.*}} = %[[block]] to %[[end]] step
+// CHECK:         } {polygeist.loop_hints = {parallel, vectorize = true}}
+
+// LLVM-DAG: !{!"llvm.loop.parallel_accesses", ![[group:[0-9]+]]}
+// LLVM-DAG: load float, {{.*}} !llvm.access.group ![[group]]
+// LLVM-DAG: !{!"llvm.loop.vectorize.enable", i1 true}
+// LLVM-DAG: !{!"llvm.loop.vectorize.width", i32 4}
@@ -0,0 +1,34 @@
+// RUN: cgeist %s --function=* -fopenmp -S | FileCheck %s
+// RUN: cgeist %s --function=* -fopenmp -S -emit-llvm | FileCheck %s --check-prefix=LLVM
+
+float total;
+
+void accumulate(float *x, int n) {
+  #pragma omp simd reduction(+:total)
+  for (int i = 0; i < n; i++)
+    total += x[i];
+}
+
+void square(float *x, int n) {
+  float t;
+  #pragma omp simd private(t)
+  for (int i = 0; i < n; i++) {
+    t = x[i];
+    x[i] = t * t;
+  }
+}
+
+// The accesses to the shared variables carry a dependence between
+// iterations, so they must not be declared parallel.
+// CHECK-LABEL:   func @accumulate(
+// CHECK:     scf.for
+// CHECK:     } {polygeist.loop_hints = {vectorize = true}}
+
+// CHECK-LABEL:   func @square(
+// CHECK:     scf.for
+// CHECK:     } {polygeist.loop_hints = {vectorize = true}}
+
+// LLVM-NOT: llvm.loop.parallel_accesses
+// LLVM-NOT: !llvm.access.group
+// LLVM: !{!"llvm.loop.vectorize.enable", i1 true}
+// LLVM-NOT: llvm.loop.parallel_accesses
@@ -0,0 +1,68 @@
+// RUN: cgeist %s --function=* -fopenmp -S | FileCheck %s
+
+struct node {
+  struct node *left, *right;
+  int val;
+};
+
+void visit(struct node *);
+
+void traverse(struct node *n) {
+  if (n->left) {
+    #pragma omp task
+    traverse(n->left);
+  }
+  if (n->right) {
+    #pragma omp task
+    traverse(n->right);
+  }
+  #pragma omp taskwait
+  visit(n);
+}
+
+void fill(double *x, int n) {
+  #pragma omp taskloop grainsize(64)
+  for (int i = 0; i < n; i++)
+    x[i] = i;
+}
+
+void scale(double *x, int n) {
+  #pragma omp taskloop
+  for (int i = 0; i < n; i++)
+    x[i] *= 2;
+}
+
+// CHECK: func.func private @omp_get_num_threads() -> i32
+
+// CHECK-LABEL:   func @traverse(
+// CHECK:       omp.task {
+// CHECK:         call @traverse(
+// CHECK:         omp.terminator
+// CHECK:       omp.task {
+// CHECK:         call @traverse(
+// CHECK:         omp.terminator
+// CHECK:     omp.taskwait
+// CHECK-NEXT:     call @visit(
+
+// CHECK-LABEL:   func @fill(
+// CHECK-DAG:     %[[c64:.+]] = arith.constant 64 : index
+// CHECK:     scf.for %[[chunk:.+]] = %{{.*}} to %[[ub:.+]] step %[[c64]] {
+// CHECK-NEXT:       %[[next:.+]] = arith.addi %[[chunk]], %[[c64]] : index
+// CHECK-NEXT:       %[[end:.+]] = arith.minsi %[[next]], %[[ub]] : index
+// CHECK-NEXT:       omp.task {
+// CHECK-NEXT:         scf.for %[[i:.+]] = %[[chunk]] to %[[end]] step %{{.*}} {
+// CHECK:               memref.store %{{.*}}, %arg0[%[[i]]] : memref<?xf64>
+// CHECK:         omp.terminator
+// CHECK:     omp.taskwait
+
+// Without grainsize or num_tasks, there are ten tasks per thread, or one per
+// iteration if there are fewer iterations.
+// CHECK-LABEL:   func @scale(
+// CHECK:     %[[threads:.+]] = call @omp_get_num_threads() : () -> i32
+// CHECK:     %[[nthreads:.+]] = arith.index_cast %[[threads]] : i32 to index
+// CHECK:     %[[tasks:.+]] = arith.muli %[[nthreads]], %c10 : index
+// CHECK:     arith.minsi %[[tasks]], %{{.*}} : index
+// CHECK:     arith.ceildivsi
+// CHECK:     scf.for
+// CHECK:       omp.task {
+// CHECK:     omp.taskwait
@@ -0,0 +1,35 @@
+// RUN: cgeist %s --function=* -S | FileCheck %s
+
+struct P {
+  int x, y;
+};
+
+int global_rows[2][3] = {{1, 2, 3}};
+
+int rows(int i, int j) {
+  int m[2][3] = {{1, 2, 3}};
+  return m[i][j];
+}
+
+int points(int i) {
+  struct P ps[3] = {{1, 2}};
+  return ps[i].y;
+}
+
+// CHECK: memref.global @global_rows : memref<2x3xi32> = dense<{{\[}}[1, 2, 3], [0, 0, 0]]>
+
+// The row left to the filler is cleared rather than visited.
+// CHECK-LABEL: func.func @rows(
+// CHECK-DAG:     %[[C1:.+]] = arith.constant 1 : i32
+// CHECK-DAG:     %[[C2:.+]] = arith.constant 2 : i32
+// CHECK-DAG:     %[[C3:.+]] = arith.constant 3 : i32
+// CHECK-DAG:     %[[M:.+]] = memref.alloca() : memref<2x3xi32>
+// CHECK:         affine.store %[[C1]], %[[M]][0, 0]
+// CHECK:         affine.store %[[C2]], %[[M]][0, 1]
+// CHECK:         affine.store %[[C3]], %[[M]][0, 2]
+// CHECK:         return
+
+// The structs past the first are cleared rather than visited.
+// CHECK-LABEL: func.func @points(
+// CHECK:         "llvm.intr.memset"
+// CHECK:         return
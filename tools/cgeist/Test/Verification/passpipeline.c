@@ -0,0 +1,23 @@
+// RUN: cgeist %s --function=* -S -pass-pipeline="func.func(mem2reg,canonicalize)" | FileCheck %s
+// RUN: cgeist %s --function=* -S -pass-pipeline="builtin.module(func.func(canonicalize))" -direct-ssa=0 | FileCheck %s --check-prefix=NOMEM2REG
+// RUN: cgeist %s --function=* -S -pipeline-preset=fast-compile -print-pipeline -o /dev/null 2>&1 | FileCheck %s --check-prefix=FAST
+// RUN: cgeist %s --function=* -S -pipeline-preset=max-perf -raise-scf-to-affine=0 -print-pipeline -o /dev/null 2>&1 | FileCheck %s --check-prefix=PERF
+
+int square(int x) {
+  int y = x;
+  return y * y;
+}
+
+// CHECK-LABEL: func.func @square
+// CHECK-NOT:     memref.alloca
+// CHECK:         arith.muli %arg0, %arg0
+
+// NOMEM2REG-LABEL: func.func @square
+// NOMEM2REG:         memref.alloca
+
+// FAST: cleanup: func.func(fixed-point{max-iterations=1
+// FAST-NOT: inline
+
+// PERF: cleanup: func.func(fixed-point{max-iterations=8
+// PERF-NOT: raise-scf-to-affine
+// PERF: optimize: {{.*}}inline
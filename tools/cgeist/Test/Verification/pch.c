@@ -0,0 +1,38 @@
+// RUN: rm -rf %t && split-file %s %t
+// RUN: cgeist %t/square.h -emit-pch -o %t/square.pch
+// RUN: cgeist %t/main.c -include-pch %t/square.pch --function=* -S | FileCheck %s
+// RUN: cgeist %t/twice.hpp -emit-pch -o %t/twice.pch
+// RUN: cgeist %t/main.cpp -include-pch %t/twice.pch --function=* -S | FileCheck %s --check-prefix=CXX
+
+// The body of square only exists in the precompiled header.
+// CHECK-LABEL: func.func @cube(%arg0: i32) -> i32
+// CHECK: call @square(%arg0) : (i32) -> i32
+// CHECK-LABEL: func.func private @square(%arg0: i32) -> i32
+// CHECK: arith.muli %arg0, %arg0 : i32
+
+// twice<int> is instantiated by the header, twice<long> by the source, both
+// from the template definition stored in the precompiled header.
+// CXX-DAG: func.func {{.*}}@_Z4fouri(
+// CXX-DAG: call @_Z5twiceIiET_S0_(
+// CXX-DAG: func.func @_Z4fourl(
+// CXX-DAG: call @_Z5twiceIlET_S0_(
+// CXX-DAG: func.func {{.*}}@_Z5twiceIiET_S0_(%arg0: i32) -> i32
+// CXX-DAG: arith.addi %arg0, %arg0 : i32
+// CXX-DAG: func.func {{.*}}@_Z5twiceIlET_S0_(%arg0: i64) -> i64
+// CXX-DAG: arith.addi %arg0, %arg0 : i64
+
+//--- square.h
+static inline int square(int x) { return x * x; }
+
+//--- main.c
+int cube(int x) { return x * square(x); }
+
+//--- twice.hpp
+template <typename T> T twice(T x) { return x + x; }
+
+inline int four(int x) { return twice(twice(x)); }
+
+//--- main.cpp
+int four(long x) { return twice(twice(x)); }
+
+int callFour(int x) { return four(x); }
@@ -0,0 +1,14 @@
+// RUN: cgeist %s --function=* -S -emit-reachable-only | FileCheck %s
+// RUN: cgeist %s --function=* -S | FileCheck %s --check-prefix=ALL
+
+inline int square(int x) { return x * x; }
+
+int compute(int x) { return square(x) + 1; }
+
+// Once inlined, the inline callee has no users left and is dropped.
+// CHECK-NOT: func.func @_Z6squarei
+// CHECK:     func.func @_Z7computei
+// CHECK-NOT: func.func @_Z6squarei
+
+// ALL-DAG: func.func @_Z7computei
+// ALL-DAG: func.func @_Z6squarei
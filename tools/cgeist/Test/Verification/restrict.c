@@ -0,0 +1,22 @@
+// RUN: cgeist %s --function=* -S | FileCheck %s
+// RUN: cgeist %s --function=* -S -emit-llvm | FileCheck %s --check-prefix=LLCHECK
+
+// Only the qualifiers of the definition count.
+void scale(int n, float *out, const float *in, float *alias);
+
+void scale(int n, float *__restrict out, const float *__restrict in,
+           float *alias) {
+  for (int i = 0; i < n; i++)
+    out[i] = 2 * in[i] + alias[0];
+}
+
+// An external function is only declared, so restrict has no effect on it.
+void copy(float *__restrict dst, const float *__restrict src, int n);
+
+void twice(float *x, int n) { copy(x, x, n); }
+
+// CHECK-DAG: func.func private @copy(memref<?xf32>, memref<?xf32>, i32)
+// CHECK-DAG: func.func @scale(%arg0: i32, %arg1: memref<?xf32> {llvm.noalias}, %arg2: memref<?xf32> {llvm.noalias}, %arg3: memref<?xf32>)
+
+// LLCHECK-DAG: define void @scale(i32 %0, float* noalias %1, float* noalias %2, float* %3)
+// LLCHECK-DAG: declare void @copy(float*, float*, i32)
@@ -0,0 +1,38 @@
+// RUN: cgeist %s --function=* -O2 -S | FileCheck %s
+// RUN: cgeist %s --function=* -O2 -S -emit-llvm | FileCheck %s --check-prefix=LLVM
+// RUN: cgeist %s --function=* -O0 -S | FileCheck %s --check-prefix=NOTBAA
+
+void update(int *n, float *x, unsigned *u, char *c) {
+  *x = *x + 1.0f;
+  *u += *n;
+  *c = 0;
+}
+
+// The optimization level does not change how the source is preprocessed.
+#ifdef __OPTIMIZE__
+void optimized(void) {}
+#endif
+
+// CHECK-LABEL: func @update
+// CHECK-DAG: affine.load %arg1[0] {polygeist.tbaa = "float"} : memref<?xf32>
+// CHECK-DAG: affine.store %{{.*}}, %arg1[0] {polygeist.tbaa = "float"} : memref<?xf32>
+// CHECK-DAG: affine.load %arg0[0] {polygeist.tbaa = "int"} : memref<?xi32>
+// CHECK-DAG: affine.load %arg2[0] {polygeist.tbaa = "int"} : memref<?xi32>
+// CHECK-DAG: affine.store %{{.*}}, %arg2[0] {polygeist.tbaa = "int"} : memref<?xi32>
+// CHECK-DAG: affine.store %{{.*}}, %arg3[0] : memref<?xi8>
+// CHECK-NOT: optimized
+
+// LLVM-LABEL: define {{.*}}void @update(
+// LLVM-DAG: load float, {{.*}} !tbaa ![[FLOAT:[0-9]+]]
+// LLVM-DAG: store float {{.*}} !tbaa ![[FLOAT]]
+// LLVM-DAG: load i32, {{.*}} !tbaa ![[INT:[0-9]+]]
+// LLVM-DAG: store i32 {{.*}} !tbaa ![[INT]]
+// LLVM-DAG: store i8 0, {{[^!]*}}{{$}}
+// LLVM-DAG: ![[FLOAT]] = !{![[FLOATTY:[0-9]+]], ![[FLOATTY]], i64 0}
+// LLVM-DAG: ![[FLOATTY]] = !{!"float", ![[CHAR:[0-9]+]], i64 0}
+// LLVM-DAG: ![[INT]] = !{![[INTTY:[0-9]+]], ![[INTTY]], i64 0}
+// LLVM-DAG: ![[INTTY]] = !{!"int", ![[CHAR]], i64 0}
+// LLVM-DAG: ![[CHAR]] = !{!"omnipotent char", ![[ROOT:[0-9]+]], i64 0}
+// LLVM-DAG: ![[ROOT]] = !{!"Simple C/C++ TBAA"}
+
+// NOTBAA-NOT: polygeist.tbaa
@@ -0,0 +1,56 @@
+// RUN: cgeist %s --function=* %stdinclude -S > %t.serial.mlir
+// RUN: cgeist %s --function=* %stdinclude -S -j 4 > %t.parallel.mlir
+// RUN: diff %t.serial.mlir %t.parallel.mlir
+// RUN: cgeist %s --function=* %stdinclude -S -emit-llvm > %t.serial.ll
+// RUN: cgeist %s --function=* %stdinclude -S -emit-llvm -j 4 > %t.parallel.ll
+// RUN: diff %t.serial.ll %t.parallel.ll
+// RUN: cgeist %s --function=* %stdinclude -S -threads=4 | FileCheck %s
+
+#include <stdlib.h>
+
+void scale(double *x, int n, double a) {
+  for (int i = 0; i < n; i++)
+    x[i] *= a;
+}
+
+int sum(int *x, int n) {
+  int s = 0;
+  for (int i = 0; i < n; i++)
+    s += x[i];
+  return s;
+}
+
+void copy(float *dst, float *src, int n) {
+  for (int i = 0; i < n; i++)
+    dst[i] = src[i];
+}
+
+// Several functions need the malloc and free declarations at once.
+double *dup(double *x, int n) {
+  double *y = (double *)malloc(n * sizeof(double));
+  for (int i = 0; i < n; i++)
+    y[i] = x[i];
+  return y;
+}
+
+int *zeros(int n) {
+  int *y = (int *)malloc(n * sizeof(int));
+  for (int i = 0; i < n; i++)
+    y[i] = 0;
+  return y;
+}
+
+void release(double *x, int *y) {
+  free(x);
+  free(y);
+}
+
+// CHECK-LABEL: func @scale(
+// CHECK-LABEL: func @sum(
+// CHECK-LABEL: func @copy(
+// CHECK-LABEL: func @dup(
+// CHECK: memref.alloc(
+// CHECK-LABEL: func @zeros(
+// CHECK: memref.alloc(
+// CHECK-LABEL: func @release(
+// CHECK: memref.dealloc
@@ -0,0 +1,41 @@
+// Times the frontend on a translation unit that instantiates the same types
+// and mangles related names many times. Compare the "frontend" and
+// "mlir-emission" wall times in %t.json across revisions to benchmark type,
+// name and location interning.
+// RUN: cgeist %s --function=* -S -ftime-report-json=%t.json -o %t.mlir
+// RUN: FileCheck %s --check-prefix=JSON < %t.json
+// RUN: FileCheck %s < %t.mlir
+
+// JSON: "name": "frontend",
+// JSON-NEXT: "wall_seconds":
+// JSON-NEXT: "cpu_seconds":
+// JSON: "name": "mlir-emission",
+// JSON-NEXT: "wall_seconds":
+// JSON-NEXT: "cpu_seconds":
+// JSON-NEXT: "peak_rss_growth_bytes":
+// JSON-NEXT: "ops":
+
+// CHECK-DAG: func.func @_ZN5ChainILi0EE3getERK4PairIifE(
+// CHECK-DAG: func.func @_ZN5ChainILi1EE3getERK4PairIifE(
+// CHECK-DAG: func.func @_ZN5ChainILi128EE3getERK4PairIifE(
+// CHECK-DAG: func.func @_Z3runv(
+
+template <typename A, typename B> struct Pair {
+  A first;
+  B second;
+};
+
+template <int N> struct Chain {
+  static float get(const Pair<int, float> &p) {
+    return Chain<N - 1>::get(p) + p.first * N + p.second;
+  }
+};
+
+template <> struct Chain<0> {
+  static float get(const Pair<int, float> &p) { return p.second; }
+};
+
+float run() {
+  Pair<int, float> p = {1, 2.0f};
+  return Chain<128>::get(p);
+}
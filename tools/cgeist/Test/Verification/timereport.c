@@ -0,0 +1,40 @@
+// RUN: cgeist %s -O2 -S -ftime-report -ftime-report-json=%t.json -o /dev/null 2>&1 | FileCheck %s
+// RUN: FileCheck %s --check-prefix=JSON < %t.json
+
+// The clones of a nested pipeline made for each thread share their entries.
+// RUN: cgeist %s -O2 -S -ftime-report -o /dev/null 2>&1 | cut -c54- > %t.serial
+// RUN: cgeist %s -O2 -S -ftime-report -j 4 -o /dev/null 2>&1 | cut -c54- > %t.threads
+// RUN: diff %t.serial %t.threads
+
+// CHECK: cgeist compile-time report
+// CHECK: Wall (s)     CPU (s)  +Peak RSS (MiB)         Ops  Name
+// CHECK: cgeist
+// CHECK-NEXT: frontend
+// CHECK-NEXT: mlir-emission
+// CHECK-NEXT: cleanup
+// CHECK-NEXT: pipeline 'func.func'
+// CHECK-NEXT: fixed-point
+// CHECK-NEXT: cse
+// CHECK-NEXT: canonicalize
+// CHECK: optimize
+// CHECK: inline
+// CHECK: parallel-lowering
+// CHECK: symbol-dce
+// CHECK: output
+// CHECK: Process peak RSS: {{[0-9.]+}} MiB
+
+// JSON: "name": "cgeist",
+// JSON: "process_peak_rss_bytes":
+// JSON: "children": [
+// JSON: "name": "frontend",
+// JSON-NEXT: "wall_seconds":
+// JSON-NEXT: "cpu_seconds":
+// JSON-NEXT: "peak_rss_growth_bytes":
+// JSON-NEXT: "ops":
+// JSON-NEXT: "runs": 1,
+// JSON: "name": "cleanup",
+
+int square(int x) { return x * x; }
+int cube(int x) { return x * x * x; }
+int twice(int x) { return x + x; }
+int negate(int x) { return -x; }
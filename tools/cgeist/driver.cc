@@ -23,6 +23,7 @@
 #include "mlir/Conversion/LLVMCommon/LoweringOptions.h"
 #include "mlir/Conversion/MathToLLVM/MathToLLVM.h"
 #include "mlir/Conversion/OpenMPToLLVM/ConvertOpenMPToLLVM.h"
+#include "mlir/Conversion/Passes.h"
 #include "mlir/Conversion/SCFToControlFlow/SCFToControlFlow.h"
 #include "mlir/Conversion/SCFToOpenMP/SCFToOpenMP.h"
 #include "mlir/Dialect/Affine/Passes.h"
@@ -38,22 +39,53 @@
 #include "mlir/IR/MLIRContext.h"
 #include "mlir/IR/Verifier.h"
 #include "mlir/Pass/PassManager.h"
+#include "mlir/Pass/PassRegistry.h"
 #include "mlir/Target/LLVMIR/Dialect/OpenMP/OpenMPToLLVMIRTranslation.h"
 #include "mlir/Target/LLVMIR/Export.h"
+#include "mlir/Target/LLVMIR/LLVMTranslationInterface.h"
+#include "mlir/Target/LLVMIR/ModuleTranslation.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 #include "mlir/Transforms/Passes.h"
 
+#include "llvm/ADT/ScopeExit.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/VectorUtils.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Passes/PassBuilder.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FileUtilities.h"
 #include "llvm/Support/Host.h"
 #include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
 #include "llvm/Support/Program.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
 #include <fstream>
 
 #include "polygeist/Dialect.h"
+#include "polygeist/Ops.h"
 #include "polygeist/Passes/Passes.h"
 
+#include "Lib/CompileCache.h"
+#include "Lib/CompileReport.h"
+#include "Lib/CompileServer.h"
+
 using namespace llvm;
 
 static cl::OptionCategory toolOptions("clang to mlir - tool options");
@@ -139,6 +171,15 @@ static cl::opt<std::string> cfunction("function",
 static cl::opt<bool> FOpenMP("fopenmp", cl::init(false),
                              cl::desc("Enable OpenMP"));
 
+static cl::opt<bool> FastMath("ffast-math", cl::init(false),
+                              cl::desc("Allow floating-point optimizations "
+                                       "that ignore IEEE semantics"));
+
+static cl::opt<std::string>
+    FPContract("ffp-contract", cl::init(""),
+               cl::desc("Form fused floating-point operations (fast, on, "
+                        "off)"));
+
 static cl::opt<std::string> ToCPU("cpuify", cl::init(""),
                                   cl::desc("Convert to cpu"));
 
@@ -165,6 +206,26 @@ static cl::list<std::string> defines("D", cl::desc("defines"),
 static cl::list<std::string> Includes("include", cl::desc("includes"),
                                       cl::cat(toolOptions));
 
+static cl::opt<std::string>
+    IncludePCH("include-pch", cl::init(""),
+               cl::desc("Include the given precompiled header"),
+               cl::cat(toolOptions));
+
+static cl::opt<bool>
+    EmitPCH("emit-pch", cl::init(false),
+            cl::desc("Write a precompiled header for the input headers to "
+                     "the output file instead of lowering them"),
+            cl::cat(toolOptions));
+
+static cl::opt<bool> FModules("fmodules", cl::init(false),
+                              cl::desc("Enable clang modules"),
+                              cl::cat(toolOptions));
+
+static cl::opt<std::string>
+    ModulesCachePath("fmodules-cache-path", cl::init(""),
+                     cl::desc("Directory of the clang module cache"),
+                     cl::cat(toolOptions));
+
 static cl::opt<std::string> TargetTripleOpt("target", cl::init(""),
                                             cl::desc("Target triple"),
                                             cl::cat(toolOptions));
@@ -177,9 +238,106 @@ static cl::opt<int>
     CanonicalizeIterations("canonicalizeiters", cl::init(400),
                            cl::desc("Number of canonicalization iterations"));
 
+static cl::opt<unsigned> FixedPointIterations(
+    "fixed-point-iterations", cl::init(4),
+    cl::desc("Maximum number of rounds of each group of cleanup passes"),
+    cl::cat(toolOptions));
+
 static cl::opt<std::string>
     McpuOpt("mcpu", cl::init(""), cl::desc("Target CPU"), cl::cat(toolOptions));
 
+static cl::opt<unsigned> NumThreads(
+    "j", cl::init(1),
+    cl::desc("Number of threads for per-function passes (0 = all cores)"),
+    cl::cat(toolOptions));
+
+static cl::alias NumThreadsAlias("threads", cl::desc("Alias for -j"),
+                                 cl::aliasopt(NumThreads));
+
+static cl::opt<std::string> CacheDir(
+    "cache-dir", cl::init(""),
+    cl::desc("Directory of the compilation cache (default: $CGEIST_CACHE_DIR, "
+             "caching is disabled if neither is set)"),
+    cl::cat(toolOptions));
+
+static cl::opt<unsigned>
+    CacheSizeLimit("cache-size-limit", cl::init(1024),
+                   cl::desc("Maximum size of the compilation cache in MiB"),
+                   cl::cat(toolOptions));
+
+static cl::opt<bool>
+    PrintCacheStats("print-cache-stats", cl::init(false),
+                    cl::desc("Print compilation cache statistics"),
+                    cl::cat(toolOptions));
+
+static cl::opt<bool> FunctionCache(
+    "function-cache", cl::init(false),
+    cl::desc("Reuse the lowering of functions whose definition and "
+             "dependencies did not change (requires a cache directory)"),
+    cl::cat(toolOptions));
+
+// Handled by main() before any option is parsed, listed here for -help.
+static cl::opt<std::string> Serve(
+    "serve", cl::init(""), cl::value_desc("socket"),
+    cl::desc("Must be the first argument. Serve the compilations forwarded "
+             "by cgeist invocations whose CGEIST_SERVER names this Unix "
+             "socket. Only target registration and MLIR context setup are "
+             "shared between requests; each request still parses its "
+             "headers, so use -include-pch to amortize them"),
+    cl::cat(toolOptions));
+
+static cl::opt<bool> FTimeReport(
+    "ftime-report", cl::init(false),
+    cl::desc("Print the time and memory spent in every compilation stage and "
+             "pass"),
+    cl::cat(toolOptions));
+
+static cl::opt<std::string> FTimeReportJSON(
+    "ftime-report-json", cl::init(""),
+    cl::desc("Write the compile-time report as JSON to <file>"),
+    cl::value_desc("file"), cl::cat(toolOptions));
+
+static cl::opt<std::string> PassPipeline(
+    "pass-pipeline", cl::init(""),
+    cl::desc("Textual MLIR pass pipeline to run instead of the built-in "
+             "optimization pipeline"),
+    cl::cat(toolOptions));
+
+enum class PipelinePreset { Default, FastCompile, MaxPerf, CudaCPU };
+
+static cl::opt<PipelinePreset> Preset(
+    "pipeline-preset", cl::init(PipelinePreset::Default),
+    cl::desc("Tuned set of pipeline options; options given explicitly take "
+             "precedence"),
+    cl::values(
+        clEnumValN(PipelinePreset::Default, "default",
+                   "The options' own defaults"),
+        clEnumValN(PipelinePreset::FastCompile, "fast-compile",
+                   "Minimal cleanup for quick development builds"),
+        clEnumValN(PipelinePreset::MaxPerf, "max-perf",
+                   "Affine raising, unrolling and longer cleanup for "
+                   "release builds"),
+        clEnumValN(PipelinePreset::CudaCPU, "cuda-cpu",
+                   "Lower CUDA kernels to parallel CPU code")),
+    cl::cat(toolOptions));
+
+static cl::opt<bool>
+    PrintPipeline("print-pipeline", cl::init(false),
+                  cl::desc("Print the textual pass pipeline of every stage"),
+                  cl::cat(toolOptions));
+
+static cl::opt<bool> EmitReachableOnly(
+    "emit-reachable-only", cl::init(false),
+    cl::desc("Only emit functions reachable from the requested roots, "
+             "skipping roots in system headers for -function=*"),
+    cl::cat(toolOptions));
+
+static cl::opt<bool> InProcessBackend(
+    "in-process-backend", cl::init(true),
+    cl::desc("Optimize and emit object code in-process instead of handing "
+             "textual IR to the clang driver"),
+    cl::cat(toolOptions));
+
 #include "mlir/Dialect/LLVMIR/LLVMDialect.h"
 
 class MemRefInsider
@@ -190,6 +348,160 @@ struct PtrElementModel
     : public mlir::LLVM::PointerElementTypeInterface::ExternalModel<
           PtrElementModel<T>, T> {};
 
+/// Builds the llvm.loop metadata expressing the loop hints `hints`.
+static llvm::MDNode *getLoopMetadata(llvm::LLVMContext &ctx,
+                                     mlir::DictionaryAttr hints) {
+  SmallVector<llvm::Metadata *> ops;
+  // Reserved for the self-reference making the loop ID distinct.
+  ops.push_back(nullptr);
+  auto add = [&](StringRef name, llvm::Constant *value = nullptr) {
+    SmallVector<llvm::Metadata *, 2> property{llvm::MDString::get(ctx, name)};
+    if (value)
+      property.push_back(llvm::ConstantAsMetadata::get(value));
+    ops.push_back(llvm::MDNode::get(ctx, property));
+  };
+  auto i32 = [&](mlir::Attribute attr) {
+    return llvm::ConstantInt::get(
+        llvm::Type::getInt32Ty(ctx),
+        attr.cast<mlir::IntegerAttr>().getValue().getSExtValue());
+  };
+  auto i1 = [&](bool value) {
+    return llvm::ConstantInt::get(llvm::Type::getInt1Ty(ctx), value);
+  };
+
+  if (auto unroll = hints.getAs<mlir::StringAttr>("unroll"))
+    add(("llvm.loop.unroll." + unroll.getValue()).str());
+  if (auto count = hints.get("unroll_count"))
+    add("llvm.loop.unroll.count", i32(count));
+  if (auto vectorize = hints.getAs<mlir::BoolAttr>("vectorize"))
+    add("llvm.loop.vectorize.enable", i1(vectorize.getValue()));
+  if (auto width = hints.get("vectorize_width"))
+    add("llvm.loop.vectorize.width", i32(width));
+  if (auto count = hints.get("interleave_count"))
+    add("llvm.loop.interleave.count", i32(count));
+  if (auto distribute = hints.getAs<mlir::BoolAttr>("distribute"))
+    add("llvm.loop.distribute.enable", i1(distribute.getValue()));
+  // The accesses of the loop are put in this group once the whole function
+  // is translated, see addParallelAccessGroups.
+  if (hints.get("parallel"))
+    ops.push_back(llvm::MDNode::get(
+        ctx, {llvm::MDString::get(ctx, "llvm.loop.parallel_accesses"),
+              llvm::MDNode::getDistinct(ctx, {})}));
+
+  auto *loopID = llvm::MDNode::getDistinct(ctx, ops);
+  loopID->replaceOperandWith(0, loopID);
+  return loopID;
+}
+
+/// Puts the memory accesses of each loop whose metadata lists parallel
+/// accesses in the access group it names, which the vectorizer requires to
+/// ignore the dependences between them.
+static void addParallelAccessGroups(llvm::Module &M) {
+  for (auto &F : M) {
+    if (F.isDeclaration())
+      continue;
+    llvm::DominatorTree DT(F);
+    llvm::LoopInfo LI(DT);
+    for (auto *L : LI.getLoopsInPreorder()) {
+      auto *loopID = L->getLoopID();
+      if (!loopID)
+        continue;
+      for (const auto &op : llvm::drop_begin(loopID->operands())) {
+        auto *property = dyn_cast<llvm::MDNode>(op);
+        if (!property || property->getNumOperands() != 2)
+          continue;
+        auto *name = dyn_cast<llvm::MDString>(property->getOperand(0));
+        if (!name || name->getString() != "llvm.loop.parallel_accesses")
+          continue;
+        auto *group = cast<llvm::MDNode>(property->getOperand(1));
+        for (auto *BB : L->blocks())
+          for (auto &I : *BB)
+            if (I.mayReadOrWriteMemory())
+              I.setMetadata(llvm::LLVMContext::MD_access_group,
+                            llvm::uniteAccessGroups(
+                                I.getMetadata(
+                                    llvm::LLVMContext::MD_access_group),
+                                group));
+      }
+    }
+  }
+}
+
+/// The TBAA access tag for scalars of the strict-aliasing type class `name`,
+/// in the type hierarchy clang builds for C and C++.
+static llvm::MDNode *getTBAATag(llvm::LLVMContext &ctx, StringRef name) {
+  llvm::MDBuilder MDB(ctx);
+  auto *root = MDB.createTBAARoot("Simple C/C++ TBAA");
+  auto *charType = MDB.createTBAAScalarTypeNode("omnipotent char", root);
+  auto *type = MDB.createTBAAScalarTypeNode(name, charType);
+  return MDB.createTBAAStructTagNode(type, type, /*Offset*/ 0);
+}
+
+/// The LLVM store that `store` was just translated to. It is the latest use
+/// of the translated address, as uses are prepended to the use list.
+static llvm::StoreInst *
+lookupStore(mlir::LLVM::StoreOp store,
+            mlir::LLVM::ModuleTranslation &moduleTranslation) {
+  llvm::Value *addr = moduleTranslation.lookupValue(store.getAddr());
+  llvm::Value *value = moduleTranslation.lookupValue(store.getValue());
+  if (!addr)
+    return nullptr;
+  for (llvm::User *user : addr->users())
+    if (auto *inst = dyn_cast<llvm::StoreInst>(user))
+      if (inst->getPointerOperand() == addr &&
+          inst->getValueOperand() == value)
+        return inst;
+  return nullptr;
+}
+
+/// Turns the arithmetic flags, type tags and loop hints the frontend attaches
+/// as polygeist attributes into the flags and metadata of the translated LLVM
+/// instructions.
+struct PolygeistLLVMTranslation : public mlir::LLVMTranslationDialectInterface {
+  using LLVMTranslationDialectInterface::LLVMTranslationDialectInterface;
+
+  mlir::LogicalResult
+  amendOperation(mlir::Operation *op, mlir::NamedAttribute attribute,
+                 mlir::LLVM::ModuleTranslation &moduleTranslation) const final {
+    StringRef name = attribute.getName().getValue();
+    if (name == LoopHintsAttrName) {
+      auto hints = attribute.getValue().dyn_cast<mlir::DictionaryAttr>();
+      auto *branch = moduleTranslation.lookupBranch(op);
+      if (branch && hints)
+        branch->setMetadata(
+            llvm::LLVMContext::MD_loop,
+            getLoopMetadata(moduleTranslation.getLLVMContext(), hints));
+      return mlir::success();
+    }
+    if (name == TypeTagAttrName) {
+      auto tag = attribute.getValue().dyn_cast<mlir::StringAttr>();
+      llvm::Instruction *inst = nullptr;
+      if (auto store = dyn_cast<mlir::LLVM::StoreOp>(op))
+        inst = lookupStore(store, moduleTranslation);
+      else if (isa<mlir::LLVM::LoadOp>(op))
+        inst = dyn_cast_or_null<llvm::Instruction>(
+            moduleTranslation.lookupValue(op->getResult(0)));
+      if (inst && tag)
+        inst->setMetadata(
+            llvm::LLVMContext::MD_tbaa,
+            getTBAATag(moduleTranslation.getLLVMContext(), tag.getValue()));
+      return mlir::success();
+    }
+    if (op->getNumResults() != 1)
+      return mlir::success();
+    auto *inst = dyn_cast_or_null<llvm::Instruction>(
+        moduleTranslation.lookupValue(op->getResult(0)));
+    if (!inst)
+      return mlir::success();
+    if (name == NoSignedWrapAttrName &&
+        isa<llvm::OverflowingBinaryOperator>(inst))
+      inst->setHasNoSignedWrap(true);
+    else if (name == ExactAttrName && isa<llvm::PossiblyExactOperator>(inst))
+      inst->setIsExact(true);
+    return mlir::success();
+  }
+};
+
 extern int cc1_main(ArrayRef<const char *> Argv, const char *Argv0,
                     void *MainAddr);
 extern int cc1as_main(ArrayRef<const char *> Argv, const char *Argv0,
@@ -351,17 +663,236 @@ int emitBinary(char *Argv0, const char *filename,
   return Res;
 }
 
+/// The target machine configuration the frontend recorded from the clang
+/// invocation, following clang's initTargetOptions.
+struct BackendOptions {
+  llvm::TargetOptions Options;
+  llvm::Reloc::Model RelocModel = llvm::Reloc::PIC_;
+  llvm::Optional<llvm::CodeModel::Model> CodeModel;
+};
+
+static BackendOptions getBackendOptions(mlir::DictionaryAttr attrs) {
+  BackendOptions BO;
+  if (!attrs)
+    return BO;
+  if (auto A = attrs.getAs<mlir::StringAttr>("float-abi"))
+    BO.Options.FloatABIType =
+        llvm::StringSwitch<llvm::FloatABI::ABIType>(A.getValue())
+            .Case("soft", llvm::FloatABI::Soft)
+            .Case("softfp", llvm::FloatABI::Soft)
+            .Case("hard", llvm::FloatABI::Hard)
+            .Default(llvm::FloatABI::Default);
+  if (auto A = attrs.getAs<mlir::IntegerAttr>("reloc-model"))
+    BO.RelocModel = static_cast<llvm::Reloc::Model>(A.getInt());
+  if (auto A = attrs.getAs<mlir::StringAttr>("code-model"))
+    BO.CodeModel =
+        llvm::StringSwitch<llvm::Optional<llvm::CodeModel::Model>>(
+            A.getValue())
+            .Case("tiny", llvm::CodeModel::Tiny)
+            .Case("small", llvm::CodeModel::Small)
+            .Case("kernel", llvm::CodeModel::Kernel)
+            .Case("medium", llvm::CodeModel::Medium)
+            .Case("large", llvm::CodeModel::Large)
+            .Default(llvm::None);
+  if (auto A = attrs.getAs<mlir::IntegerAttr>("fp-contract"))
+    BO.Options.AllowFPOpFusion =
+        static_cast<llvm::FPOpFusion::FPOpFusionMode>(A.getInt());
+  if (auto A = attrs.getAs<mlir::BoolAttr>("use-init-array"))
+    BO.Options.UseInitArray = A.getValue();
+  if (auto A = attrs.getAs<mlir::BoolAttr>("function-sections"))
+    BO.Options.FunctionSections = A.getValue();
+  if (auto A = attrs.getAs<mlir::BoolAttr>("data-sections"))
+    BO.Options.DataSections = A.getValue();
+  if (auto A = attrs.getAs<mlir::BoolAttr>("unique-section-names"))
+    BO.Options.UniqueSectionNames = A.getValue();
+  return BO;
+}
+
+/// Run the -O pipeline on `M` and write it as an object file to `filename`
+/// using a TargetMachine built from the module's triple, the given CPU and
+/// features and the options of the clang invocation. Returns a non-zero value
+/// on failure.
+static int emitObjectFile(llvm::Module &M, StringRef CPU, StringRef Features,
+                          const BackendOptions &BO, StringRef filename) {
+  llvm::InitializeAllTargetInfos();
+  llvm::InitializeAllTargets();
+  llvm::InitializeAllTargetMCs();
+  llvm::InitializeAllAsmPrinters();
+
+  std::string Error;
+  const llvm::Target *Target =
+      llvm::TargetRegistry::lookupTarget(M.getTargetTriple(), Error);
+  if (!Target) {
+    llvm::errs() << "Failed to look up target: " << Error << "\n";
+    return -1;
+  }
+
+  llvm::OptimizationLevel OptLevel = llvm::OptimizationLevel::O0;
+  llvm::CodeGenOpt::Level CGOptLevel = llvm::CodeGenOpt::None;
+  if (Opt3) {
+    OptLevel = llvm::OptimizationLevel::O3;
+    CGOptLevel = llvm::CodeGenOpt::Aggressive;
+  } else if (Opt2) {
+    OptLevel = llvm::OptimizationLevel::O2;
+    CGOptLevel = llvm::CodeGenOpt::Default;
+  } else if (Opt1) {
+    OptLevel = llvm::OptimizationLevel::O1;
+    CGOptLevel = llvm::CodeGenOpt::Less;
+  }
+
+  std::unique_ptr<llvm::TargetMachine> TM(Target->createTargetMachine(
+      M.getTargetTriple(), CPU, Features, BO.Options, BO.RelocModel,
+      BO.CodeModel, CGOptLevel));
+  if (!TM) {
+    llvm::errs() << "Failed to create target machine\n";
+    return -1;
+  }
+
+  llvm::LoopAnalysisManager LAM;
+  llvm::FunctionAnalysisManager FAM;
+  llvm::CGSCCAnalysisManager CGAM;
+  llvm::ModuleAnalysisManager MAM;
+  llvm::PassBuilder PB(TM.get());
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+  llvm::ModulePassManager MPM =
+      OptLevel == llvm::OptimizationLevel::O0
+          ? PB.buildO0DefaultPipeline(OptLevel)
+          : PB.buildPerModuleDefaultPipeline(OptLevel);
+  MPM.run(M, MAM);
+
+  std::error_code EC;
+  llvm::raw_fd_ostream out(filename, EC, llvm::sys::fs::OF_None);
+  if (EC) {
+    llvm::errs() << "Failed to open " << filename << ": " << EC.message()
+                 << "\n";
+    return -1;
+  }
+  llvm::legacy::PassManager CodeGenPasses;
+  if (TM->addPassesToEmitFile(CodeGenPasses, out, nullptr,
+                              llvm::CGFT_ObjectFile)) {
+    llvm::errs() << "Target does not support object file emission\n";
+    return -1;
+  }
+  CodeGenPasses.run(M);
+  return 0;
+}
+
+/// Load the dialects and interfaces cgeist uses into `context`.
+static void initializeContext(mlir::MLIRContext &context) {
+  mlir::DialectRegistry registry;
+  mlir::registerOpenMPDialectTranslation(registry);
+  mlir::registerLLVMDialectTranslation(registry);
+  registry.addExtension(+[](mlir::MLIRContext *ctx,
+                            mlir::polygeist::PolygeistDialect *dialect) {
+    dialect->addInterfaces<PolygeistLLVMTranslation>();
+  });
+  context.appendDialectRegistry(registry);
+
+  context.getOrLoadDialect<mlir::AffineDialect>();
+  context.getOrLoadDialect<mlir::func::FuncDialect>();
+  context.getOrLoadDialect<mlir::DLTIDialect>();
+  context.getOrLoadDialect<mlir::scf::SCFDialect>();
+  context.getOrLoadDialect<mlir::async::AsyncDialect>();
+  context.getOrLoadDialect<mlir::LLVM::LLVMDialect>();
+  context.getOrLoadDialect<mlir::NVVM::NVVMDialect>();
+  context.getOrLoadDialect<mlir::gpu::GPUDialect>();
+  context.getOrLoadDialect<mlir::omp::OpenMPDialect>();
+  context.getOrLoadDialect<mlir::math::MathDialect>();
+  context.getOrLoadDialect<mlir::memref::MemRefDialect>();
+  context.getOrLoadDialect<mlir::linalg::LinalgDialect>();
+  context.getOrLoadDialect<mlir::polygeist::PolygeistDialect>();
+
+  using namespace mlir;
+  LLVM::LLVMFunctionType::attachInterface<MemRefInsider>(context);
+  LLVM::LLVMPointerType::attachInterface<MemRefInsider>(context);
+  LLVM::LLVMArrayType::attachInterface<MemRefInsider>(context);
+  LLVM::LLVMStructType::attachInterface<MemRefInsider>(context);
+  MemRefType::attachInterface<PtrElementModel<MemRefType>>(context);
+  IndexType::attachInterface<PtrElementModel<IndexType>>(context);
+  LLVM::LLVMStructType::attachInterface<PtrElementModel<LLVM::LLVMStructType>>(
+      context);
+  LLVM::LLVMPointerType::attachInterface<
+      PtrElementModel<LLVM::LLVMPointerType>>(context);
+  LLVM::LLVMArrayType::attachInterface<PtrElementModel<LLVM::LLVMArrayType>>(
+      context);
+}
+
+/// A context prepared by the compile server before it forks, so that each
+/// request starts with its dialects already loaded.
+static mlir::MLIRContext *WarmContext = nullptr;
+
 #include "Lib/clang-mlir.cc"
-int main(int argc, char **argv) {
 
-  if (argc >= 1) {
-    if (std::string(argv[1]) == "-cc1") {
-      SmallVector<const char *> Argv;
-      for (int i = 0; i < argc; i++)
-        Argv.push_back(argv[i]);
-      return ExecuteCC1Tool(Argv);
-    }
+/// Number of operations nested in `op`, only counted for the compile-time
+/// report.
+static llvm::Optional<uint64_t> countOps(mlirclang::CompileReport *report,
+                                         mlir::Operation *op) {
+  if (!report)
+    return llvm::None;
+  uint64_t count = 0;
+  op->walk([&](mlir::Operation *) { count++; });
+  return count;
+}
+
+/// Set `option` to `value` unless it was given on the command line.
+template <typename T, typename V>
+static void setPresetOption(cl::opt<T> &option, const V &value) {
+  if (!option.getNumOccurrences())
+    option = value;
+}
+
+/// Make the passes of the built-in pipelines available to -pass-pipeline.
+static void registerPipelinePasses() {
+  static bool registered = [] {
+    mlir::registerpolygeistPasses();
+    mlir::registerTransformsPasses();
+    mlir::registerAffinePasses();
+    mlir::registerSCFPasses();
+    mlir::registerConvertAffineToStandardPass();
+    mlir::registerConvertSCFToOpenMPPass();
+    return true;
+  }();
+  (void)registered;
+}
+
+static void applyPipelinePreset(PipelinePreset preset) {
+  bool optLevelGiven = Opt0.getNumOccurrences() || Opt1.getNumOccurrences() ||
+                       Opt2.getNumOccurrences() || Opt3.getNumOccurrences();
+  switch (preset) {
+  case PipelinePreset::Default:
+    break;
+  case PipelinePreset::FastCompile:
+    if (!optLevelGiven)
+      Opt0 = true;
+    setPresetOption(RaiseToAffine, false);
+    setPresetOption(ScalarReplacement, false);
+    setPresetOption(LoopUnroll, false);
+    setPresetOption(ParallelLICM, false);
+    setPresetOption(OpenMPOpt, false);
+    setPresetOption(FixedPointIterations, 1u);
+    break;
+  case PipelinePreset::MaxPerf:
+    if (!optLevelGiven)
+      Opt3 = true;
+    setPresetOption(RaiseToAffine, true);
+    setPresetOption(ScalarReplacement, true);
+    setPresetOption(LoopUnroll, true);
+    setPresetOption(ParallelLICM, true);
+    setPresetOption(OpenMPOpt, true);
+    setPresetOption(FixedPointIterations, 8u);
+    break;
+  case PipelinePreset::CudaCPU:
+    setPresetOption(CudaLower, true);
+    setPresetOption(ToCPU, "distribute");
+    break;
   }
+}
+
+static int cgeistMain(int argc, char **argv) {
   SmallVector<const char *> LinkageArgs;
   SmallVector<const char *> MLIRArgs;
   {
@@ -425,47 +956,211 @@ int main(int argc, char **argv) {
       files.push_back(inp);
     }
   }
+  if (!Serve.empty()) {
+    llvm::errs() << "error: -serve must be the first argument\n";
+    return 1;
+  }
+  applyPipelinePreset(Preset);
+
+  std::unique_ptr<mlirclang::CompileReport> report;
+  if (FTimeReport || FTimeReportJSON != "")
+    report = std::make_unique<mlirclang::CompileReport>();
+  CompileTimeReport = report.get();
+  auto printReport = llvm::make_scope_exit([&] {
+    CompileTimeReport = nullptr;
+    if (!report)
+      return;
+    if (FTimeReport)
+      report->print(llvm::errs());
+    if (FTimeReportJSON != "") {
+      std::error_code EC;
+      llvm::raw_fd_ostream out(FTimeReportJSON, EC, llvm::sys::fs::OF_Text);
+      if (EC)
+        llvm::errs() << "Failed to write " << FTimeReportJSON << "\n";
+      else
+        report->printJSON(out);
+    }
+  });
 
-  mlir::DialectRegistry registry;
-  mlir::registerOpenMPDialectTranslation(registry);
-  mlir::registerLLVMDialectTranslation(registry);
-  MLIRContext context(registry);
+  if (EmitPCH) {
+    if (Output == "-") {
+      llvm::errs() << "error: -emit-pch requires an output file\n";
+      return 1;
+    }
+    return emitPrecompiledHeader(argv[0], files,
+                                 std::vector<std::string>(includeDirs),
+                                 std::vector<std::string>(defines), Output);
+  }
 
-  context.disableMultithreading();
-  context.getOrLoadDialect<AffineDialect>();
-  context.getOrLoadDialect<func::FuncDialect>();
-  context.getOrLoadDialect<DLTIDialect>();
-  context.getOrLoadDialect<mlir::scf::SCFDialect>();
-  context.getOrLoadDialect<mlir::async::AsyncDialect>();
-  context.getOrLoadDialect<mlir::LLVM::LLVMDialect>();
-  context.getOrLoadDialect<mlir::NVVM::NVVMDialect>();
-  context.getOrLoadDialect<mlir::gpu::GPUDialect>();
-  context.getOrLoadDialect<mlir::omp::OpenMPDialect>();
-  context.getOrLoadDialect<mlir::math::MathDialect>();
-  context.getOrLoadDialect<mlir::memref::MemRefDialect>();
-  context.getOrLoadDialect<mlir::linalg::LinalgDialect>();
-  context.getOrLoadDialect<mlir::polygeist::PolygeistDialect>();
+  bool CompileOnly = llvm::any_of(
+      LinkageArgs, [](const char *arg) { return StringRef(arg) == "-c"; });
+
+  // Outputs that do not involve linking (MLIR, LLVM IR and objects) can be
+  // served from the compilation cache. On a miss the output is produced in a
+  // temporary file that is stored in the cache once compilation succeeds.
+  std::unique_ptr<mlirclang::CompileCache> cache;
+  std::string cacheKey;
+  std::string finalOutput = Output;
+  SmallString<128> cacheTmpPath;
+  FileRemover cacheTmpRemover;
+  std::string cacheDir = CacheDir;
+  if (cacheDir.empty())
+    if (auto env = llvm::sys::Process::GetEnv("CGEIST_CACHE_DIR"))
+      cacheDir = *env;
+
+  // Inputs, outputs and options that do not affect the generated code are
+  // left out of cache keys.
+  std::vector<std::string> cacheOptions;
+  if (!cacheDir.empty()) {
+    for (size_t i = 1; i < MLIRArgs.size(); i++) {
+      StringRef arg(MLIRArgs[i]);
+      StringRef name = arg.ltrim('-').split('=').first;
+      bool neutralWithValue =
+          llvm::StringSwitch<bool>(name)
+              .Cases("o", "j", "threads", "cache-dir", "cache-size-limit",
+                     "ftime-report-json", true)
+              .Default(false);
+      if (neutralWithValue && !arg.contains('=')) {
+        i++;
+        continue;
+      }
+      if (neutralWithValue ||
+          name == "print-cache-stats" || name == "function-cache" ||
+          name == "ftime-report" || name == "print-pipeline" ||
+          llvm::is_contained(files, arg))
+        continue;
+      cacheOptions.push_back(arg.str());
+    }
+    for (auto *arg : LinkageArgs)
+      cacheOptions.push_back(arg);
+  }
+  // Preprocessed sources do not show what is imported from clang modules,
+  // so those compilations are not cached as a whole.
+  if (!cacheDir.empty() && (EmitAssembly || CompileOnly) && !ImmediateMLIR &&
+      !ShowAST && !FModules) {
+    mlirclang::CompileReport::Scope stage(report.get(), "cache-lookup");
+    std::vector<std::string> inputs;
+    for (auto &file : files) {
+      std::string preprocessed;
+      if (!preprocessInput(argv[0], file, std::vector<std::string>(includeDirs),
+                           std::vector<std::string>(defines), preprocessed))
+        break;
+      inputs.push_back(std::move(preprocessed));
+    }
+    bool haveInputs = inputs.size() == files.size();
+    // Declarations from a precompiled header are not part of the
+    // preprocessed output either.
+    if (haveInputs && IncludePCH != "") {
+      auto pch = llvm::MemoryBuffer::getFile(IncludePCH, /*IsText*/ false,
+                                             /*RequiresNullTerminator*/ false);
+      if (pch)
+        inputs.push_back((*pch)->getBuffer().str());
+      else
+        haveInputs = false;
+    }
 
-  LLVM::LLVMFunctionType::attachInterface<MemRefInsider>(context);
-  LLVM::LLVMPointerType::attachInterface<MemRefInsider>(context);
-  LLVM::LLVMArrayType::attachInterface<MemRefInsider>(context);
-  LLVM::LLVMStructType::attachInterface<MemRefInsider>(context);
-  MemRefType::attachInterface<PtrElementModel<MemRefType>>(context);
-  IndexType::attachInterface<PtrElementModel<IndexType>>(context);
-  LLVM::LLVMStructType::attachInterface<PtrElementModel<LLVM::LLVMStructType>>(
-      context);
-  LLVM::LLVMPointerType::attachInterface<
-      PtrElementModel<LLVM::LLVMPointerType>>(context);
-  LLVM::LLVMArrayType::attachInterface<PtrElementModel<LLVM::LLVMArrayType>>(
-      context);
+    if (haveInputs) {
+      cacheKey = mlirclang::CompileCache::computeKey(cacheOptions, inputs);
+      cache = std::make_unique<mlirclang::CompileCache>(
+          cacheDir, (uint64_t)CacheSizeLimit * 1024 * 1024);
+      if (cache->lookup(cacheKey, finalOutput)) {
+        if (PrintCacheStats)
+          cache->printStatistics(llvm::errs());
+        return 0;
+      }
+      if (llvm::sys::fs::createTemporaryFile("cgeist-cache", "out",
+                                             cacheTmpPath)) {
+        cache.reset();
+      } else {
+        cacheTmpRemover.setFile(cacheTmpPath);
+        Output = std::string(cacheTmpPath.str());
+      }
+    }
+  }
+  if (!cacheDir.empty() && FunctionCache) {
+    SmallString<128> functionCacheDir(cacheDir);
+    llvm::sys::path::append(functionCacheDir, "functions");
+    FunctionLoweringCache = std::make_unique<mlirclang::CompileCache>(
+        functionCacheDir, (uint64_t)CacheSizeLimit * 1024 * 1024);
+    FunctionLoweringCacheContext = llvm::join(cacheOptions, "\n");
+  }
+
+  auto finishCache = [&](int res) -> int {
+    if (PrintCacheStats && FunctionLoweringCache)
+      FunctionLoweringCache->printStatistics(llvm::errs());
+    if (!cache)
+      return res;
+    if (res == 0) {
+      auto buffer =
+          llvm::MemoryBuffer::getFile(cacheTmpPath, /*IsText*/ false,
+                                      /*RequiresNullTerminator*/ false);
+      std::error_code EC;
+      llvm::raw_fd_ostream out(finalOutput, EC, llvm::sys::fs::OF_None);
+      if (!buffer || EC) {
+        llvm::errs() << "Failed to write " << finalOutput << "\n";
+        return -1;
+      }
+      out << (*buffer)->getBuffer();
+      cache->store(cacheKey, cacheTmpPath);
+    }
+    if (PrintCacheStats)
+      cache->printStatistics(llvm::errs());
+    return res;
+  };
+
+  // Must outlive the context that borrows it.
+  std::unique_ptr<llvm::ThreadPool> threadPool;
+
+  std::unique_ptr<MLIRContext> ownedContext;
+  if (!WarmContext) {
+    ownedContext =
+        std::make_unique<MLIRContext>(MLIRContext::Threading::DISABLED);
+    initializeContext(*ownedContext);
+  }
+  MLIRContext &context = WarmContext ? *WarmContext : *ownedContext;
+
+  // The nested func::FuncOp pipelines below are scheduled across functions
+  // when more than one thread is requested. Module-level edits made from
+  // function passes are serialized, so output matches the serial run.
+  if (NumThreads != 1) {
+    threadPool = std::make_unique<llvm::ThreadPool>(
+        llvm::hardware_concurrency(NumThreads));
+    context.setThreadPool(*threadPool);
+  }
 
   mlir::OwningOpRef<mlir::ModuleOp> module(
       mlir::ModuleOp::create(mlir::OpBuilder(&context).getUnknownLoc()));
 
   llvm::Triple triple;
   llvm::DataLayout DL("");
-  parseMLIR(argv[0], files, cfunction, includeDirs, defines, module, triple,
-            DL);
+  {
+    mlirclang::CompileReport::Scope stage(report.get(), "frontend");
+    if (!parseMLIR(argv[0], files, cfunction, includeDirs, defines, module,
+                   triple, DL))
+      return 1;
+    // Nothing below queries clang, whose state is already destroyed.
+    releaseFrontendMemory();
+    stage.finish(countOps(report.get(), module.get()));
+  }
+
+  // Run `passes` on the module as the stage `name` of the compile-time
+  // report.
+  auto runPasses = [&](mlir::PassManager &passes,
+                       StringRef name) -> mlir::LogicalResult {
+    mlirclang::CompileReport::Scope stage(report.get(), name);
+    if (PrintPipeline) {
+      llvm::errs() << name << ": ";
+      passes.printAsTextualPipeline(llvm::errs());
+      llvm::errs() << "\n";
+    }
+    if (report)
+      passes.addInstrumentation(report->createPassInstrumentation());
+    if (mlir::failed(passes.run(module.get())))
+      return mlir::failure();
+    stage.finish(countOps(report.get(), module.get()));
+    return mlir::success();
+  };
+
   mlir::PassManager pm(&context);
 
   OpPrintingFlags flags;
@@ -478,59 +1173,103 @@ int main(int argc, char **argv) {
     llvm::errs() << "</immediate: mlir>\n";
   }
 
-  int unrollSize = 32;
   bool LinkOMP = FOpenMP;
   pm.enableVerifier(EarlyVerifier);
+  // Drop functions nothing refers to before any per-function work.
+  if (EmitReachableOnly)
+    pm.addPass(mlir::createSymbolDCEPass());
   mlir::OpPassManager &optPM = pm.nest<mlir::func::FuncOp>();
   GreedyRewriteConfig canonicalizerConfig;
   canonicalizerConfig.maxIterations = CanonicalizeIterations;
-  if (true) {
-    optPM.addPass(mlir::createCSEPass());
-    optPM.addPass(mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-    optPM.addPass(polygeist::createMem2RegPass());
-    optPM.addPass(mlir::createCSEPass());
-    optPM.addPass(mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-    optPM.addPass(polygeist::createMem2RegPass());
-    optPM.addPass(mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-    optPM.addPass(polygeist::createRemoveTrivialUsePass());
-    optPM.addPass(polygeist::createMem2RegPass());
-    optPM.addPass(mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-    optPM.addPass(polygeist::createLoopRestructurePass());
-    optPM.addPass(polygeist::replaceAffineCFGPass());
-    optPM.addPass(mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-    if (ScalarReplacement)
-      optPM.addPass(mlir::createAffineScalarReplacementPass());
+
+  // Cleanups that enable each other are grouped and repeated on every
+  // function until they stop changing it, so functions that are already
+  // clean are not walked again.
+  auto fixedPoint =
+      [&](llvm::function_ref<void(mlir::OpPassManager &)> populate) {
+        mlir::OpPassManager group(mlir::func::FuncOp::getOperationName());
+        populate(group);
+        return polygeist::createFixedPointPass(std::move(group),
+                                               FixedPointIterations);
+      };
+  auto addLICM = [&](mlir::OpPassManager &passes) {
     if (ParallelLICM)
-      optPM.addPass(polygeist::createParallelLICMPass());
+      passes.addPass(polygeist::createParallelLICMPass());
     else
-      optPM.addPass(mlir::createLoopInvariantCodeMotionPass());
-    optPM.addPass(mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-    optPM.addPass(polygeist::createCanonicalizeForPass());
-    optPM.addPass(mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-    if (RaiseToAffine) {
-      optPM.addPass(polygeist::createCanonicalizeForPass());
-      optPM.addPass(mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-      if (ParallelLICM)
-        optPM.addPass(polygeist::createParallelLICMPass());
-      else
-        optPM.addPass(mlir::createLoopInvariantCodeMotionPass());
-      optPM.addPass(polygeist::createRaiseSCFToAffinePass());
+      passes.addPass(mlir::createLoopInvariantCodeMotionPass());
+  };
+  auto addRaiseToAffine = [&](mlir::OpPassManager &passes) {
+    addLICM(passes);
+    passes.addPass(polygeist::createRaiseSCFToAffinePass());
+    passes.addPass(mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
+    passes.addPass(polygeist::replaceAffineCFGPass());
+    passes.addPass(mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
+  };
+
+  if (true) {
+    if (PassPipeline != "") {
+      // A custom pipeline replaces the built-in cleanup and optimization
+      // stages. Lowering to the requested output still follows.
+      registerPipelinePasses();
+      StringRef pipeline = PassPipeline;
+      if (pipeline.startswith("builtin.module(") && pipeline.endswith(")"))
+        pipeline = pipeline.drop_front(strlen("builtin.module(")).drop_back();
+      mlir::PassManager custom(&context);
+      custom.enableVerifier(EarlyVerifier);
+      if (mlir::failed(mlir::parsePassPipeline(pipeline, custom))) {
+        llvm::errs() << "error: invalid pass pipeline '" << PassPipeline
+                     << "'\n";
+        return 1;
+      }
+      if (mlir::failed(runPasses(custom, "custom-pipeline"))) {
+        module->dump();
+        return 4;
+      }
+    } else {
+      optPM.addPass(fixedPoint([&](mlir::OpPassManager &group) {
+        group.addPass(mlir::createCSEPass());
+        group.addPass(
+            mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
+        group.addPass(polygeist::createMem2RegPass());
+      }));
+      optPM.addPass(polygeist::createRemoveTrivialUsePass());
+      optPM.addPass(fixedPoint([&](mlir::OpPassManager &group) {
+        group.addPass(polygeist::createMem2RegPass());
+        group.addPass(
+            mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
+      }));
+      optPM.addPass(polygeist::createLoopRestructurePass());
       optPM.addPass(polygeist::replaceAffineCFGPass());
+      optPM.addPass(mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
       if (ScalarReplacement)
         optPM.addPass(mlir::createAffineScalarReplacementPass());
-    }
-    if (mlir::failed(pm.run(module.get()))) {
-      module->dump();
-      return 4;
-    }
-    if (mlir::failed(mlir::verify(module.get()))) {
-      module->dump();
-      return 5;
+      addLICM(optPM);
+      optPM.addPass(mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
+      optPM.addPass(fixedPoint([&](mlir::OpPassManager &group) {
+        group.addPass(polygeist::createCanonicalizeForPass());
+        group.addPass(
+            mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
+      }));
+      if (RaiseToAffine) {
+        addLICM(optPM);
+        optPM.addPass(polygeist::createRaiseSCFToAffinePass());
+        optPM.addPass(polygeist::replaceAffineCFGPass());
+        if (ScalarReplacement)
+          optPM.addPass(mlir::createAffineScalarReplacementPass());
+      }
+      if (mlir::failed(runPasses(pm, "cleanup"))) {
+        module->dump();
+        return 4;
+      }
+      if (mlir::failed(mlir::verify(module.get()))) {
+        module->dump();
+        return 5;
+      }
     }
 
 #define optPM optPM2
 #define pm pm2
-    {
+    if (PassPipeline == "") {
       mlir::PassManager pm(&context);
       mlir::OpPassManager &optPM = pm.nest<mlir::func::FuncOp>();
 
@@ -544,18 +1283,19 @@ int main(int argc, char **argv) {
         optPM.addPass(mlir::createCSEPass());
         // Affine must be lowered to enable inlining
         if (RaiseToAffine)
-          optPM.addPass(mlir::createLowerAffinePass());
+          optPM.addPass(polygeist::createLowerAffinePass());
         optPM.addPass(
             mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
         pm.addPass(mlir::createInlinerPass());
+        if (EmitReachableOnly)
+          pm.addPass(mlir::createSymbolDCEPass());
         mlir::OpPassManager &optPM2 = pm.nest<mlir::func::FuncOp>();
-        optPM2.addPass(
-            mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-        optPM2.addPass(mlir::createCSEPass());
-        optPM2.addPass(polygeist::createMem2RegPass());
-        optPM2.addPass(
-            mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-        optPM2.addPass(mlir::createCSEPass());
+        optPM2.addPass(fixedPoint([&](mlir::OpPassManager &group) {
+          group.addPass(
+              mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
+          group.addPass(mlir::createCSEPass());
+          group.addPass(polygeist::createMem2RegPass());
+        }));
         optPM2.addPass(polygeist::createCanonicalizeForPass());
         if (RaiseToAffine) {
           optPM2.addPass(polygeist::createRaiseSCFToAffinePass());
@@ -564,83 +1304,67 @@ int main(int argc, char **argv) {
         optPM2.addPass(
             mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
         optPM2.addPass(mlir::createCSEPass());
-        if (ParallelLICM)
-          optPM2.addPass(polygeist::createParallelLICMPass());
-        else
-          optPM2.addPass(mlir::createLoopInvariantCodeMotionPass());
+        addLICM(optPM2);
         optPM2.addPass(
             mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
       }
-      if (mlir::failed(pm.run(module.get()))) {
+      if (mlir::failed(runPasses(pm, "optimize"))) {
         module->dump();
         return 4;
       }
     }
 
-    if (CudaLower) {
+    if (CudaLower && PassPipeline == "") {
       mlir::PassManager pm(&context);
       mlir::OpPassManager &optPM = pm.nest<mlir::func::FuncOp>();
-      optPM.addPass(mlir::createLowerAffinePass());
+      optPM.addPass(polygeist::createLowerAffinePass());
       optPM.addPass(mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
       pm.addPass(polygeist::createParallelLowerPass());
       pm.addPass(mlir::createSymbolDCEPass());
       mlir::OpPassManager &noptPM = pm.nest<mlir::func::FuncOp>();
-      noptPM.addPass(
-          mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-      noptPM.addPass(polygeist::createMem2RegPass());
-      noptPM.addPass(
-          mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
+      noptPM.addPass(fixedPoint([&](mlir::OpPassManager &group) {
+        group.addPass(
+            mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
+        group.addPass(polygeist::createMem2RegPass());
+      }));
       pm.addPass(mlir::createInlinerPass());
       mlir::OpPassManager &noptPM2 = pm.nest<mlir::func::FuncOp>();
-      noptPM2.addPass(
-          mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-      noptPM2.addPass(polygeist::createMem2RegPass());
+      noptPM2.addPass(fixedPoint([&](mlir::OpPassManager &group) {
+        group.addPass(
+            mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
+        group.addPass(polygeist::createMem2RegPass());
+      }));
       noptPM2.addPass(polygeist::createCanonicalizeForPass());
       noptPM2.addPass(
           mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
       noptPM2.addPass(mlir::createCSEPass());
-      if (ParallelLICM)
-        noptPM2.addPass(polygeist::createParallelLICMPass());
-      else
-        noptPM2.addPass(mlir::createLoopInvariantCodeMotionPass());
+      addLICM(noptPM2);
       noptPM2.addPass(
           mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
       if (RaiseToAffine) {
-        noptPM2.addPass(polygeist::createCanonicalizeForPass());
-        noptPM2.addPass(
-            mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-        if (ParallelLICM)
-          noptPM2.addPass(polygeist::createParallelLICMPass());
-        else
-          noptPM2.addPass(mlir::createLoopInvariantCodeMotionPass());
-        noptPM2.addPass(polygeist::createRaiseSCFToAffinePass());
-        noptPM2.addPass(
-            mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-        noptPM2.addPass(polygeist::replaceAffineCFGPass());
-        noptPM2.addPass(
-            mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
+        noptPM2.addPass(fixedPoint([&](mlir::OpPassManager &group) {
+          group.addPass(polygeist::createCanonicalizeForPass());
+          group.addPass(
+              mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
+          addRaiseToAffine(group);
+        }));
+        // Unrolling is not idempotent, so it stays outside of the groups.
         if (LoopUnroll)
-          noptPM2.addPass(mlir::createLoopUnrollPass(unrollSize, false, true));
-        noptPM2.addPass(
-            mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-        noptPM2.addPass(mlir::createCSEPass());
-        noptPM2.addPass(polygeist::createMem2RegPass());
-        noptPM2.addPass(
-            mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-        if (ParallelLICM)
-          noptPM2.addPass(polygeist::createParallelLICMPass());
-        else
-          noptPM2.addPass(mlir::createLoopInvariantCodeMotionPass());
-        noptPM2.addPass(polygeist::createRaiseSCFToAffinePass());
-        noptPM2.addPass(
-            mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-        noptPM2.addPass(polygeist::replaceAffineCFGPass());
-        noptPM2.addPass(
-            mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
+          noptPM2.addPass(
+              polygeist::createLoopHintUnrollPass(/*unrollFull=*/true));
+        noptPM2.addPass(fixedPoint([&](mlir::OpPassManager &group) {
+          group.addPass(
+              mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
+          group.addPass(mlir::createCSEPass());
+          group.addPass(polygeist::createMem2RegPass());
+          group.addPass(
+              mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
+          addRaiseToAffine(group);
+        }));
         if (ScalarReplacement)
           noptPM2.addPass(mlir::createAffineScalarReplacementPass());
       }
-      if (mlir::failed(pm.run(module.get()))) {
+      if (mlir::failed(runPasses(pm, "cuda-lower"))) {
         module->dump();
         return 4;
       }
@@ -648,54 +1372,42 @@ int main(int argc, char **argv) {
 
     mlir::PassManager pm(&context);
     mlir::OpPassManager &optPM = pm.nest<mlir::func::FuncOp>();
-    if (CudaLower) {
-      optPM.addPass(mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-      optPM.addPass(mlir::createCSEPass());
-      optPM.addPass(polygeist::createMem2RegPass());
-      optPM.addPass(mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-      optPM.addPass(mlir::createCSEPass());
-      optPM.addPass(mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-      optPM.addPass(polygeist::createCanonicalizeForPass());
-      optPM.addPass(mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-
-      if (RaiseToAffine) {
-        optPM.addPass(polygeist::createCanonicalizeForPass());
-        optPM.addPass(
-            mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-        if (ParallelLICM)
-          optPM.addPass(polygeist::createParallelLICMPass());
-        else
-          optPM.addPass(mlir::createLoopInvariantCodeMotionPass());
-        optPM.addPass(polygeist::createRaiseSCFToAffinePass());
-        optPM.addPass(
+    if (CudaLower && PassPipeline == "") {
+      optPM.addPass(fixedPoint([&](mlir::OpPassManager &group) {
+        group.addPass(
             mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-        optPM.addPass(polygeist::replaceAffineCFGPass());
-        optPM.addPass(
+        group.addPass(mlir::createCSEPass());
+        group.addPass(polygeist::createMem2RegPass());
+      }));
+      optPM.addPass(fixedPoint([&](mlir::OpPassManager &group) {
+        group.addPass(polygeist::createCanonicalizeForPass());
+        group.addPass(
             mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-        if (ScalarReplacement)
-          optPM.addPass(mlir::createAffineScalarReplacementPass());
-      }
+        if (RaiseToAffine)
+          addRaiseToAffine(group);
+      }));
+
+      if (RaiseToAffine && ScalarReplacement)
+        optPM.addPass(mlir::createAffineScalarReplacementPass());
       if (ToCPU == "continuation") {
         optPM.addPass(polygeist::createBarrierRemovalContinuation());
         // pm.nest<mlir::FuncOp>().addPass(mlir::createCanonicalizerPass());
       } else if (ToCPU.size() != 0) {
         optPM.addPass(polygeist::createCPUifyPass(ToCPU));
       }
-      optPM.addPass(mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-      optPM.addPass(mlir::createCSEPass());
-      optPM.addPass(polygeist::createMem2RegPass());
-      optPM.addPass(mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-      optPM.addPass(mlir::createCSEPass());
+      optPM.addPass(fixedPoint([&](mlir::OpPassManager &group) {
+        group.addPass(
+            mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
+        group.addPass(mlir::createCSEPass());
+        group.addPass(polygeist::createMem2RegPass());
+      }));
       if (RaiseToAffine) {
         optPM.addPass(polygeist::createCanonicalizeForPass());
         optPM.addPass(
             mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-        if (ParallelLICM)
-          optPM.addPass(polygeist::createParallelLICMPass());
-        else
-          optPM.addPass(mlir::createLoopInvariantCodeMotionPass());
+        addLICM(optPM);
         if (EarlyInnerSerialize) {
-          optPM.addPass(mlir::createLowerAffinePass());
+          optPM.addPass(polygeist::createLowerAffinePass());
           optPM.addPass(polygeist::createInnerSerializationPass());
           optPM.addPass(polygeist::createCanonicalizeForPass());
         }
@@ -706,23 +1418,17 @@ int main(int argc, char **argv) {
         optPM.addPass(
             mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
         if (LoopUnroll)
-          optPM.addPass(mlir::createLoopUnrollPass(unrollSize, false, true));
-        optPM.addPass(
-            mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-        optPM.addPass(mlir::createCSEPass());
-        optPM.addPass(polygeist::createMem2RegPass());
-        optPM.addPass(
-            mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-        if (ParallelLICM)
-          optPM.addPass(polygeist::createParallelLICMPass());
-        else
-          optPM.addPass(mlir::createLoopInvariantCodeMotionPass());
-        optPM.addPass(polygeist::createRaiseSCFToAffinePass());
-        optPM.addPass(
-            mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-        optPM.addPass(polygeist::replaceAffineCFGPass());
-        optPM.addPass(
-            mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
+          optPM.addPass(
+              polygeist::createLoopHintUnrollPass(/*unrollFull=*/true));
+        optPM.addPass(fixedPoint([&](mlir::OpPassManager &group) {
+          group.addPass(
+              mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
+          group.addPass(mlir::createCSEPass());
+          group.addPass(polygeist::createMem2RegPass());
+          group.addPass(
+              mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
+          addRaiseToAffine(group);
+        }));
         if (ScalarReplacement)
           optPM.addPass(mlir::createAffineScalarReplacementPass());
       }
@@ -730,17 +1436,19 @@ int main(int argc, char **argv) {
     pm.addPass(mlir::createSymbolDCEPass());
 
     if (EmitLLVM || !EmitAssembly || EmitOpenMPIR || EmitLLVMDialect) {
-      pm.addPass(mlir::createLowerAffinePass());
+      pm.addPass(polygeist::createLowerAffinePass());
       if (InnerSerialize)
         pm.addPass(polygeist::createInnerSerializationPass());
 
       // pm.nest<mlir::FuncOp>().addPass(mlir::createConvertMathToLLVMPass());
-      if (mlir::failed(pm.run(module.get()))) {
+      if (mlir::failed(runPasses(pm, "parallel-lowering"))) {
         module->dump();
         return 4;
       }
       mlir::PassManager pm2(&context);
       if (SCFOpenMP) {
+        pm2.addPass(polygeist::createConvertParallelToOpenMPPass());
+        // Parallel loops with reductions are left to the upstream conversion.
         pm2.addPass(createConvertSCFToOpenMPPass());
       } else
         pm2.addPass(polygeist::createSerializationPass());
@@ -752,7 +1460,7 @@ int main(int argc, char **argv) {
       pm.nest<mlir::func::FuncOp>().addPass(polygeist::createMem2RegPass());
       pm2.addPass(mlir::createCSEPass());
       pm2.addPass(mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-      if (mlir::failed(pm2.run(module.get()))) {
+      if (mlir::failed(runPasses(pm2, "openmp-lowering"))) {
         module->dump();
         return 4;
       }
@@ -767,14 +1475,14 @@ int main(int argc, char **argv) {
             polygeist::createConvertPolygeistToLLVMPass(options, CStyleMemRef));
         // pm3.addPass(mlir::createLowerFuncToLLVMPass(options));
         pm3.addPass(mlir::createCanonicalizerPass(canonicalizerConfig, {}, {}));
-        if (mlir::failed(pm3.run(module.get()))) {
+        if (mlir::failed(runPasses(pm3, "llvm-lowering"))) {
           module->dump();
           return 4;
         }
       }
     } else {
 
-      if (mlir::failed(pm.run(module.get()))) {
+      if (mlir::failed(runPasses(pm, "parallel-lowering"))) {
         module->dump();
         return 4;
       }
@@ -787,12 +1495,15 @@ int main(int argc, char **argv) {
 
   if (EmitLLVM || !EmitAssembly) {
     llvm::LLVMContext llvmContext;
+    mlirclang::CompileReport::Scope translation(report.get(),
+                                                "llvm-translation");
     auto llvmModule = mlir::translateModuleToLLVMIR(module.get(), llvmContext);
     if (!llvmModule) {
       module->dump();
       llvm::errs() << "Failed to emit LLVM IR\n";
       return -1;
     }
+    addParallelAccessGroups(*llvmModule);
     if (InBoundsGEP) {
       for (auto &F : *llvmModule) {
         for (auto &BB : F) {
@@ -841,7 +1552,49 @@ int main(int argc, char **argv) {
     }
     llvmModule->setDataLayout(DL);
     llvmModule->setTargetTriple(triple.getTriple());
-    if (!EmitAssembly) {
+    translation.finish(llvmModule->getInstructionCount());
+
+    auto link = [&](const char *filename) {
+      mlirclang::CompileReport::Scope stage(report.get(), "link");
+      return emitBinary(argv[0], filename, LinkageArgs, LinkOMP);
+    };
+    if (!EmitAssembly && InProcessBackend) {
+      StringRef CPU, Features;
+      if (auto V = module.get()->getAttrOfType<mlir::StringAttr>(
+              "polygeist.target-cpu"))
+        CPU = V.getValue();
+      if (auto V = module.get()->getAttrOfType<mlir::StringAttr>(
+              "polygeist.target-features"))
+        Features = V.getValue();
+      BackendOptions BO =
+          getBackendOptions(module.get()->getAttrOfType<mlir::DictionaryAttr>(
+              "polygeist.target-options"));
+
+      auto emitObject = [&](StringRef filename) {
+        mlirclang::CompileReport::Scope stage(report.get(), "backend");
+        return emitObjectFile(*llvmModule, CPU, Features, BO, filename);
+      };
+
+      // With -c the object is the final output; otherwise the clang driver
+      // is only used to link it.
+      if (CompileOnly)
+        return finishCache(emitObject(Output));
+
+      auto tmpFile =
+          llvm::sys::fs::TempFile::create("/tmp/intermediate%%%%%%%.o");
+      if (!tmpFile) {
+        llvm::errs() << "Failed to create temp file\n";
+        return -1;
+      }
+      int res = emitObject(tmpFile->TmpName);
+      if (res == 0)
+        res = link(tmpFile->TmpName.c_str());
+      if (tmpFile->discard()) {
+        llvm::errs() << "Failed to erase temp file\n";
+        return -1;
+      }
+      return res;
+    } else if (!EmitAssembly) {
       auto tmpFile =
           llvm::sys::fs::TempFile::create("/tmp/intermediate%%%%%%%.ll");
       if (!tmpFile) {
@@ -854,22 +1607,25 @@ int main(int argc, char **argv) {
         out << *llvmModule << "\n";
         out.flush();
       }
-      int res =
-          emitBinary(argv[0], tmpFile->TmpName.c_str(), LinkageArgs, LinkOMP);
+      int res = link(tmpFile->TmpName.c_str());
       if (tmpFile->discard()) {
         llvm::errs() << "Failed to erase temp file\n";
         return -1;
       }
-      return res;
-    } else if (Output == "-") {
-      llvm::outs() << *llvmModule << "\n";
+      return finishCache(res);
     } else {
-      std::error_code EC;
-      llvm::raw_fd_ostream out(Output, EC);
-      out << *llvmModule << "\n";
+      mlirclang::CompileReport::Scope stage(report.get(), "output");
+      if (Output == "-") {
+        llvm::outs() << *llvmModule << "\n";
+      } else {
+        std::error_code EC;
+        llvm::raw_fd_ostream out(Output, EC);
+        out << *llvmModule << "\n";
+      }
     }
 
   } else {
+    mlirclang::CompileReport::Scope stage(report.get(), "output");
     if (Output == "-") {
       module->print(outs(), flags);
     } else {
@@ -878,5 +1634,40 @@ int main(int argc, char **argv) {
       module->print(out, flags);
     }
   }
-  return 0;
+  return finishCache(0);
+}
+
+/// Serve compile requests from a process that has already paid for target
+/// registration and dialect loading.
+static int serveCompileRequests(StringRef socketPath) {
+  llvm::InitializeAllTargetInfos();
+  llvm::InitializeAllTargets();
+  llvm::InitializeAllTargetMCs();
+  llvm::InitializeAllAsmPrinters();
+
+  mlir::MLIRContext context(mlir::MLIRContext::Threading::DISABLED);
+  initializeContext(context);
+  WarmContext = &context;
+  return mlirclang::runCompileServer(socketPath, cgeistMain);
+}
+
+int main(int argc, char **argv) {
+  if (argc >= 2) {
+    StringRef arg(argv[1]);
+    if (arg == "-cc1") {
+      SmallVector<const char *> Argv;
+      for (int i = 0; i < argc; i++)
+        Argv.push_back(argv[i]);
+      return ExecuteCC1Tool(Argv);
+    }
+    if (arg.consume_front("-serve=") || arg.consume_front("--serve="))
+      return serveCompileRequests(arg);
+  }
+
+  // Hand the compilation to a warm server when one is configured, falling
+  // back to compiling in this process if it cannot be reached.
+  if (auto socketPath = llvm::sys::Process::GetEnv("CGEIST_SERVER"))
+    if (auto res = mlirclang::forwardToCompileServer(*socketPath, argc, argv))
+      return *res;
+  return cgeistMain(argc, argv);
 }